@@ -8,7 +8,7 @@
 /*
  * Clear a port bit
  */
-void OutputLow( unsigned long bit ){
+RAMFUNC void OutputLow( unsigned long bit ){
    __PIO_CODR = bit;
 }
 
@@ -16,7 +16,7 @@ void OutputLow( unsigned long bit ){
 /*
  * Set a port bit
  */
-void OutputHigh( unsigned long bit ){
+RAMFUNC void OutputHigh( unsigned long bit ){
    __PIO_SODR = bit;
 }
 
@@ -54,6 +54,16 @@ void AT91InitialisePIO() {
 
 
 
+/* AT91ReadPins
+ *
+ * Read the level of every pin - Pin Data Status Register
+ */
+RAMFUNC unsigned long AT91ReadPins() {
+   return __PIO_PDSR;
+}
+
+
+
 int getPortBit( unsigned long mask ) {
    unsigned long port;
    port = __PIO_PDSR;
@@ -2,9 +2,9 @@
  * AT91PIO.h
  */
 
-void OutputLow( unsigned long bit );
-void OutputHigh( unsigned long bit );
-void AT91InitialisePIO();
+/* OutputLow(), OutputHigh(), AT91InitialisePIO() and AT91ReadPins() are
+   in hal.h */
+
 unsigned int AT91GetInputBits();
 unsigned int GetButton( unsigned int );
 int getPortBit( unsigned long mask );
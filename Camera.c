@@ -0,0 +1,382 @@
+#include "GameHeader.h"
+#include "config.h"
+#include "pg12864.h"
+#include "Camera.h"
+
+// Room kept between the local head and the play area's edges - a
+// quarter of the play area
+#define CAMERA_MARGIN_X 	(PLAY_WIDTH / 4)
+#define CAMERA_MARGIN_Y 	(PLAY_HEIGHT / 4)
+
+// The Frame round the Play Area - screen pixels
+#define FRAME_LEFT 	(PLAY_OFFSETX - 1)
+#define FRAME_RIGHT 	(PLAY_OFFSETX + PLAY_WIDTH + 1)
+#define FRAME_TOP 	(PLAY_OFFSETY - 1)
+#define FRAME_BOTTOM 	(PLAY_OFFSETY + PLAY_HEIGHT + 1)
+
+// Lines of a byte column drawn from the world - the frame's top to its bottom
+#define COLUMN_LINES 	(FRAME_BOTTOM - FRAME_TOP + 1)
+
+// Most bytes LCD_WriteColumn() sends for a column - every line, in runs
+// of one with 3 unchanged lines between them each positioned again
+#define COLUMN_WORST 	(COLUMN_LINES + 3 * ((COLUMN_LINES + 3) / 4))
+#define ALL_COLUMNS 	((1u << (LCD_X_MAX + 1)) - 1)
+
+#if CAMERA_BYTES < COLUMN_WORST
+#error CAMERA_BYTES must hold the worst column, or a scroll never ends
+#endif
+
+// Camera limits on each axis - it goes no further than the world's far
+// edge at the play area's
+static const int s_offset[2] = { PLAY_OFFSETX, PLAY_OFFSETY };
+static const int s_size[2]   = { PLAY_WIDTH, PLAY_HEIGHT };
+static const int s_margin[2] = { CAMERA_MARGIN_X, CAMERA_MARGIN_Y };
+static const int s_max[2]    = { WORLD_WIDTH - PLAY_WIDTH, WORLD_HEIGHT - PLAY_HEIGHT };
+
+//----------------------------------------------------------------
+// Pick-up Sprites - a bit for each square of the 3x3 around the pickup,
+// left to right and top down
+//
+//  Small      Pickup     Big
+//               #        ###
+//    #         # #       # #
+//               #        ###
+static const unsigned short s_pickupSprites[3] = { 0x010, 0x0AA, 0x1EF };
+
+// World square shown at the play area's corner, less PLAY_OFFSETX:Y -
+// 0:0 shows the world's own corner
+static int            s_camera[2];
+
+// Where the camera is stepping to - s_camera once it is there
+static int            s_target[2];
+
+// The play area as the camera's step shows it, a byte column at a time,
+// and a bit for each column still to be sent to the LCD
+static unsigned char  s_image[LCD_X_MAX + 1][COLUMN_LINES];
+static unsigned int   s_pending;
+
+// ------ Functions
+static void ImagePixel(const unsigned char* pScreen, char set);
+static void BuildImage();
+
+//----------------------------------------------------------------
+// Camera Position to show a Square in the Middle
+static int Centre(const unsigned char* pWorld, int axis)
+{
+  int at = pWorld[axis] - s_offset[axis] - s_size[axis] / 2;
+
+  if(at < 0)
+  {
+    return 0;
+  }
+  return at > s_max[axis] ? s_max[axis] : at;
+}
+
+//----------------------------------------------------------------
+// Centre the Camera on the Local Head - for a screen drawn afresh
+void CameraCentre(const unsigned char* pHead)
+{
+  s_camera[X] = s_target[X] = Centre(pHead, X);
+  s_camera[Y] = s_target[Y] = Centre(pHead, Y);
+  s_pending   = 0;
+}
+
+//----------------------------------------------------------------
+// Keep the Local Head away from the Play Area's Edges
+// Near an edge the camera sets off to centre the head, CAMERA_STEP
+// squares at a time.  A step builds the play area's image afresh, and
+// the camera holds there until CameraSend() has sent all of it.  Returns
+// TRUE when it stepped.
+char CameraFollow(const unsigned char* pHead)
+{
+  char moved = FALSE;
+
+  for(int axis = X; axis <= Y; ++axis)
+  {
+    int at = pHead[axis] - s_offset[axis] - s_camera[axis];
+
+    if((at < s_margin[axis] && s_camera[axis] > 0) ||
+       (at > s_size[axis] - s_margin[axis] && s_camera[axis] < s_max[axis]))
+    {
+      s_target[axis] = Centre(pHead, axis);
+    }
+
+    if(s_pending != 0)
+    {
+      continue;
+    }
+
+    if(s_camera[axis] < s_target[axis])
+    {
+      s_camera[axis] += s_target[axis] - s_camera[axis] < CAMERA_STEP ? s_target[axis] - s_camera[axis] : CAMERA_STEP;
+      moved = TRUE;
+    }
+    else if(s_camera[axis] > s_target[axis])
+    {
+      s_camera[axis] -= s_camera[axis] - s_target[axis] < CAMERA_STEP ? s_camera[axis] - s_target[axis] : CAMERA_STEP;
+      moved = TRUE;
+    }
+  }
+
+  if(moved)
+  {
+    BuildImage();
+    s_pending = ALL_COLUMNS;
+  }
+  return moved;
+}
+
+//----------------------------------------------------------------
+// World Square to Screen Pixel
+// FALSE when the square is outside the play area.
+char CameraToScreen(const unsigned char* pWorld, unsigned char* pScreen)
+{
+  int x = pWorld[X] - s_camera[X];
+  int y = pWorld[Y] - s_camera[Y];
+
+  if(x < PLAY_OFFSETX || x > PLAY_OFFSETX + PLAY_WIDTH ||
+     y < PLAY_OFFSETY || y > PLAY_OFFSETY + PLAY_HEIGHT)
+  {
+    return FALSE;
+  }
+
+  pScreen[X] = (unsigned char)x;
+  pScreen[Y] = (unsigned char)y;
+  return TRUE;
+}
+
+//----------------------------------------------------------------
+// Set and Clear a World Square - if the camera shows it
+// A column still to be sent takes the change in its image instead.
+void CameraSetPixel(const unsigned char* pWorld)
+{
+  unsigned char screen[2];
+
+  if(CameraToScreen(pWorld, screen) == FALSE)
+  {
+    return;
+  }
+
+  if(s_pending & (1u << (screen[X] / 8)))
+  {
+    ImagePixel(screen, TRUE);
+  }
+  else
+  {
+    LCD_SetPixel(screen[X], screen[Y]);
+  }
+}
+
+void CameraClearPixel(const unsigned char* pWorld)
+{
+  unsigned char screen[2];
+
+  if(CameraToScreen(pWorld, screen) == FALSE)
+  {
+    return;
+  }
+
+  if(s_pending & (1u << (screen[X] / 8)))
+  {
+    ImagePixel(screen, FALSE);
+  }
+  else
+  {
+    LCD_ClearPixel(screen[X], screen[Y]);
+  }
+}
+
+//----------------------------------------------------------------
+// Draw or Erase a Pick-up Sprite
+// Erasing leaves any square a snake or the border has - the sprite may
+// have been drawn over them.
+void CameraPickup(const unsigned char* pWorld, int value, char draw)
+{
+  for(int bit = 0; bit < 9; ++bit)
+  {
+    unsigned char square[2] =
+    {
+      (unsigned char)(pWorld[X] + bit % 3 - 1),
+      (unsigned char)(pWorld[Y] + bit / 3 - 1)
+    };
+
+    if((s_pickupSprites[value] & (1 << bit)) == 0)
+    {
+      continue;
+    }
+
+    if(draw)
+    {
+      CameraSetPixel(square);
+    }
+    else if(SquareTaken(&s_GameInstance, square) == FALSE)
+    {
+      CameraClearPixel(square);
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Is a Piece of the Dashed Snake a Gap - every 3rd body ring slot
+// The slot stays with the piece as the snake moves, so the incremental
+// render and a redraw leave the same gaps.
+char CameraGap(const SnakeData* pSnakeData, int iPiece)
+{
+  return ((pSnakeData->m_bodyFirst + iPiece) & (BODY_RING - 1)) % 3 == 0;
+}
+
+//----------------------------------------------------------------
+// Set or Clear a Screen Pixel in the Image
+static void ImagePixel(const unsigned char* pScreen, char set)
+{
+  unsigned char* pLine = &s_image[pScreen[X] / 8][pScreen[Y] - FRAME_TOP];
+  unsigned char  mask  = (unsigned char)(0x80 >> (pScreen[X] % 8));
+
+  if(set)
+  {
+    *pLine |= mask;
+  }
+  else
+  {
+    *pLine &= (unsigned char)~mask;
+  }
+}
+
+//----------------------------------------------------------------
+// Set a World Square's Pixel in the Image - if the camera shows it
+static void ImageSquare(const unsigned char* pWorld, char set)
+{
+  unsigned char screen[2];
+
+  if(CameraToScreen(pWorld, screen))
+  {
+    ImagePixel(screen, set);
+  }
+}
+
+//----------------------------------------------------------------
+// Frame Pixel - solid where the world ends, dotted where it goes on
+static char FramePixel(int x, int y)
+{
+  if(x == FRAME_LEFT || x == FRAME_RIGHT)
+  {
+    return (x == FRAME_LEFT ? s_camera[X] == 0 : s_camera[X] == s_max[X]) || (y & 1) == 0;
+  }
+  if(y == FRAME_TOP || y == FRAME_BOTTOM)
+  {
+    return (y == FRAME_TOP ? s_camera[Y] == 0 : s_camera[Y] == s_max[Y]) || (x & 1) == 0;
+  }
+  return FALSE;
+}
+
+//----------------------------------------------------------------
+// Build the Image of the Play Area from the World
+// The frame and both snakes a pixel at a time, then one walk along the
+// dashed snake for its gaps - all but its tail end - and the pickup.
+static void BuildImage()
+{
+  const SnakeData* pDashed = &s_GameInstance.m_snakes[s_GameInstance.m_isHost ? 1 : 0];
+  unsigned char    pos[2];
+  int              laid    = SNAKE_LAID(pDashed);
+
+  for(int column = 0; column <= LCD_X_MAX; ++column)
+  {
+    for(int line = 0; line < COLUMN_LINES; ++line)
+    {
+      int           y    = FRAME_TOP + line;
+      unsigned char bits = 0;
+
+      for(int i = 0; i < 8; ++i)
+      {
+        int x = column * 8 + i;
+
+        if(x >= PLAY_OFFSETX && x <= PLAY_OFFSETX + PLAY_WIDTH &&
+           y >= PLAY_OFFSETY && y <= PLAY_OFFSETY + PLAY_HEIGHT)
+        {
+          pos[X] = (unsigned char)(x + s_camera[X]);
+          pos[Y] = (unsigned char)(y + s_camera[Y]);
+          if(SquareTaken(&s_GameInstance, pos))
+          {
+            bits |= (unsigned char)(0x80 >> i);
+          }
+        }
+        else if(FramePixel(x, y))
+        {
+          bits |= (unsigned char)(0x80 >> i);
+        }
+      }
+      s_image[column][line] = bits;
+    }
+  }
+
+  // Gaps in the Dashed Snake
+  pos[X] = pDashed->m_head[X];
+  pos[Y] = pDashed->m_head[Y];
+  for(int iLength = 0; iLength < laid - 1; ++iLength)
+  {
+    UpdatePos(pos, BodyDir(pDashed, iLength));
+    if(CameraGap(pDashed, iLength))
+    {
+      ImageSquare(pos, FALSE);
+    }
+  }
+
+  // Pick-up
+  for(int bit = 0; bit < 9; ++bit)
+  {
+    if(s_pickupSprites[s_GameInstance.m_pickupValue] & (1 << bit))
+    {
+      pos[X] = (unsigned char)(s_GameInstance.m_pickupPos[X] + bit % 3 - 1);
+      pos[Y] = (unsigned char)(s_GameInstance.m_pickupPos[Y] + bit / 3 - 1);
+      ImageSquare(pos, TRUE);
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Send the Image's Pending Columns - while the tick's bytes allow
+// A column starts only while COLUMN_WORST more bytes fit in the budget,
+// so the tick never sends more than it.  Only the bytes that changed go
+// to the LCD.
+void CameraSend(int bytes)
+{
+  unsigned long start;
+  unsigned long data;
+  unsigned long commands;
+
+  LCD_GetCounters(&data, &commands);
+  start = data + commands;
+
+  for(int column = 0; column <= LCD_X_MAX && s_pending != 0; ++column)
+  {
+    if((s_pending & (1u << column)) == 0)
+    {
+      continue;
+    }
+
+    LCD_GetCounters(&data, &commands);
+    if(data + commands - start + COLUMN_WORST > (unsigned long)bytes)
+    {
+      return;
+    }
+
+    LCD_WriteColumn((unsigned char)column, FRAME_TOP, s_image[column], COLUMN_LINES);
+    s_pending &= ~(1u << column);
+  }
+}
+
+//----------------------------------------------------------------
+// Draw the whole Play Area from the World now - for a screen drawn afresh
+void CameraDraw()
+{
+  BuildImage();
+  s_pending = ALL_COLUMNS;
+  CameraSend(COLUMN_WORST * (LCD_X_MAX + 1));
+}
+
+//----------------------------------------------------------------
+// Is the Camera still Stepping to its Target - or sending a step
+char CameraScrolling()
+{
+  return s_pending != 0 || s_camera[X] != s_target[X] || s_camera[Y] != s_target[Y];
+}
@@ -0,0 +1,27 @@
+//
+// Camera.h
+//
+// Camera - the part of the world the play area shows, following the
+// local snake
+//
+// World squares are drawn through the camera, and only those in the play
+// area.  When the local head comes near an edge of the play area the
+// camera steps over to centre it again, CAMERA_STEP squares at a time
+// (config.h).  Each step builds an image of the play area from the world,
+// and CameraSend() sends it a few columns a tick, CAMERA_BYTES at most;
+// the camera holds until the step is all sent.  Only bytes that changed
+// are sent.  The frame is solid along the world's edge and dotted where
+// the world goes on.  Include GameHeader.h first.
+//
+
+// ------ Functions
+void CameraCentre(const unsigned char* pHead);
+char CameraFollow(const unsigned char* pHead);
+char CameraToScreen(const unsigned char* pWorld, unsigned char* pScreen);
+void CameraSetPixel(const unsigned char* pWorld);
+void CameraClearPixel(const unsigned char* pWorld);
+void CameraPickup(const unsigned char* pWorld, int value, char draw);
+char CameraGap(const SnakeData* pSnakeData, int iPiece);
+void CameraSend(int bytes);
+void CameraDraw();
+char CameraScrolling();
@@ -0,0 +1,343 @@
+#include "GameHeader.h"
+#include <string.h>
+#include "config.h"
+#include "CpuPlayer.h"
+
+// Grid cell of a board position
+#define CPU_CELL(pos) 	((((pos)[Y] - PLAY_OFFSETY + 1) * CPU_ROW) + (pos)[X] - PLAY_OFFSETX + 1)
+
+// Way nibbles - 0 for a cell not reached, else the direction to take
+#define WAY_NONE 	0
+#define WAY_PICKUP 	5
+
+// Cell step for each direction - NO_MOVE, NORTH, EAST, SOUTH, WEST
+static const int s_step[5] = { 0, -CPU_ROW, 1, CPU_ROW, -1 };
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Cell Flags
+static unsigned char GetWay(const CpuPlayer* pCpu, int cell)
+{
+  return (unsigned char)((pCpu->m_way[cell >> 1] >> ((cell & 1) << 2)) & 0x0F);
+}
+
+static void SetWay(CpuPlayer* pCpu, int cell, unsigned char way)
+{
+  pCpu->m_way[cell >> 1] |= (unsigned char)(way << ((cell & 1) << 2));
+}
+
+// A wall by where the cell is, else a snake by the game's occupancy map
+static int Blocked(const CpuPlayer* pCpu, int cell)
+{
+  int column = cell % CPU_ROW;
+
+  if(cell < CPU_ROW || cell >= CPU_CELLS - CPU_ROW || column == 0 || column > WORLD_WIDTH + 1)
+  {
+    return TRUE;
+  }
+  return pCpu->m_pOccupied[cell >> 3] & (1 << (cell & 7));
+}
+
+static void Block(unsigned char* pBits, int cell)
+{
+  pBits[cell >> 3] |= (unsigned char)(1 << (cell & 7));
+}
+
+//----------------------------------------------------------------
+// The grid is the game's occupancy map from the top wall down, so the
+// snakes come across row for row and are read where they lie.
+#if CPU_ROW != OCCUPY_ROW || PLAY_OFFSETX != 1 || PLAY_OFFSETY - 1 + CPU_ROWS != OCCUPY_ROWS
+#error CPU grid no longer lines up with the occupancy map
+#endif
+
+// The fills' share must leave the search some of the budget
+#if CPU_BUDGET_NODES <= 3 * CPU_SPACE_CELLS
+#error CPU_BUDGET_NODES leaves nothing for the search
+#endif
+
+//----------------------------------------------------------------
+// Start a Search out from the Pickup
+// The old ways are cleared first, over as many ticks as the budget needs.
+static void StartSearch(CpuPlayer* pCpu, const SnakeGame* pGame)
+{
+  pCpu->m_clear     = sizeof(pCpu->m_way);
+  pCpu->m_count     = 0;
+  pCpu->m_target[X] = pGame->m_pickupPos[X];
+  pCpu->m_target[Y] = pGame->m_pickupPos[Y];
+  pCpu->m_searches++;
+}
+
+//----------------------------------------------------------------
+// Clear the Old Ways - CPU_CLEAR_BYTES for each of budget cells
+// Returns the budget left.  The pickup's cell starts the search once
+// the last of them goes.
+static int ClearWays(CpuPlayer* pCpu, int budget)
+{
+  int bytes = budget * CPU_CLEAR_BYTES;
+  int spent;
+  int cell;
+
+  if(pCpu->m_clear == 0)
+  {
+    return budget;
+  }
+
+  if(bytes > pCpu->m_clear)
+  {
+    bytes = pCpu->m_clear;
+  }
+  pCpu->m_clear -= (unsigned short)bytes;
+  memset(pCpu->m_way + pCpu->m_clear, 0, bytes);
+
+  spent = (bytes + CPU_CLEAR_BYTES - 1) / CPU_CLEAR_BYTES;
+  pCpu->m_nodes += spent;
+
+  if(pCpu->m_clear == 0)
+  {
+    cell = CPU_CELL(pCpu->m_target);
+    SetWay(pCpu, cell, WAY_PICKUP);
+    pCpu->m_queue[0] = (unsigned short)cell;
+    pCpu->m_first    = 0;
+    pCpu->m_count    = 1;
+  }
+  return budget - spent;
+}
+
+//----------------------------------------------------------------
+// Search on from where the last Tick stopped - up to budget cells
+// Cells blocked now are passed over; ones freed later are not gone back
+// for until the next search.
+static void Search(CpuPlayer* pCpu, int budget)
+{
+  while(pCpu->m_count > 0 && budget-- > 0)
+  {
+    int cell = pCpu->m_queue[pCpu->m_first];
+    int dir;
+
+    pCpu->m_first = (unsigned short)((pCpu->m_first + 1) % CPU_QUEUE);
+    pCpu->m_count--;
+    pCpu->m_nodes++;
+
+    for(dir = NORTH; dir <= WEST; ++dir)
+    {
+      int next = cell + s_step[dir];
+
+      if(GetWay(pCpu, next) != WAY_NONE || Blocked(pCpu, next))
+      {
+        continue;
+      }
+
+      SetWay(pCpu, next, ReverseDir((unsigned char)dir));
+      if(pCpu->m_count < CPU_QUEUE)
+      {
+        pCpu->m_queue[(pCpu->m_first + pCpu->m_count) % CPU_QUEUE] = (unsigned short)next;
+        pCpu->m_count++;
+      }
+      else
+      {
+        pCpu->m_dropped++;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Free Cells reachable from a Cell - counting stops at need
+// Room that reaches the snake's own tail end is as good as need: the tail
+// moves on ahead of the head.
+static int Room(CpuPlayer* pCpu, int cell, int need, int tail)
+{
+  int count = 1;
+  int room  = 0;
+  int i;
+
+  Block(pCpu->m_seen, cell);
+  pCpu->m_fill[0] = (unsigned short)cell;
+
+  for(i = 0; i < count && count < need && room < need; ++i)
+  {
+    int dir;
+
+    for(dir = NORTH; dir <= WEST && count < need; ++dir)
+    {
+      int next = pCpu->m_fill[i] + s_step[dir];
+
+      if(next == tail)
+      {
+        room = need;
+      }
+      if(Blocked(pCpu, next) || (pCpu->m_seen[next >> 3] & (1 << (next & 7))))
+      {
+        continue;
+      }
+      Block(pCpu->m_seen, next);
+      pCpu->m_fill[count++] = (unsigned short)next;
+    }
+  }
+  pCpu->m_nodes += i;
+
+  // Clear the marks for the next fill
+  for(i = 0; i < count; ++i)
+  {
+    pCpu->m_seen[pCpu->m_fill[i] >> 3] &= (unsigned char)~(1 << (pCpu->m_fill[i] & 7));
+  }
+  return count > room ? count : room;
+}
+
+//----------------------------------------------------------------
+// Steps between two Cells, walls aside
+static int Distance(int from, int to)
+{
+  int dx = (from % CPU_ROW) - (to % CPU_ROW);
+  int dy = (from / CPU_ROW) - (to / CPU_ROW);
+
+  return (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+}
+
+//----------------------------------------------------------------
+// Forget everything - before each game
+void CpuReset(CpuPlayer* pCpu)
+{
+  memset(pCpu, 0, sizeof(CpuPlayer));
+}
+
+//----------------------------------------------------------------
+// Choose a Snake's Direction for this Tick
+// Moves are ranked: not beside the other head (a head-on is a draw at
+// best), then the way the search left at the head, then any move
+// towards the pickup, then straight on.  With no way to the pickup the
+// snake chases its own tail.  The best is taken if it leaves room for the
+// snake; otherwise the roomiest, nearest the tail on a tie.  NO_MOVE when
+// every move crashes.
+unsigned char CpuDecide(CpuPlayer* pCpu, const SnakeGame* pGame, int iPlay)
+{
+  const SnakeData* pSnake = &pGame->m_snakes[iPlay];
+  unsigned char    dir    = pSnake->m_dir;
+  unsigned char    moves[3];
+  int              rank[3];
+  int              head   = CPU_CELL(pSnake->m_head);
+  int              other  = CPU_CELL(pGame->m_snakes[!iPlay].m_head);
+  int              need   = pSnake->m_length + 1;
+  int              tail   = -1;
+  int              reached = FALSE;
+  int              best   = -1;
+  int              count  = 0;
+  int              ways;
+  int              first;
+  int              most;
+  int              i;
+
+  if(need > CPU_SPACE_CELLS)
+  {
+    need = CPU_SPACE_CELLS;
+  }
+
+  // The fills' worst comes off the budget first, then clearing old ways
+  pCpu->m_nodes     = 0;
+  pCpu->m_pOccupied = pGame->m_occupied + (PLAY_OFFSETY - 1) * (OCCUPY_ROW / 8);
+
+  if(ComparePositions(pCpu->m_target, pGame->m_pickupPos) == FALSE)
+  {
+    StartSearch(pCpu, pGame);
+  }
+  Search(pCpu, ClearWays(pCpu, CPU_BUDGET_NODES - 3 * need));
+  ways = (pCpu->m_clear == 0);
+
+  // Ahead, left, right
+  moves[0] = dir;
+  moves[1] = (unsigned char)((dir + 2) % 4 + 1);
+  moves[2] = (unsigned char)(dir % 4 + 1);
+
+  for(i = 0; i < 3; ++i)
+  {
+    int           next = head + s_step[moves[i]];
+    unsigned char way  = ways ? GetWay(pCpu, next) : WAY_NONE;
+
+    if(Blocked(pCpu, next))
+    {
+      rank[i] = -1;
+      continue;
+    }
+
+    rank[i] = 0;
+    if(next != other - 1 && next != other + 1 && next != other - CPU_ROW && next != other + CPU_ROW)
+    {
+      rank[i] += 4;
+    }
+    if(ways && GetWay(pCpu, head) == moves[i])
+    {
+      rank[i] += 2;
+    }
+    else if(way != WAY_NONE && way != ReverseDir(moves[i]))
+    {
+      rank[i] += 1;
+    }
+    if(way != WAY_NONE)
+    {
+      reached = TRUE;
+    }
+
+    if(best < 0 || rank[i] > rank[best])
+    {
+      best = i;
+    }
+    count++;
+  }
+
+  // A finished search that no longer reaches us is stale
+  if(reached == FALSE && pCpu->m_count == 0 && ways)
+  {
+    pCpu->m_target[X] = 0;
+    pCpu->m_target[Y] = 0;
+  }
+
+  if(best >= 0 && count > 1)
+  {
+    if(SNAKE_LAID(pSnake) > 0)
+    {
+      tail = CPU_CELL(pSnake->m_tail);
+    }
+    // Nothing leads to the pickup - keep to the tail until something does
+    if((rank[best] & 3) == 0 && tail >= 0)
+    {
+      for(i = 0; i < 3; ++i)
+      {
+        if(rank[i] == rank[best] &&
+           Distance(head + s_step[moves[i]], tail) < Distance(head + s_step[moves[best]], tail))
+        {
+          best = i;
+        }
+      }
+    }
+
+    first = best;
+    most  = Room(pCpu, head + s_step[moves[first]], need, tail);
+    if(most < need)
+    {
+      for(i = 0; i < 3; ++i)
+      {
+        int room;
+
+        if(rank[i] < 0 || i == first)
+        {
+          continue;
+        }
+        room = Room(pCpu, head + s_step[moves[i]], need, tail);
+        if(room > most || (room == most && tail >= 0 &&
+           Distance(head + s_step[moves[i]], tail) < Distance(head + s_step[moves[best]], tail)))
+        {
+          best = i;
+          most = room;
+        }
+      }
+    }
+  }
+
+  if(pCpu->m_nodes > pCpu->m_maxNodes)
+  {
+    pCpu->m_maxNodes = pCpu->m_nodes;
+  }
+
+  return best < 0 ? NO_MOVE : moves[best];
+}
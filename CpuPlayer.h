@@ -0,0 +1,51 @@
+//
+// CpuPlayer.h
+//
+// CPU opponent - steers a snake to the pickup for single-board games
+//
+// A breadth-first search runs out from the pickup and leaves in every
+// cell it reaches the way back to it.  The search is spread over ticks
+// and kept until the pickup moves, so most ticks only follow the way from
+// the head.  A tick's work - clearing old ways, the search and the flood
+// fills - comes out of CPU_BUDGET_NODES cells (config.h).  With no way to
+// the pickup the snake chases its own tail.  A move that leaves the snake
+// less room than its length, by a capped flood fill, is swapped for the
+// roomiest one.  Include GameHeader.h first.
+//
+
+// Search grid - the world inside a ring of walls, rows as long as the
+// occupancy map's
+#define CPU_ROW 	OCCUPY_ROW
+#define CPU_ROWS 	(WORLD_HEIGHT + 3)
+#define CPU_CELLS 	(CPU_ROW * CPU_ROWS)
+
+// Search frontier - ample for an open board; a cell that does not fit
+// is reached but not searched from
+#define CPU_QUEUE 	1024
+
+// Room counted past before a move is thought safe
+#define CPU_SPACE_CELLS 256
+
+// Bytes of old ways cleared for one cell of the budget - 16 word stores
+#define CPU_CLEAR_BYTES 64
+
+typedef struct CpuPlayer_
+{
+	unsigned char   m_way[CPU_CELLS / 2];      // Way to the pickup - a nibble a cell
+	unsigned char   m_seen[CPU_CELLS / 8];     // Flood fill marks
+	unsigned short  m_queue[CPU_QUEUE];        // Search frontier - a ring
+	unsigned short  m_fill[CPU_SPACE_CELLS];   // Flood fill frontier
+	unsigned short  m_first;                   // Oldest cell in m_queue
+	unsigned short  m_count;                   // Cells in m_queue
+	unsigned short  m_clear;                   // Bytes of m_way still to clear
+	unsigned char   m_target[2];               // Pickup the search runs from
+	const unsigned char* m_pOccupied;     // Occupancy map from the top wall
+	unsigned long   m_nodes;                   // Cells visited this tick
+	unsigned long   m_maxNodes;                // Most in any tick
+	unsigned long   m_searches;                // Searches started
+	unsigned long   m_dropped;                 // Cells the frontier had no room for
+} CpuPlayer;
+
+// ------ Functions
+void CpuReset(CpuPlayer* pCpu);
+unsigned char CpuDecide(CpuPlayer* pCpu, const SnakeGame* pGame, int iPlay);
@@ -1,15 +1,30 @@
 /* Delay.c */
 
+#include "config.h"
+#include "timer.h"
+#include "Delay.h"
+
 /*
- * Delay for us intervals - approximately
- * replace this with a clock delay at a later date ;-)
+ * Delay for us intervals
+ *
+ * Waits on the timer/counter 0 count - MCK/2, 33 counts per us -
+ * so the delay no longer depends on the compiler or its optimisation
+ * level.  Needs AT91InitTimer() and AT91StartTimer() first, and the
+ * heartbeat interrupt must not be held off for more than 1 ms while
+ * waiting.  The time taken to call and return adds a fraction of a us.
  */
 void Delay_us( int period ) {
-  int count;
-  while ( period > 0 ) {
-     for (count= 0; count < 10; count++);
-     period--;
-  }
+   unsigned long start;
+   unsigned long cycles;
+
+   if ( period <= 0 )
+      return;
+
+   start = TimerCycles();
+   cycles = (unsigned long)period * TIMER_CYCLES_PER_US;
+
+   while ( TimerCycles() - start < cycles )
+      ;
 }
 
 
@@ -20,8 +35,37 @@ void Delay_us( int period ) {
  * a delay in ms
  */
 void Delay_ms( int period ) {
-   while ( period != 0 ) {
+   while ( period > 0 ) {
       Delay_us(1000);
       period--;
    }
 }
+
+
+/*
+ * Delay self-test
+ *
+ * Repeats a delay of period us for about 20 ms - Delay_ms for whole
+ * ms, Delay_us otherwise - timing the lot on the counter.  Returns
+ * the mean error of one call in ns, call overhead included; positive
+ * is too long.  Build at each optimisation level and compare.
+ */
+int Delay_error( int period ) {
+   int repeats = period < 20000 ? 20000 / period : 1;
+   int i;
+   unsigned long start;
+   long over;
+
+   start = TimerCycles();
+   for ( i = 0; i < repeats; i++ ) {
+      if ( period % 1000 == 0 )
+         Delay_ms( period / 1000 );
+      else
+         Delay_us( period );
+   }
+   over = (long)( TimerCycles() - start )
+        - (long)repeats * period * TIMER_CYCLES_PER_US;
+
+/* Tenths of a count per call, then ns - 1000 / 33 per count */
+   return (int)( over * 10 / repeats * 100 / TIMER_CYCLES_PER_US );
+}
@@ -2,3 +2,4 @@
 
 void Delay_us( int period );
 void Delay_ms( int period );
+int Delay_error( int period );
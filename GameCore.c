@@ -9,13 +9,76 @@
 #include "pg12864.h"
 #include "keypad.h"
 #include "Delay.h"
-#include "sound.h"
+#include "Sound.h"
 #include "XBee.h"
+#include "NetStats.h"
+#include "Profile.h"
+#include "CpuPlayer.h"
+#include "Camera.h"
+#include "Snapshot.h"
+
+// Time without the Peer's Move before ours is Sent again - ms
+#define RESEND_MS 100
+
+// Resends a Joining Client waits for the Host's First Move - or for a
+// snapshot of the game so far, which can take a second and a half at
+// 9600 baud
+#define JOIN_RETRIES 30
+
+// Time without the Peer's Move before the Host gives it up - ms
+#define PEER_LOST_MS 2000
+
+// Time before a Snapshot not yet answered is Sent again - ms
+#define SNAPSHOT_RESEND_MS 500
+
+// Time the Result stays up before the Network Counters replace it - ms
+#define RESULT_MS 2000
 
 // Game Instance Varible
 SnakeGame 	s_GameInstance;
 char		s_bRedraw;
 
+// CPU Opponent - its search state and the next tick's time
+static CpuPlayer 	s_cpuPlayer;
+static unsigned long 	s_cpuTickAt;
+
+// Snapshot for a Peer Joining Late - sent by the Host, read by the Client
+static unsigned char 	s_snapshot[SNAPSHOT_MAX];
+static char 		s_snapshotDue;
+static unsigned long 	s_snapshotAt;
+
+// Tunes - played from the sound interrupt while the game carries on
+// Little Fanfare: E F G C DEF GABF ABCDE EFGC DEF GGED GED GED GFEDC
+static const Tone s_fanfare[] =
+{
+  {e3, DUR_MS(sq)}, {REST, 50},
+  {f3, DUR_MS(sq)}, {REST, 50},
+  {g3, DUR_MS(sq)}, {REST, 50},
+  {c3, DUR_MS(sq)}, {REST, 50},
+  {d3, DUR_MS(m)}, {e3, DUR_MS(m)}, {f3, DUR_MS(c)}, {REST, 50},
+  {g3, DUR_MS(m)}, {a3, DUR_MS(m)}, {b3, DUR_MS(m)}, {f3, DUR_MS(m)}, {REST, 50},
+  {a3, DUR_MS(m)}, {b3, DUR_MS(m)}, {c3, DUR_MS(m)}, {d3, DUR_MS(m)}, {e3, DUR_MS(m)}, {REST, 50},
+  {e3, DUR_MS(m)}, {f3, DUR_MS(m)}, {g3, DUR_MS(m)}, {c3, DUR_MS(m)}, {REST, 50},
+  {d3, DUR_MS(m)}, {e3, DUR_MS(m)}, {f3, DUR_MS(c)}, {REST, 50},
+  {g3, DUR_MS(m)}, {g3, DUR_MS(m)}, {e3, DUR_MS(m)}, {d3, DUR_MS(m)}, {REST, 50},
+  {g3, DUR_MS(m)}, {e3, DUR_MS(m)}, {d3, DUR_MS(c)}, {REST, 50},
+  {g3, DUR_MS(m)}, {e3, DUR_MS(m)}, {d3, DUR_MS(c)}, {REST, 50},
+  {g3, DUR_MS(m)}, {e3, DUR_MS(m)}, {f3, DUR_MS(m)}, {d3, DUR_MS(m)}, {c3, DUR_MS(m)},
+  {0, 0}
+};
+
+static const Tone s_pickupEaten[] =
+{
+  {a4, DUR_MS(c)}, {b4, DUR_MS(c)},
+  {0, 0}
+};
+
+static const Tone s_pickupPlaced[] =
+{
+  {c4, DUR_MS(c)}, {e4, DUR_MS(c)},
+  {0, 0}
+};
+
 // ------ Functions
 
 //----------------------------------------------------------------
@@ -31,19 +94,25 @@ void PrintErrorMessage(char* errMsg, int a, int b, int c)
   LCD_PutString(buffer);
   s_bRedraw = TRUE;
   
-  while( keyPress() == -1 ) 
+  while( keyPoll() == -1 ) 
   {
-    // Do nothing
+    TimerIdle();
   }
   
 }
 
 //----------------------------------------------------------------
-// Get Random Number
-int RandomNumber()
+// Direction for a Keypad Key - 2, 4, 6, 8 as on a phone
+unsigned char KeyDir(int key)
 {
-  int r = (((s_GameInstance.m_randHold = s_GameInstance.m_randHold * 214013L + 2531011L) >> 16) & 0x7fff); 
-  return r;
+  switch(key)
+  {
+  case 0x02:  return NORTH;
+  case 0x04:  return WEST;
+  case 0x06:  return EAST;
+  case 0x08:  return SOUTH;
+  }
+  return NO_MOVE;
 }
 
 //----------------------------------------------------------------
@@ -59,166 +128,60 @@ void RedrawScore()
   LCD_PutString(buffer);
 }
 
+//----------------------------------------------------------------
+// Redraw one Player's Score - its digits alone, where RedrawScore() put them
+static const unsigned char s_scoreColumns[2] = { 4, 12 };
+
+void RedrawPlayerScore(int iPlay)
+{
+  char buffer[12];
+
+  LCD_PositionCursor(s_scoreColumns[iPlay], 0);
+  sprintf(buffer, "%03i", s_GameInstance.m_snakes[iPlay].m_score);
+  LCD_PutString(buffer);
+}
+
 //----------------------------------------------------------------
 // Draw Pick-up
 void DrawPickup()
 {
- // Draw Pick-up
-  switch(s_GameInstance.m_pickupValue)
-  {
-    // ------------------------------------------
-    // Small Pickup
-    // #
-  default:
-  case 0:
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X], s_GameInstance.m_pickupPos[Y]);
-    break;
-
-    // ------------------------------------------
-    // Pickup
-    //  #
-    // # #
-    //  #
-  case 1:
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X], s_GameInstance.m_pickupPos[Y]+1);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X], s_GameInstance.m_pickupPos[Y]-1);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]+1, s_GameInstance.m_pickupPos[Y]);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]-1, s_GameInstance.m_pickupPos[Y]);
-    break;
-  
-    // ------------------------------------------
-    // Big Pickup
-    // ###
-    // # #
-    // ###
-  case 2:
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]-1, s_GameInstance.m_pickupPos[Y]-1);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]-1, s_GameInstance.m_pickupPos[Y]);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]-1, s_GameInstance.m_pickupPos[Y]+1);
-
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X], s_GameInstance.m_pickupPos[Y]);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X], s_GameInstance.m_pickupPos[Y]);
-
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]+1, s_GameInstance.m_pickupPos[Y]-1);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]+1, s_GameInstance.m_pickupPos[Y]);
-    LCD_SetPixel(s_GameInstance.m_pickupPos[X]+1, s_GameInstance.m_pickupPos[Y]+1);
-    break;
-  }
+  CameraPickup(s_GameInstance.m_pickupPos, s_GameInstance.m_pickupValue, TRUE);
 }
 
 //----------------------------------------------------------------
 // Redraw full game Screen
+// The play area is drawn from the world through the camera, a byte
+// column at a time.
 void RedrawFullGame()
 {
-  int xPos = 1;
-  int yPos = 0;
-  
   // Clear Display
   LCD_ClearDisplay();
 
   // Render Score
   RedrawScore();
 
-  // Draw Box
-  xPos = 0;
-  while(xPos < (LCD_X_MAX*9))
-  {
-    LCD_SetPixel(xPos, PLAY_OFFSETY-1);
-    LCD_SetPixel(xPos, PLAY_OFFSETY+PLAY_HEIGHT+1);
-    xPos += 1;
-  }
-  
-  yPos = 8;
-  while(yPos < (LCD_Y_MAX*9))
-  {
-    LCD_SetPixel( PLAY_OFFSETX-1, yPos );
-    LCD_SetPixel( PLAY_OFFSETX+PLAY_WIDTH+1, yPos );
-    yPos += 1;
-  }
-
-  // Draw Full Snake
-  for(int iPlay = 0; iPlay < 2; ++iPlay)
-  {
-    // Draw head
-    LCD_SetPixel(s_GameInstance.m_snakes[iPlay].m_head[X], s_GameInstance.m_snakes[iPlay].m_head[Y]);
-
-    // Local Player is always solid
-    if(iPlay == !s_GameInstance.m_isHost) 
-    {
-      // Draw Tail
-      for(int iLength = 0; iLength < s_GameInstance.m_snakes[iPlay].m_length; ++iLength)      
-      {
-        if((s_GameInstance.m_snakes[iPlay].m_tailP[iLength][X] + s_GameInstance.m_snakes[iPlay].m_tailP[iLength][Y]) > 0)
-        {
-          LCD_SetPixel(s_GameInstance.m_snakes[iPlay].m_tailP[iLength][X], 
-                       s_GameInstance.m_snakes[iPlay].m_tailP[iLength][Y]);
-        }
-        else
-        {
-          return;
-        }
-      }
-    }
-    // Player 2 is dashed
-    else
-    {
-      // Draw Tail
-      for(int iLength = 0; iLength < s_GameInstance.m_snakes[iPlay].m_length; ++iLength)      
-      {
-        // Tail Piece is always drawn
-        if ( (iLength == (s_GameInstance.m_snakes[iPlay].m_length - 1)) || 
-             ((s_GameInstance.m_snakes[iPlay].m_tailP[iLength+1][X] + s_GameInstance.m_snakes[iPlay].m_tailP[iLength+1][Y]) == 0))
-        {
-          LCD_SetPixel(s_GameInstance.m_snakes[iPlay].m_tailP[iLength][X], 
-                       s_GameInstance.m_snakes[iPlay].m_tailP[iLength][Y]);
-          return;
-        }
-
-        // Draw Piece
-        if((iLength % 3) != 0)
-        {
-          LCD_SetPixel(s_GameInstance.m_snakes[iPlay].m_tailP[iLength][X], 
-                       s_GameInstance.m_snakes[iPlay].m_tailP[iLength][Y]);
-        }
-      }
-    }
-  }
-  
-  DrawPickup();
+  // Frame, Snakes and Pick-up
+  CameraDraw();
 }
 
 //----------------------------------------------------------------
 // Setup Snake Game Parameters
 void SetupGame()
 {
-  s_GameInstance.m_randHold = s_GameInstance.m_randSeed;
-  
-  // Setup Game
-  s_GameInstance.m_pickupPos[0] = 0;
-  s_GameInstance.m_pickupPos[1] = 0;
-  s_GameInstance.m_pickupValue = 0;
-    
-  memset(&(s_GameInstance.m_snakes[0]), NULL, sizeof(SnakeData));
-  memset(&(s_GameInstance.m_snakes[1]), NULL, sizeof(SnakeData));
-  
-  s_GameInstance.m_snakes[0].m_head[X] = 16;
-  s_GameInstance.m_snakes[0].m_head[Y] = 28;
-  s_GameInstance.m_snakes[0].m_length = 4;
-  s_GameInstance.m_snakes[0].m_dir = EAST;
+  // Silence the Last Game's Fanfare
+  soundStop();
   
-  s_GameInstance.m_snakes[1].m_head[X] = 110;
-  s_GameInstance.m_snakes[1].m_head[Y] = 28;
-  s_GameInstance.m_snakes[1].m_length = 4;
-  s_GameInstance.m_snakes[1].m_dir = WEST;
-  
-  // Generate first pickup
-  GeneratePickup();  
+  // Snakes and the First Pickup
+  GameSetup(&s_GameInstance);
+  playTune(s_pickupPlaced);
   
   // Setup Screen
   s_bRedraw = TRUE;
   
-  // Update State
-  s_GameInstance.m_currState = STATE_PLAYING;
+  // Fresh Network Counters
+  NetStatsBegin();
+  ProfileReset();
+  
 }
 
 
@@ -231,17 +194,58 @@ void StartGame(int StartKey)
   
   // Setup Random Seed based on running time and key
   s_GameInstance.m_randSeed = s_GameInstance.m_updateCount + StartKey;
-  s_GameInstance.m_randHold = s_GameInstance.m_randSeed;
   s_GameInstance.m_updateCount = 0;
     
   // Claim Host Status 
   s_GameInstance.m_isHost = TRUE;
   s_GameInstance.m_prevClientMove = NO_MOVE;
+  s_GameInstance.m_cpu = FALSE;
+  
+  // New Session - own address mixed in so hosts starting together differ
+  s_GameInstance.m_session  = (unsigned short)((s_GameInstance.m_randSeed * 40503u) ^ XBeeAddress());
+  if(s_GameInstance.m_session == 0)
+  {
+    s_GameInstance.m_session = 1;
+  }
+  s_GameInstance.m_peerAddr = 0;
   
   // Setup Game of Snake
   SetupGame();
 }
 
+//----------------------------------------------------------------
+// Start a Game against the CPU - this board alone, the CPU as snake 1
+void StartCpuGame(int StartKey)
+{
+  s_GameInstance.m_randSeed = s_GameInstance.m_updateCount + StartKey;
+  s_GameInstance.m_updateCount = 0;
+  
+  s_GameInstance.m_isHost = TRUE;
+  s_GameInstance.m_prevClientMove = NO_MOVE;
+  s_GameInstance.m_cpu = TRUE;
+  s_GameInstance.m_session = 0;
+  s_GameInstance.m_peerAddr = 0;
+  
+  CpuReset(&s_cpuPlayer);
+  s_cpuTickAt = TimerNow();
+  
+  SetupGame();
+}
+
+//----------------------------------------------------------------
+// Transmit Session Control Message - carries our address, not a move
+void TransmitSessionMessage(unsigned char msgType)
+{
+  SnakeMove msgData;
+  msgData.m_type          = msgType;
+  msgData.m_currDir       = NO_MOVE;
+  msgData.m_session       = s_GameInstance.m_session;
+  msgData.m_updateCount   = XBeeAddress();
+  msgData.m_randHold      = s_GameInstance.m_randSeed;
+
+  SendData( (char*)&msgData, sizeof(SnakeMove) ); 
+}
+
 //----------------------------------------------------------------
 // Join Running Game
 void JoinGame(SnakeMove* pRecieveMove)
@@ -252,23 +256,77 @@ void JoinGame(SnakeMove* pRecieveMove)
   // Setup Random Seed based on network Data
   s_GameInstance.m_updateCount      = 0;
   s_GameInstance.m_randSeed         = pRecieveMove->m_randHold;
-  s_GameInstance.m_randHold         = pRecieveMove->m_randHold;
   
   // Claim Host Status 
   s_GameInstance.m_isHost = FALSE;
   s_GameInstance.m_prevClientMove = NO_MOVE;
+  s_GameInstance.m_cpu = FALSE;
+  
+  // Claim the Session, then talk to the Host alone
+  s_GameInstance.m_session  = pRecieveMove->m_session;
+  s_GameInstance.m_peerAddr = (unsigned short)pRecieveMove->m_updateCount;
+  TransmitSessionMessage(MSG_JOIN);
+  XBeeSetDestination(s_GameInstance.m_peerAddr);
   
   // Setup Game of Snake
   SetupGame();
 }
 
+//----------------------------------------------------------------
+// Leave the Session and go back to Broadcast for the Lobby
+void LeaveSession()
+{
+  NetStatsEnd();
+  
+  // No-op unless the Destination was changed
+  XBeeSetDestination(ADDR_BROADCAST);
+  
+  s_GameInstance.m_session  = 0;
+  s_GameInstance.m_peerAddr = 0;
+  s_snapshotDue = FALSE;
+}
+
+//----------------------------------------------------------------
+// Transmit the Game so far to a Peer Joining Late
+// Sent ahead of the Move until the Peer answers it, but no more often
+// than SNAPSHOT_RESEND_MS - a long one takes a while to go.
+void TransmitSnapshot()
+{
+  int size;
+  
+  if(s_snapshotDue == FALSE || (long)(TimerNow() - s_snapshotAt) < 0)
+  {
+    return;
+  }
+  
+  size = SnapshotEncode(&s_GameInstance, s_snapshot);
+  SendData( (char*)s_snapshot, size );
+  s_snapshotAt = TimerNow() + SNAPSHOT_RESEND_MS;
+}
+
 //----------------------------------------------------------------
 // Transmit Local Move Data
 void TransmitLocalMove(char snakeDir, int turnOffset)
 {
-  // Setup Move
   SnakeMove moveData;
+  
+  // Unpaired Host: Advertise the Session instead
+  if(s_GameInstance.m_isHost == TRUE && s_GameInstance.m_peerAddr == 0)
+  {
+    TransmitSessionMessage(MSG_HOST);
+    return;
+  }
+  
+  // Peer Joining Late: the Game so far
+  if(s_GameInstance.m_isHost == TRUE)
+  {
+    TransmitSnapshot();
+  }
+  
+  // Setup Move
+  moveData.m_type         = MSG_MOVE;
   moveData.m_currDir      = snakeDir;
+  moveData.m_session      = s_GameInstance.m_session;
   moveData.m_updateCount  = s_GameInstance.m_updateCount + turnOffset;
   moveData.m_randHold     = s_GameInstance.m_randSeed;
 
@@ -276,6 +334,132 @@ void TransmitLocalMove(char snakeDir, int turnOffset)
   SendData( (char*)&moveData, sizeof(SnakeMove) ); 
 }
 
+//----------------------------------------------------------------
+// Receive a Snapshot from the Host
+// A client in a session waits for the rest of one whose header names
+// the session; anything else starting MSG_SNAPSHOT is a stray byte.
+// The game is loaded from it while the client is on its first frame -
+// it has just joined - and one sent again after that is read and
+// dropped.  Returns FALSE while the rest is still to come.
+static char RecvSnapshot()
+{
+  unsigned char header[SNAPSHOT_PEEK];
+  char          joining = (s_GameInstance.m_updateCount == 1);
+  int           size    = 0;
+  
+  if(s_GameInstance.m_session != 0 && s_GameInstance.m_isHost == FALSE)
+  {
+    if(RecvPeek((char*)header, SNAPSHOT_PEEK) == 0)
+    {
+      return FALSE;
+    }
+    size = SnapshotSize(header, s_GameInstance.m_session);
+  }
+  
+  if(size > 0 && RecvPeek((char*)s_snapshot, size) == 0)
+  {
+    return FALSE;
+  }
+  
+  // Damaged or not a Snapshot: Drop a byte to Resynchronise
+  if(size == 0 || SnapshotDecode(joining ? &s_GameInstance : NULL, s_snapshot, size) == FALSE)
+  {
+    RecvData((char*)header, 1);
+    NetStatsReject(REJECT_SYNC);
+    return TRUE;
+  }
+  
+  RecvData((char*)s_snapshot, size);
+  if(joining)
+  {
+    NetStatsSnapshot(size);
+  }
+  return TRUE;
+}
+
+//----------------------------------------------------------------
+// Receive Next Move for this Session
+// Handles the pairing messages and drops other games' traffic.  In the
+// lobby only MSG_HOST is returned, in a session only MSG_MOVE.
+char RecvMove(SnakeMove* pRecvMove)
+{
+  unsigned char msgType;
+  
+  while(RecvPeek((char*)&msgType, 1) > 0)
+  {
+    // The Game so far - taken here, not returned
+    if(msgType == MSG_SNAPSHOT)
+    {
+      if(RecvSnapshot() == FALSE)
+      {
+        return FALSE;
+      }
+      continue;
+    }
+    
+    // Not a message start: Drop a byte to Resynchronise
+    if(msgType != MSG_MOVE && msgType != MSG_HOST && msgType != MSG_JOIN)
+    {
+      RecvData((char*)&msgType, 1);
+      NetStatsReject(REJECT_SYNC);
+      continue;
+    }
+    
+    if(RecvData((char*)pRecvMove, sizeof(SnakeMove)) == 0)
+    {
+      return FALSE;
+    }
+    
+    // Lobby: Look for Hosts
+    if(s_GameInstance.m_session == 0)
+    {
+      if(msgType == MSG_HOST)
+      {
+        return TRUE;
+      }
+      continue;
+    }
+    
+    // Another Game
+    if(pRecvMove->m_session != s_GameInstance.m_session)
+    {
+      NetStatsReject(REJECT_SESSION);
+      continue;
+    }
+    
+    switch(msgType)
+    {
+    case MSG_MOVE:
+      return TRUE;
+      
+    case MSG_JOIN:
+      // First Claim Pairs with the Host, later ones are ignored.  A game
+      // under way is sent to the Peer before the next Move.
+      if(s_GameInstance.m_isHost == TRUE && s_GameInstance.m_peerAddr == 0 &&
+         pRecvMove->m_randHold == s_GameInstance.m_randSeed)
+      {
+        if(XBeeSetDestination((unsigned short)pRecvMove->m_updateCount) == 0)
+        {
+          s_GameInstance.m_peerAddr = (unsigned short)pRecvMove->m_updateCount;
+          s_snapshotDue = (s_GameInstance.m_updateCount > 1);
+          s_snapshotAt  = TimerNow();
+        }
+      }
+      break;
+      
+    case MSG_HOST:
+      // Host still Advertising: our Claim was lost
+      if(s_GameInstance.m_isHost == FALSE)
+      {
+        TransmitSessionMessage(MSG_JOIN);
+      }
+      break;
+    }
+  }
+  
+  return FALSE;
+}
+
 //----------------------------------------------------------------
 // Process and Sanitize Network Reciecved Input
 char ProcessRecievedMove(SnakeMove* pRecvMove)
@@ -290,13 +474,21 @@ char ProcessRecievedMove(SnakeMove* pRecvMove)
   if(pRecvMove->m_updateCount != s_GameInstance.m_updateCount)
   {
     // PrintErrorMessage("Update Frame Mismatch", pRecvMove->m_updateCount, s_GameInstance.m_updateCount, NULL);
+    NetStatsReject(REJECT_FRAME);
     return FALSE;
   }
   
   // Compare Rand Hold
   if(pRecvMove->m_randHold != s_GameInstance.m_randSeed)
   {
-    // PrintErrorMessage("Random Number Mismatch", pRecvMove->m_randHold, s_GameInstance.m_randHold, NULL);
+    // PrintErrorMessage("Random Number Mismatch", pRecvMove->m_randHold, s_GameInstance.m_randSeed, NULL);
+    NetStatsReject(REJECT_SEED);
+    return FALSE;
+  }
+  
+  // Not a Direction - a corrupted byte
+  if(pRecvMove->m_currDir > WEST)
+  {
     return FALSE;
   }
   
@@ -311,36 +503,68 @@ char ProcessRecievedMove(SnakeMove* pRecvMove)
 
 //----------------------------------------------------------------
 // LockStep Send
+// Everything already received is drained on each pass, so a backlog of
+// stale moves costs no waiting.  The move is only sent again once
+// RESEND_MS has passed without the peer's reply.  A Host whose Peer is
+// silent for PEER_LOST_MS goes back to advertising the session, so the
+// Peer - or another board - can join it again from the lobby.
 void LockStep(char snakeDir, int frameOffset)
 {
-  SnakeMove moveBuffer;
+  SnakeMove     moveBuffer;
+  int           retries = 0;
+  unsigned long resendAt = TimerNow() + RESEND_MS;
+  unsigned long lostAt = TimerNow() + PEER_LOST_MS;
+  
+  NetStatsWait();
   
   while(TRUE)
   {
-    memset(&moveBuffer, 0, sizeof(SnakeMove));
-    
-    // Listen for Response or till time out
-    if( RecvData((char*)&moveBuffer, sizeof(SnakeMove)) > 0)
+    // Listen for Response
+    while( RecvMove(&moveBuffer) == TRUE)
     {
       // Move Recieved: Advance
       if(ProcessRecievedMove(&moveBuffer) == TRUE)
       {
+        NetStatsAccept();
+        s_snapshotDue = FALSE;
         return;
       }
-      
     }
     
-    // Timed-out: Resend Host Move
-    TransmitLocalMove(snakeDir, frameOffset);
+    // Peer Lost: Advertise again - the timer only runs while paired
+    if(s_GameInstance.m_isHost == TRUE && s_GameInstance.m_peerAddr != 0 &&
+       (long)(TimerNow() - lostAt) >= 0)
+    {
+      XBeeSetDestination(ADDR_BROADCAST);
+      s_GameInstance.m_peerAddr = 0;
+      s_snapshotDue = FALSE;
+    }
+    if(s_GameInstance.m_peerAddr == 0)
+    {
+      lostAt = TimerNow() + PEER_LOST_MS;
+    }
+    
+    // Timed-out: Resend Move
+    if((long)(TimerNow() - resendAt) >= 0)
+    {
+      TransmitLocalMove(snakeDir, frameOffset);
+      NetStatsResend();
+      resendAt = TimerNow() + RESEND_MS;
+      ++retries;
+    }
     
-    // Cancel Lock
-    if(keyPress() == 0x0C)
+    // Cancel Lock - hold the key, so presses meant for the game stay queued
+    // - or the Host we joined paired with another board
+    if(keyIsDown(0x0C) ||
+       (s_GameInstance.m_isHost == FALSE && s_GameInstance.m_updateCount == 1 &&
+        retries > JOIN_RETRIES))
     {
+      LeaveSession();
       s_GameInstance.m_currState = STATE_WAITING_FOR_HOST; 
       return;
     }
     
-    Sleep(100);
+    Sleep(1);
   }
 }
 
@@ -348,8 +572,12 @@ void LockStep(char snakeDir, int frameOffset)
 // Update Network Host
 void UpdateNetHost()
 {
+  // This Tick's Turn
+  TakeTurn(&s_GameInstance.m_snakes[0]);
+  
   // Send Host Move
   TransmitLocalMove(s_GameInstance.m_snakes[0].m_dir, 0);
+  NetStatsSent();
  
   LockStep(s_GameInstance.m_snakes[0].m_dir, 0);
 }
@@ -359,40 +587,78 @@ void UpdateNetHost()
 void UpdateNetClient()
 {
   LockStep(s_GameInstance.m_prevClientMove, -1);
-    
-  // Send Client Move
+  if(s_GameInstance.m_currState != STATE_PLAYING)
+  {
+    return;
+  }
+  
+  // Presses made during the Wait still make this Tick
+  UpdateInput();
+  if(s_GameInstance.m_currState != STATE_PLAYING)
+  {
+    return;
+  }
+  TakeTurn(&s_GameInstance.m_snakes[1]);
+  
+  // Send Client Move - kept in case the Host asks for it again
+  s_GameInstance.m_prevClientMove = s_GameInstance.m_snakes[1].m_dir;
   TransmitLocalMove(s_GameInstance.m_snakes[1].m_dir, 0);
+  NetStatsSent();
 }
 
 //----------------------------------------------------------------
-// Update Network
-void UpdateNetwork()
+// Update against the CPU
+// Waits out the tick in place of the lockstep, then the CPU steers snake
+// 1 - timed in ZONE_CPU.  A late tick moves the next one on rather than
+// running a burst to catch up.
+void UpdateCpu()
 {
-  if(s_GameInstance.m_isHost == TRUE)
+  unsigned char dir;
+  
+  while((long)(TimerNow() - s_cpuTickAt) < 0)
   {
-    UpdateNetHost();
+    TimerIdle();
   }
-  else
+  s_cpuTickAt += CPU_TICK_MS;
+  if((long)(TimerNow() - s_cpuTickAt) >= 0)
   {
-    UpdateNetClient();
+    s_cpuTickAt = TimerNow() + CPU_TICK_MS;
+  }
+  
+  // Presses made during the Wait still make this Tick
+  UpdateInput();
+  if(s_GameInstance.m_currState != STATE_PLAYING)
+  {
+    return;
   }
+  TakeTurn(&s_GameInstance.m_snakes[0]);
+  
+  ProfileBegin(start);
+  dir = CpuDecide(&s_cpuPlayer, &s_GameInstance, 1);
+  ProfileEnd(ZONE_CPU, start);
+  
+  if(dir != NO_MOVE)
+  {
+    QueueTurn(&s_GameInstance.m_snakes[1], dir);
+  }
+  TakeTurn(&s_GameInstance.m_snakes[1]);
 }
 
 //----------------------------------------------------------------
-// Update Pos
-void UpdatePos(unsigned char* pPos, char dir)
+// Update Network
+void UpdateNetwork()
 {
-  if(pPos == NULL)
+  if(s_GameInstance.m_cpu == TRUE)
   {
-    return;
+    UpdateCpu();
   }
-  
-  switch(dir)
+  else if(s_GameInstance.m_isHost == TRUE)
+  {
+    UpdateNetHost();
+  }
+  else
   {
-    case NORTH: pPos[Y]--;     break;
-    case EAST:  pPos[X]++;     break;
-    case SOUTH: pPos[Y]++;     break;
-    case WEST:  pPos[X]--;     break;
+    UpdateNetClient();
   }
 }
 
@@ -419,72 +685,14 @@ void EndGame(int winner)
     LCD_PutString("LOSER....");
   }
 
-  // Play Little Fanfare
-  {
-    // E F G C DEF GABF ABCDE EFGC DEF GGED GED GED GFEDC
-    playNote(e3, 4);
-    Sleep(50);
-    
-    playNote(f3, 4);
-    Sleep(50);
-    
-    playNote(g3, 4);
-    Sleep(50);
-    
-    playNote(c3, 4);
-    Sleep(50);
-    
-    playNote(d3, 1);
-    playNote(e3, 1);
-    playNote(f3, 2);
-    Sleep(50);
-    
-    playNote(g3, 1);
-    playNote(a3, 1);
-    playNote(b3, 1);
-    playNote(f3, 1);
-    Sleep(50);
-    
-    playNote(a3, 1);
-    playNote(b3, 1);
-    playNote(c3, 1);
-    playNote(d3, 1);
-    playNote(e3, 1);
-    Sleep(50);
-    
-    playNote(e3, 1);
-    playNote(f3, 1);
-    playNote(g3, 1);
-    playNote(c3, 1);
-    Sleep(50);
-    
-    playNote(d3, 1);
-    playNote(e3, 1);
-    playNote(f3, 2);
-    Sleep(50);
-    
-    playNote(g3, 1);
-    playNote(g3, 1);
-    playNote(e3, 1);
-    playNote(d3, 1);
-    Sleep(50);
-    
-    playNote(g3, 1);
-    playNote(e3, 1);
-    playNote(d3, 2);
-    Sleep(50);
-    
-    playNote(g3, 1);
-    playNote(e3, 1);
-    playNote(d3, 2);
-    Sleep(50);
-    
-    playNote(g3, 1);
-    playNote(e3, 1);
-    playNote(f3, 1);
-    playNote(d3, 1);
-    playNote(c3, 1);
-  }
+  // Play Little Fanfare - under the Result, then the Counters
+  playTune(s_fanfare);
+  
+  // Back to Broadcast, and hold the Result before the Game's Network
+  // Counters clear it
+  LeaveSession();
+  Sleep(RESULT_MS);
+  NetStatsDraw();
   
   Sleep(3000);
   
@@ -497,159 +705,29 @@ void EndGame(int winner)
 }
 
 //----------------------------------------------------------------
-// Compare Two Positions
-char ComparePositions(const unsigned char* posA, const unsigned char* posB)
+// Update Game
+// One tick of the rules (GameRules.c), with the sound and the screen.
+// The game ends once however the snakes crash.
+void UpdateGame()
 {
-  if((posA[0] == posB[0]) && (posA[1] == posB[1]))
-  {
-    return TRUE;
-  }
-  
-  return FALSE;
-}
+  int winner;
+  int events = GameStep(&s_GameInstance, &winner);
 
-//----------------------------------------------------------------
-// Collision Sweep against Snakes
-char CollisionSweep(unsigned char* testPos)
-{
-  for(int iPlay = 0; iPlay < 2; ++iPlay)
+  if(events & EVENT_EATEN)
   {
-    // Check head
-    if(ComparePositions(testPos, s_GameInstance.m_snakes[iPlay].m_head) == TRUE)
-    {
-      // Collision and DEATH
-      iPlay = 3;    // Little trick to break sooner
-      return TRUE;        
-    }
-    
-    // Check Borders
-    if((testPos[X] < PLAY_OFFSETX) || 
-       (testPos[Y] < PLAY_OFFSETY) || 
-       (testPos[X] > (PLAY_OFFSETX + PLAY_WIDTH)) || 
-       (testPos[Y] > (PLAY_OFFSETY + PLAY_HEIGHT)) )
-    {
-        // Outside Bounds
-        iPlay = 3;    // Little trick to break sooner
-        return TRUE;
-    }
-  
-    // Check Tail
-    for(int iLength = 0; iLength < s_GameInstance.m_snakes[iPlay].m_length; ++iLength)      
-    {
-      if((s_GameInstance.m_snakes[iPlay].m_tailP[iLength][0] + s_GameInstance.m_snakes[iPlay].m_tailP[iLength][1]) == 0)
-      {
-        // Invalid Position ignore
-      }
-      else
-      {
-        if(ComparePositions(testPos, s_GameInstance.m_snakes[iPlay].m_tailP[iLength]) == TRUE)
-        {
-          // Collision and DEATH
-          iPlay = 3;    // Little trick to break sooner
-          return TRUE;
-        }
-      }
-    }
-  }
-  
-  return FALSE;
-}
-
-//----------------------------------------------------------------
-// Update Snake
-void UpdateSnake(int iPlay, SnakeData* pSnakeData)
-{
-  // Get Future Position
-  unsigned char newPos[2] = 
-  {
-    pSnakeData->m_head[X], 
-    pSnakeData->m_head[Y]
-  };
-  
-  UpdatePos(newPos, pSnakeData->m_dir);
-  
-  // Against Pickup
-  if(ComparePositions(newPos, s_GameInstance.m_pickupPos) == TRUE)
-  {
-    pSnakeData->m_score += s_GameInstance.m_pickupValue * 5;
-    pSnakeData->m_length += (s_GameInstance.m_pickupValue + 1) * 2;
-
     // Play Pickup Noise
-    playNote(a4, 2);
-    playNote(b4, 2);
-
-    // Make New Pickup
-    GeneratePickup(); 
-
-    // Redraw full screen to avoid artifacts from pick ups
-    s_bRedraw = TRUE;
-  }
-  // Against Snake 
-  else if(CollisionSweep(newPos) == TRUE)
-  {
-    EndGame(!iPlay);   
-  }
-  
-  // Move Head Forward
-  int iTail = pSnakeData->m_length;
-  while(iTail > 0)
-  {
-    pSnakeData->m_tailP[iTail][X] = pSnakeData->m_tailP[iTail-1][X];
-    pSnakeData->m_tailP[iTail][Y] = pSnakeData->m_tailP[iTail-1][Y];
-    
-    --iTail;
+    playTune(s_pickupEaten);
   }
-  
-  // Push Head onto Tail
-  pSnakeData->m_tailP[0][X] = pSnakeData->m_head[X];
-  pSnakeData->m_tailP[0][Y] = pSnakeData->m_head[Y];
-  
-  // Update Head
-  pSnakeData->m_head[X] = newPos[X];
-  pSnakeData->m_head[Y] = newPos[Y];
-}
 
-//----------------------------------------------------------------
-// Update Game
-void UpdateGame()
-{
-  // Special Case : Both Snakes going to same square
-  unsigned char newPos[2][2] = 
+  if(events & EVENT_PLACED)
   {
-    { 
-      s_GameInstance.m_snakes[0].m_head[X], 
-      s_GameInstance.m_snakes[0].m_head[Y] 
-    },
-    { 
-      s_GameInstance.m_snakes[1].m_head[X], 
-      s_GameInstance.m_snakes[1].m_head[Y] 
-    },
-  };
-  
-  // Update Position
-  UpdatePos(newPos[0], s_GameInstance.m_snakes[0].m_dir);
-  UpdatePos(newPos[1], s_GameInstance.m_snakes[1].m_dir);
-  
-  if(ComparePositions(newPos[0], newPos[1]))
-  {
-    // Both Moving into Same Space
-    EndGame(-1);
+    playTune(s_pickupPlaced);
   }
-  
-  // Update Snake
-  UpdateSnake(0, &(s_GameInstance.m_snakes[0]));
-  UpdateSnake(1, &(s_GameInstance.m_snakes[1]));
 
-  // Update Pickup Timer
-  if(s_GameInstance.m_pickupTime > 1)
+  if(events & EVENT_OVER)
   {
-    s_GameInstance.m_pickupTime -= 1;
+    EndGame(winner);
   }
-  else
-  {
-    GeneratePickup();
-  }
-  
 }
 
 //----------------------------------------------------------------
@@ -657,77 +735,66 @@ void UpdateGame()
 //
 void GeneratePickup()
 {
-  playNote(c4, 2);
-  playNote(e4, 2);
-
-  // Get New Value
-  s_GameInstance.m_pickupValue = (s_GameInstance.m_pickupValue + 1) % 3;
-  s_GameInstance.m_pickupTime = (s_GameInstance.m_pickupValue + 1) * 100;
-    
-  int passTest = FALSE;  
-  while(passTest == FALSE)
-  {
-    // Pass Test
-    passTest = TRUE;
-    
-    // Pick a New Position
-    s_GameInstance.m_pickupPos[X] = (RandomNumber() % PLAY_WIDTH)  + PLAY_OFFSETX;
-    s_GameInstance.m_pickupPos[Y] = (RandomNumber() % PLAY_HEIGHT) + PLAY_OFFSETY;
-    
-    // Collision Check
-    if(CollisionSweep(s_GameInstance.m_pickupPos) == TRUE)
-    {
-      // Fail so retry
-      passTest = FALSE;
-    }
-  }
-  
-  // Done
+  playTune(s_pickupPlaced);
+  PlacePickup(&s_GameInstance);
 }
 
 //----------------------------------------------------------------
 // PauseGame
 void PauseGame() 
 {
-  int key = keyPress();
+  int key;
   
   // Infinite Loop effectively pauses the game
   // Then because the networking is lock-stepped there is no advancement on the client
   while(TRUE)
   {
-    key = keyPress();
+    key = keyPoll();
     
     if( key == 0x05 )
     {
       return;
     }
+    
+    // Keys are scanned by the Heartbeat - sleep until it runs
+    TimerIdle();
   }
 }
 
 //----------------------------------------------------------------
 // Update Input
-// This just needs to correct the direction of travel
+// Direction keys queue turns for the local snake; every press since the
+// last call is read, so a quick double turn is not lost.
 void UpdateInput()
 {
-  int key = keyPress();
+  SnakeData* pLocal = &s_GameInstance.m_snakes[!s_GameInstance.m_isHost];
+  KeyEvent   event;
   
-  if( key != -1 )
+  while(s_GameInstance.m_currState == STATE_PLAYING && keyEvent(&event))
   {
-    switch (key)
+    if(!event.pressed)
     {
-    case 0x02:	s_GameInstance.m_snakes[!s_GameInstance.m_isHost].m_dir = NORTH;    break;
-    case 0x04:	s_GameInstance.m_snakes[!s_GameInstance.m_isHost].m_dir = WEST;     break;
-    case 0x06:	s_GameInstance.m_snakes[!s_GameInstance.m_isHost].m_dir = EAST;     break;
-    case 0x08:	s_GameInstance.m_snakes[!s_GameInstance.m_isHost].m_dir = SOUTH;    break;
-  
-    case 0x05: // Pause Game
-      if(s_GameInstance.m_currState == STATE_PLAYING)
+      continue;
+    }
+    
+    switch (event.key)
+    {
+    case 0x02:
+    case 0x04:
+    case 0x06:
+    case 0x08:
+      if(TimerNow() - event.time <= TURN_MAX_AGE_MS)
       {
-        PauseGame();
+        QueueTurn(pLocal, KeyDir(event.key));
       }
       break;
+  
+    case 0x05: // Pause Game
+      PauseGame();
+      break;
      
     case 0x0C:
+      LeaveSession();
       s_GameInstance.m_currState = STATE_WAITING_FOR_HOST;      
       break;
     }
@@ -735,45 +802,91 @@ void UpdateInput()
 }
 
 //----------------------------------------------------------------
-// Minimal Render Update of Snake
-void MinRenderSnake(int iPlay, SnakeData* pSnakeData)
+// Is a Snake drawn dashed
+// Player 2 is, once it has a body to dash.
+static char Dashed(int iSnake)
 {
-  // Clear Tail
-  if((pSnakeData->m_tailP[pSnakeData->m_length][X] + pSnakeData->m_tailP[pSnakeData->m_length][Y]) > 0)
-  {
-    LCD_ClearPixel(pSnakeData->m_tailP[pSnakeData->m_length][X], 
-                   pSnakeData->m_tailP[pSnakeData->m_length][Y]);
-  }
-  
-  // Draw Head
-  LCD_SetPixel(pSnakeData->m_head[X], pSnakeData->m_head[Y]);
+  return iSnake == s_GameInstance.m_isHost && SNAKE_LAID(&s_GameInstance.m_snakes[iSnake]) > 0;
+}
 
-  if(iPlay == s_GameInstance.m_isHost) 
+//----------------------------------------------------------------
+// Render the Tick's Changes
+// Only squares GameRules.c says changed are written, through the camera.
+// Player 2 is dashed: the piece behind its head is cleared when
+// CameraGap() makes it a gap, and its tail end, which may be a gap, is
+// drawn whenever it moves.  m_value is a snake only for head, freed and score changes.
+void RenderChanges()
+{
+  char pickup = FALSE;
+
+  for(int i = 0; i < s_GameInstance.m_numChanges; ++i)
   {
-    // Draw Tail (might have been blank)
-    LCD_SetPixel(pSnakeData->m_tailP[pSnakeData->m_length-1][X], 
-                 pSnakeData->m_tailP[pSnakeData->m_length-1][Y]);
+    const GameChange* pChange = &s_GameInstance.m_changes[i];
 
-    // Clear every 3rd pixel
-    if((s_GameInstance.m_updateCount % 3) == 0)
+    switch(pChange->m_type)
     {
-      LCD_ClearPixel(pSnakeData->m_tailP[0][X], pSnakeData->m_tailP[0][Y]);
+    case CHANGE_HEAD:
+      CameraSetPixel(pChange->m_pos);
+
+      if(Dashed(pChange->m_value) && CameraGap(&s_GameInstance.m_snakes[pChange->m_value], 0))
+      {
+        unsigned char neck[2] = { pChange->m_pos[X], pChange->m_pos[Y] };
+
+        UpdatePos(neck, BodyDir(&s_GameInstance.m_snakes[pChange->m_value], 0));
+        CameraClearPixel(neck);
+      }
+      break;
+
+    case CHANGE_FREED:
+      CameraClearPixel(pChange->m_pos);
+
+      if(Dashed(pChange->m_value))
+      {
+        CameraSetPixel(s_GameInstance.m_snakes[pChange->m_value].m_tail);
+      }
+      break;
+
+    case CHANGE_PICKUP:
+      // Old sprites all go before the new one is drawn
+      CameraPickup(pChange->m_pos, pChange->m_value, FALSE);
+      pickup = TRUE;
+      break;
+
+    case CHANGE_SCORE:
+      RedrawPlayerScore(pChange->m_value);
+      break;
     }
   }
+
+  if(pickup)
+  {
+    DrawPickup();
+  }
+
+  s_GameInstance.m_numChanges = 0;
 }
 
 //----------------------------------------------------------------
 // Update Screen
+// The whole screen is only drawn for a new game, or after an error
+// message or when more changed than m_changes holds.  The changes go
+// through the camera, into its image for the columns of a step not yet
+// sent, and the step's share of columns goes out after them.
 void UpdateScreen()
 {
+  const unsigned char* pLocal = s_GameInstance.m_snakes[!s_GameInstance.m_isHost].m_head;
+
   // Fullscreen Redraw
-  if(s_bRedraw == TRUE)
+  if(s_bRedraw == TRUE || s_GameInstance.m_numChanges > GAME_CHANGES)
   {
+    CameraCentre(pLocal);
     RedrawFullGame();
     s_bRedraw = FALSE;
+    s_GameInstance.m_numChanges = 0;
+    return;
   }
-  
-  MinRenderSnake(0, &(s_GameInstance.m_snakes[0]));
-  MinRenderSnake(1, &(s_GameInstance.m_snakes[1]));
-  DrawPickup();
+
+  CameraFollow(pLocal);
+  RenderChanges();
+  CameraSend(CAMERA_BYTES);
 }
@@ -1,6 +1,11 @@
 //
 
-#define MAX_SNAKE_LENGTH 100
+// Body ring - BODY_RING pieces behind the head, 2 bits each.  A power
+// of 2, so ring indices wrap with a mask.
+#ifndef BODY_RING
+#define BODY_RING 	1024
+#endif
+#define MAX_SNAKE_LENGTH (BODY_RING - 1)
 
 // Directions are stored as
 
@@ -13,6 +18,12 @@
 #define TRUE  1
 #define FALSE 0
 
+// Turns a player may queue ahead - one is taken per tick
+#define TURN_QUEUE 	3
+
+// Presses older than this when read are dropped - made during a stall
+#define TURN_MAX_AGE_MS 500
+
 #define X 0
 #define Y 1
 
@@ -20,38 +31,114 @@
 #define STATE_PLAYING 		1
 #define STATE_GAME_OVER		2
 
+// Network message types - the first byte of every SnakeMove.  Values are
+// unlikely in a misaligned stream so the receiver can resynchronise.
+#define MSG_MOVE 	0xA1	// Lockstep move within a session
+#define MSG_HOST 	0xA2	// Unpaired host advertising a session (broadcast)
+#define MSG_JOIN 	0xA3	// Reply to MSG_HOST claiming the session
+#define MSG_SNAPSHOT 	0xA4	// Game so far, for a board joining late (Snapshot.h)
+
+#define ADDR_BROADCAST 	0xFFFF
+
 #define PLAY_WIDTH   125
 #define PLAY_HEIGHT  53
 #define PLAY_OFFSETX 1
 #define PLAY_OFFSETY 9
 
+// World - the board the snakes play on, squares PLAY_OFFSETX:PLAY_OFFSETY
+// to WORLD_WIDTH:WORLD_HEIGHT past them, as the play area's are.  The
+// screen shows PLAY_WIDTH x PLAY_HEIGHT of it through the camera
+// (Camera.c).  Below 253 wide, so a square over the edge still fits a byte.
+#ifndef WORLD_WIDTH
+#define WORLD_WIDTH  (PLAY_WIDTH * 2)
+#endif
+#ifndef WORLD_HEIGHT
+#define WORLD_HEIGHT (PLAY_HEIGHT * 2)
+#endif
+
+// Occupancy map - a bit for every world square and the border round it,
+// set under each head and body piece of both snakes
+#define OCCUPY_ROW 	(PLAY_OFFSETX + WORLD_WIDTH + 2 <= 128 ? 128 : 256)
+#define OCCUPY_ROWS 	(PLAY_OFFSETY + WORLD_HEIGHT + 2)
+
+// Pickup balance - for a pickup of value 0, 1 or 2
+#ifndef PICKUP_SCORE
+#define PICKUP_SCORE(v)  ((v) * 5)          // Added to the score
+#endif
+#ifndef PICKUP_GROWTH
+#define PICKUP_GROWTH(v) (((v) + 1) * 2)    // Added to the length
+#endif
+#ifndef PICKUP_TIME
+#define PICKUP_TIME(v)   (((v) + 1) * 100)  // Ticks before it moves
+#endif
+
+// GameStep() and UpdateSnake() events
+#define EVENT_EATEN 	0x01	// A snake ate the pickup
+#define EVENT_PLACED 	0x02	// A new pickup was placed
+#define EVENT_OVER 	0x04	// The game ended
+#define EVENT_CRASHED 	0x08	// UpdateSnake() only - hit a snake or border
+
+// Screen changes - what a tick did to the board, for UpdateScreen()
+#define CHANGE_HEAD 	1	// m_pos is a snake's new head
+#define CHANGE_FREED 	2	// m_pos was left by a snake's tail end
+#define CHANGE_PICKUP 	3	// The pickup moved away from m_pos
+#define CHANGE_SCORE 	4	// A snake's score went up
+
+// Changes kept for a tick - both snakes moving and eating take 8
+#define GAME_CHANGES 	12
+
+typedef struct GameChange_
+{
+	unsigned char   m_type;     // CHANGE_
+	unsigned char   m_value;    // The snake, or the pickup's old value
+	unsigned char   m_pos[2];   // Square X:Y
+} GameChange;
+
 typedef struct SnakeData_
 {
 	unsigned char 	m_dir; 		 		// Snake current facing Position
-	unsigned char 	m_length; 		 	// Current Length NOT including Tail
 	unsigned char 	m_head[2]; 	 		// Snake head Position X:Y
-	unsigned char   m_tailP[MAX_SNAKE_LENGTH+1][2];	// Absolute Tail pieces
+	unsigned char 	m_tail[2]; 	 		// Last body piece X:Y, if any are laid
+	unsigned char 	m_freed[2]; 	 		// Square the tail left this tick, 0:0 if none
+	unsigned short 	m_length; 		 	// Current Length NOT including Head
+	unsigned short 	m_grow; 		 	// Pieces of m_length not laid yet
+	unsigned short 	m_bodyFirst; 		 	// Ring index of the piece behind the head
+	unsigned char   m_body[BODY_RING / 4];		// Direction to each piece from the one before, 2 bits
 	int 	        m_score; 			// Current Score
+	unsigned char   m_turns[TURN_QUEUE];		// Turns waiting, oldest first
+	unsigned char   m_numTurns;			// Turns in m_turns
 } SnakeData;
 
+// Body pieces on the board - the rest of m_length is still to grow
+#define SNAKE_LAID(pSnakeData) ((pSnakeData)->m_length - (pSnakeData)->m_grow)
+
 typedef struct SnakeGame_
 {
 	int             m_updateCount;      // Tracks Update Loop Count
 	int 		m_randSeed;         // Initial Random Seed
-	int 		m_randHold;         // Holding Last Random Iteration
+	int 		m_randFrame;        // GameSteps since GameSetup - keys the random draws
+	int 		m_randDraw;         // Random numbers drawn this frame
  	unsigned char   m_isHost; 	    // Am I the Host
 	unsigned char   m_pickupPos[2];     // Reward Position X:Y
 	unsigned char   m_pickupValue;      // Pickup Value
         unsigned char   m_pickupTime;       // Pickup Timer
 	unsigned char   m_currState;        // current State
 	unsigned char   m_prevClientMove;   // Need to store for timeout situation
+	unsigned short  m_session;          // Session ID, 0 in the lobby
+	unsigned short  m_peerAddr;         // Paired board's XBee MY, 0 if none
+	unsigned char   m_cpu;              // Snake 1 played by CpuPlayer.c - no radio
  	SnakeData	m_snakes[2];        // Snake Data
+	unsigned char   m_occupied[OCCUPY_ROW * OCCUPY_ROWS / 8]; // Snake squares - a bit each
+	GameChange      m_changes[GAME_CHANGES]; // Screen changes since the last render
+	unsigned char   m_numChanges;       // Changes made - over GAME_CHANGES when some were lost
 } SnakeGame;
 
 typedef struct SnakeMove_
 {
+   unsigned char  m_type;             // MSG_MOVE, MSG_HOST or MSG_JOIN
    unsigned char  m_currDir;          // My current direction of travel
-   int            m_updateCount;      // Current Frame
+   unsigned short m_session;          // Session the message belongs to
+   int            m_updateCount;      // Current Frame (HOST/JOIN: sender's MY)
    int            m_randHold;         // Last rand used
 } SnakeMove;
 
@@ -59,14 +146,34 @@ extern SnakeGame s_GameInstance;
 
 // ------ Functions
 void StartGame(int StartKey);
+void StartCpuGame(int StartKey);
 void JoinGame(SnakeMove* pRecieveMove);
 void UpdateNetwork();
 void UpdateGame();
 void UpdateInput();
 void UpdateScreen();
+void RedrawFullGame();
 void DrawGameOver();
 void GeneratePickup();
 char ProcessRecievedMove(SnakeMove* pRecvMove);
+char RecvMove(SnakeMove* pRecvMove);
+void LeaveSession();
 
-
-
+// ------ Rules (GameRules.c) - any SnakeGame, no hardware
+unsigned char ReverseDir(unsigned char dir);
+int RandomAt(int seed, int frame, int draw);
+int RandomNumber(SnakeGame* pGame);
+void UpdatePos(unsigned char* pPos, char dir);
+char ComparePositions(const unsigned char* posA, const unsigned char* posB);
+char SquareTaken(const SnakeGame* pGame, const unsigned char* testPos);
+char CollisionSweep(const SnakeGame* pGame, const unsigned char* testPos);
+void PlacePickup(SnakeGame* pGame);
+void GameSetup(SnakeGame* pGame);
+void SnakeStart(SnakeGame* pGame, int iPlay, unsigned char x, unsigned char y, unsigned char dir, int length);
+void SnakeLay(SnakeGame* pGame, int iPlay);
+unsigned char BodyDir(const SnakeData* pSnakeData, int iPiece);
+void MoveSnake(SnakeGame* pGame, int iPlay);
+int UpdateSnake(SnakeGame* pGame, int iPlay);
+int GameStep(SnakeGame* pGame, int* pWinner);
+void QueueTurn(SnakeData* pSnakeData, unsigned char dir);
+void TakeTurn(SnakeData* pSnakeData);
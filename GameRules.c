@@ -0,0 +1,477 @@
+#include "GameHeader.h"
+#include <string.h>
+#include "config.h"
+#include "Profile.h"
+
+// The Rules of the Game - movement, collisions, pickups and the winner.
+// Everything here works on the SnakeGame it is given and touches no
+// hardware, so the same code runs the board's s_GameInstance and any
+// number of headless games (tournament/Tournament.c).  GameCore.c adds
+// the sound, the screen and the network around it.
+
+// Snake 0's Start - where it was on the one screen board, moved to the
+// middle of the world
+#define START_X 	(PLAY_OFFSETX + (WORLD_WIDTH - PLAY_WIDTH) / 2 + 15)
+#define START_Y 	(PLAY_OFFSETY + (WORLD_HEIGHT - PLAY_HEIGHT) / 2 + 19)
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Opposite Direction
+unsigned char ReverseDir(unsigned char dir)
+{
+  return (unsigned char)((dir + 1) % 4 + 1);
+}
+
+//----------------------------------------------------------------
+// Mix 32 Bits - MurmurHash3's finaliser, every input bit reaching every
+// output bit.  Unsigned int is 32 bits on the board and the host alike.
+static unsigned int RandomMix(unsigned int h)
+{
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+//----------------------------------------------------------------
+// Random Number for a Seed, Frame and Draw - 0 to 0x7fff
+// Nothing is carried from one draw to the next, so any frame's numbers
+// can be had without playing the frames before it.  The frame picks a
+// key and the draw steps from it by the golden ratio, as SplitMix does.
+int RandomAt(int seed, int frame, int draw)
+{
+  unsigned int key = RandomMix((unsigned int)seed + (unsigned int)frame * 0x9E3779B9u);
+
+  return (int)((RandomMix(key + (unsigned int)draw * 0x9E3779B9u) >> 16) & 0x7fff);
+}
+
+//----------------------------------------------------------------
+// Get Random Number - the next draw of the game's frame
+int RandomNumber(SnakeGame* pGame)
+{
+  return RandomAt(pGame->m_randSeed, pGame->m_randFrame, pGame->m_randDraw++);
+}
+
+//----------------------------------------------------------------
+// Update Pos
+void UpdatePos(unsigned char* pPos, char dir)
+{
+  if(pPos == NULL)
+  {
+    return;
+  }
+
+  switch(dir)
+  {
+    case NORTH: pPos[Y]--;     break;
+    case EAST:  pPos[X]++;     break;
+    case SOUTH: pPos[Y]++;     break;
+    case WEST:  pPos[X]--;     break;
+  }
+}
+
+//----------------------------------------------------------------
+// Compare Two Positions
+char ComparePositions(const unsigned char* posA, const unsigned char* posB)
+{
+  if((posA[0] == posB[0]) && (posA[1] == posB[1]))
+  {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+//----------------------------------------------------------------
+// Occupancy Map Bits
+static int Occupied(const SnakeGame* pGame, const unsigned char* pPos)
+{
+  int bit = pPos[Y] * OCCUPY_ROW + pPos[X];
+
+  return pGame->m_occupied[bit >> 3] & (1 << (bit & 7));
+}
+
+static void Occupy(SnakeGame* pGame, const unsigned char* pPos)
+{
+  int bit = pPos[Y] * OCCUPY_ROW + pPos[X];
+
+  pGame->m_occupied[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+}
+
+static void Vacate(SnakeGame* pGame, const unsigned char* pPos)
+{
+  int bit = pPos[Y] * OCCUPY_ROW + pPos[X];
+
+  pGame->m_occupied[bit >> 3] &= (unsigned char)~(1 << (bit & 7));
+}
+
+//----------------------------------------------------------------
+// Note a Screen Change for the Renderer
+// Once the list is full the count still goes up, one past GAME_CHANGES,
+// and the whole screen is redrawn instead.
+static void AddChange(SnakeGame* pGame, unsigned char type, unsigned char value, const unsigned char* pPos)
+{
+  if(pGame->m_numChanges < GAME_CHANGES)
+  {
+    GameChange* pChange = &pGame->m_changes[pGame->m_numChanges];
+
+    pChange->m_type   = type;
+    pChange->m_value  = value;
+    pChange->m_pos[X] = pPos[X];
+    pChange->m_pos[Y] = pPos[Y];
+  }
+  if(pGame->m_numChanges <= GAME_CHANGES)
+  {
+    pGame->m_numChanges++;
+  }
+}
+
+//----------------------------------------------------------------
+// Sweep a Position against both Snakes and the Borders
+// Untimed - for the renderer as much as the rules.
+char SquareTaken(const SnakeGame* pGame, const unsigned char* testPos)
+{
+  // Check Borders
+  if((testPos[X] < PLAY_OFFSETX) ||
+     (testPos[Y] < PLAY_OFFSETY) ||
+     (testPos[X] > (PLAY_OFFSETX + WORLD_WIDTH)) ||
+     (testPos[Y] > (PLAY_OFFSETY + WORLD_HEIGHT)) )
+  {
+    // Outside Bounds
+    return TRUE;
+  }
+
+  // Check Heads and Tails
+  if(Occupied(pGame, testPos))
+  {
+    // Collision and DEATH
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+//----------------------------------------------------------------
+// Collision Sweep against Snakes - timed in ZONE_COLLISION
+char CollisionSweep(const SnakeGame* pGame, const unsigned char* testPos)
+{
+  char hit;
+
+  ProfileBegin(start);
+  hit = SquareTaken(pGame, testPos);
+  ProfileEnd(ZONE_COLLISION, start);
+  return hit;
+}
+
+//----------------------------------------------------------------
+// Place the Next Pickup on a Free Square
+// The value cycles 0, 1, 2.  m_pickupTime is a byte, so the biggest
+// pickup's PICKUP_TIME wraps - it stays up for 44 ticks, not 300.
+void PlacePickup(SnakeGame* pGame)
+{
+  // The Old Pickup is to be Erased - none before the first
+  if(pGame->m_pickupPos[X] != 0)
+  {
+    AddChange(pGame, CHANGE_PICKUP, pGame->m_pickupValue, pGame->m_pickupPos);
+  }
+
+  // Get New Value
+  pGame->m_pickupValue = (pGame->m_pickupValue + 1) % 3;
+  pGame->m_pickupTime = (unsigned char)PICKUP_TIME(pGame->m_pickupValue);
+
+  do
+  {
+    // Pick a New Position
+    pGame->m_pickupPos[X] = (RandomNumber(pGame) % WORLD_WIDTH)  + PLAY_OFFSETX;
+    pGame->m_pickupPos[Y] = (RandomNumber(pGame) % WORLD_HEIGHT) + PLAY_OFFSETY;
+  } while(CollisionSweep(pGame, pGame->m_pickupPos) == TRUE);
+}
+
+//----------------------------------------------------------------
+// Setup a Game - both Snakes at the Start and the First Pickup
+void GameSetup(SnakeGame* pGame)
+{
+  pGame->m_randFrame = 0;
+  pGame->m_randDraw = 0;
+
+  // Setup Game
+  pGame->m_pickupPos[0] = 0;
+  pGame->m_pickupPos[1] = 0;
+  pGame->m_pickupValue = 0;
+  pGame->m_numChanges = 0;
+
+  memset(pGame->m_occupied, 0, sizeof(pGame->m_occupied));
+  SnakeStart(pGame, 0, START_X, START_Y, EAST, 4);
+  SnakeStart(pGame, 1, START_X + 94, START_Y, WEST, 4);
+
+  // Generate first pickup
+  PlacePickup(pGame);
+
+  pGame->m_currState = STATE_PLAYING;
+}
+
+//----------------------------------------------------------------
+// Start a Snake - a head alone, with length pieces to grow behind it
+// The occupancy map must be clear of any snake it had before.
+void SnakeStart(SnakeGame* pGame, int iPlay, unsigned char x, unsigned char y, unsigned char dir, int length)
+{
+  SnakeData* pSnakeData = &pGame->m_snakes[iPlay];
+
+  memset(pSnakeData, 0, sizeof(SnakeData));
+  pSnakeData->m_head[X] = x;
+  pSnakeData->m_head[Y] = y;
+  pSnakeData->m_dir     = dir;
+  pSnakeData->m_length  = (unsigned short)length;
+  pSnakeData->m_grow    = (unsigned short)length;
+
+  Occupy(pGame, pSnakeData->m_head);
+}
+
+//----------------------------------------------------------------
+// Lay a Snake on the Occupancy Map - its head and every laid piece
+// For a snake whose body ring was filled in whole (Snapshot.c) rather
+// than moved there.  m_tail is left on its last piece.
+void SnakeLay(SnakeGame* pGame, int iPlay)
+{
+  SnakeData*    pSnakeData = &pGame->m_snakes[iPlay];
+  unsigned char pos[2]     = { pSnakeData->m_head[X], pSnakeData->m_head[Y] };
+  int           laid       = SNAKE_LAID(pSnakeData);
+
+  Occupy(pGame, pos);
+  for(int iPiece = 0; iPiece < laid; ++iPiece)
+  {
+    UpdatePos(pos, BodyDir(pSnakeData, iPiece));
+    Occupy(pGame, pos);
+  }
+
+  if(laid > 0)
+  {
+    pSnakeData->m_tail[X] = pos[X];
+    pSnakeData->m_tail[Y] = pos[Y];
+  }
+}
+
+//----------------------------------------------------------------
+// Direction to a Body Piece from the one before it - the head for piece 0
+// Walk a snake from the head with UpdatePos(), piece by piece.
+unsigned char BodyDir(const SnakeData* pSnakeData, int iPiece)
+{
+  int ring = (pSnakeData->m_bodyFirst + iPiece) & (BODY_RING - 1);
+
+  return (unsigned char)(((pSnakeData->m_body[ring >> 2] >> ((ring & 3) << 1)) & 3) + 1);
+}
+
+//----------------------------------------------------------------
+// Move Snake - one square forward, without looking
+// The head is pushed onto the body ring.  The tail end is popped unless
+// there are pieces still to grow, and its square left in m_freed.  Both
+// squares are noted for the renderer.
+RAMFUNC void MoveSnake(SnakeGame* pGame, int iPlay)
+{
+  SnakeData* pSnakeData = &pGame->m_snakes[iPlay];
+  int        laid       = SNAKE_LAID(pSnakeData);
+  int        ring;
+  int        shift;
+
+  pSnakeData->m_freed[X] = 0;
+  pSnakeData->m_freed[Y] = 0;
+
+  // Push Head onto Body - the way back to it from the new head
+  pSnakeData->m_bodyFirst = (unsigned short)((pSnakeData->m_bodyFirst - 1) & (BODY_RING - 1));
+  ring  = pSnakeData->m_bodyFirst;
+  shift = (ring & 3) << 1;
+  pSnakeData->m_body[ring >> 2] = (unsigned char)((pSnakeData->m_body[ring >> 2] & ~(3 << shift)) |
+                                                  ((ReverseDir(pSnakeData->m_dir) - 1) << shift));
+  if(laid == 0)
+  {
+    pSnakeData->m_tail[X] = pSnakeData->m_head[X];
+    pSnakeData->m_tail[Y] = pSnakeData->m_head[Y];
+  }
+  laid++;
+
+  // Pop the Tail End - back one piece towards the head
+  if(pSnakeData->m_grow > 0)
+  {
+    pSnakeData->m_grow--;
+  }
+  else
+  {
+    pSnakeData->m_freed[X] = pSnakeData->m_tail[X];
+    pSnakeData->m_freed[Y] = pSnakeData->m_tail[Y];
+    Vacate(pGame, pSnakeData->m_tail);
+    AddChange(pGame, CHANGE_FREED, (unsigned char)iPlay, pSnakeData->m_tail);
+
+    UpdatePos(pSnakeData->m_tail, ReverseDir(BodyDir(pSnakeData, laid - 1)));
+  }
+
+  // Update Head
+  UpdatePos(pSnakeData->m_head, pSnakeData->m_dir);
+  Occupy(pGame, pSnakeData->m_head);
+  AddChange(pGame, CHANGE_HEAD, (unsigned char)iPlay, pSnakeData->m_head);
+}
+
+//----------------------------------------------------------------
+// Update Snake - one square forward
+// Returns EVENT_EATEN and EVENT_PLACED if it ate the pickup, which is
+// placed again, or EVENT_CRASHED if it hit a snake or a border.  It moves
+// either way.
+RAMFUNC int UpdateSnake(SnakeGame* pGame, int iPlay)
+{
+  SnakeData* pSnakeData = &pGame->m_snakes[iPlay];
+  int events = 0;
+
+  // Get Future Position
+  unsigned char newPos[2] =
+  {
+    pSnakeData->m_head[X],
+    pSnakeData->m_head[Y]
+  };
+
+  UpdatePos(newPos, pSnakeData->m_dir);
+
+  // Against Pickup
+  if(ComparePositions(newPos, pGame->m_pickupPos) == TRUE)
+  {
+    int growth = PICKUP_GROWTH(pGame->m_pickupValue);
+
+    // The body ring holds no more
+    if(pSnakeData->m_length + growth > MAX_SNAKE_LENGTH)
+    {
+      growth = MAX_SNAKE_LENGTH - pSnakeData->m_length;
+    }
+
+    pSnakeData->m_score += PICKUP_SCORE(pGame->m_pickupValue);
+    AddChange(pGame, CHANGE_SCORE, (unsigned char)iPlay, newPos);
+    pSnakeData->m_length = (unsigned short)(pSnakeData->m_length + growth);
+    pSnakeData->m_grow   = (unsigned short)(pSnakeData->m_grow + growth);
+
+    // Make New Pickup
+    PlacePickup(pGame);
+
+    events = EVENT_EATEN | EVENT_PLACED;
+  }
+  // Against Snake
+  else if(CollisionSweep(pGame, newPos) == TRUE)
+  {
+    events = EVENT_CRASHED;
+  }
+
+  MoveSnake(pGame, iPlay);
+
+  return events;
+}
+
+//----------------------------------------------------------------
+// Step the Game one Tick
+// Returns the EVENT_ flags for the tick.  What it changed on the board
+// is added to m_changes for the renderer, which empties it.  With EVENT_OVER the winner is
+// left in *pWinner, -1 for a draw: both snakes heading into the same
+// square, or both crashing on the same tick.  Snake 0 moves first, so
+// snake 1 is swept against where it has moved to.
+int GameStep(SnakeGame* pGame, int* pWinner)
+{
+  // Special Case : Both Snakes going to same square
+  unsigned char newPos[2][2] =
+  {
+    {
+      pGame->m_snakes[0].m_head[X],
+      pGame->m_snakes[0].m_head[Y]
+    },
+    {
+      pGame->m_snakes[1].m_head[X],
+      pGame->m_snakes[1].m_head[Y]
+    },
+  };
+  int events = 0;
+  int crashed[2];
+
+  // A Fresh Frame of Random Numbers
+  pGame->m_randFrame++;
+  pGame->m_randDraw = 0;
+
+  // Update Position
+  UpdatePos(newPos[0], pGame->m_snakes[0].m_dir);
+  UpdatePos(newPos[1], pGame->m_snakes[1].m_dir);
+
+  if(ComparePositions(newPos[0], newPos[1]))
+  {
+    // Both Moving into Same Space
+    *pWinner = -1;
+    return EVENT_OVER;
+  }
+
+  // Update Snake
+  for(int iPlay = 0; iPlay < 2; ++iPlay)
+  {
+    int moved = UpdateSnake(pGame, iPlay);
+
+    crashed[iPlay] = (moved & EVENT_CRASHED) != 0;
+    events |= moved & (EVENT_EATEN | EVENT_PLACED);
+  }
+
+  if(crashed[0] || crashed[1])
+  {
+    *pWinner = (crashed[0] && crashed[1]) ? -1 : crashed[0];
+    return events | EVENT_OVER;
+  }
+
+  // Update Pickup Timer
+  if(pGame->m_pickupTime > 1)
+  {
+    pGame->m_pickupTime -= 1;
+  }
+  else
+  {
+    PlacePickup(pGame);
+    events |= EVENT_PLACED;
+  }
+
+  return events;
+}
+
+//----------------------------------------------------------------
+// Queue a Turn
+// A turn back along the snake, or one repeating the direction before it,
+// is dropped - reversing into the neck is never what was meant.  When
+// the queue is full the newest press is dropped.
+void QueueTurn(SnakeData* pSnakeData, unsigned char dir)
+{
+  unsigned char last = pSnakeData->m_dir;
+
+  if(pSnakeData->m_numTurns > 0)
+  {
+    last = pSnakeData->m_turns[pSnakeData->m_numTurns - 1];
+  }
+
+  if(dir == last || dir == ReverseDir(last) || pSnakeData->m_numTurns == TURN_QUEUE)
+  {
+    return;
+  }
+
+  pSnakeData->m_turns[pSnakeData->m_numTurns++] = dir;
+}
+
+//----------------------------------------------------------------
+// Take the Next Turn
+// Once per tick, just before the direction is sent, so both boards
+// apply it on the same frame.
+void TakeTurn(SnakeData* pSnakeData)
+{
+  int i;
+
+  if(pSnakeData->m_numTurns == 0)
+  {
+    return;
+  }
+
+  pSnakeData->m_dir = pSnakeData->m_turns[0];
+
+  pSnakeData->m_numTurns--;
+  for(i = 0; i < pSnakeData->m_numTurns; ++i)
+  {
+    pSnakeData->m_turns[i] = pSnakeData->m_turns[i + 1];
+  }
+}
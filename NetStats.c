@@ -0,0 +1,212 @@
+#include "GameHeader.h"
+#include "NetStats.h"
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "timer.h"
+#include "uart.h"
+#include "pg12864.h"
+
+// Per Game Counters - zeroed by NetStatsBegin()
+NetStats 	s_NetStats;
+
+// Hot path state - a tick read and a few increments per frame
+static unsigned long 	s_sentAt;       // First send of the move awaiting a reply
+static unsigned long 	s_waitAt;       // Entry to the current lockstep wait
+static unsigned long 	s_beginAt;      // Game joined or started
+static char 		s_sentValid;
+static char 		s_active;
+static UartCounters 	s_uartStart;
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Heartbeat Ticks to ms
+static unsigned long TicksToMs(unsigned long ticks)
+{
+  return ticks * 1000 / TIMER_HZ;
+}
+
+//----------------------------------------------------------------
+// Start Counting for a New Game
+void NetStatsBegin()
+{
+  memset(&s_NetStats, 0, sizeof(NetStats));
+  UartGetCounters(&s_uartStart);
+  s_beginAt = TimerTicks();
+
+  s_sentValid = FALSE;
+  s_active    = TRUE;
+}
+
+//----------------------------------------------------------------
+// Game Over - take the UART Totals for the Game
+void NetStatsEnd()
+{
+  UartCounters uart;
+
+  if(s_active == FALSE)
+  {
+    return;
+  }
+  s_active = FALSE;
+
+  UartGetCounters(&uart);
+  s_NetStats.m_rxBytes  = uart.m_rxBytes  - s_uartStart.m_rxBytes;
+  s_NetStats.m_txBytes  = uart.m_txBytes  - s_uartStart.m_txBytes;
+  s_NetStats.m_overruns = uart.m_overruns - s_uartStart.m_overruns;
+}
+
+//----------------------------------------------------------------
+// This Frame's Move has been Sent - the Round Trip starts
+void NetStatsSent()
+{
+  s_sentAt    = TimerTicks();
+  s_sentValid = TRUE;
+}
+
+//----------------------------------------------------------------
+// Lockstep Wait for the Peer's Move begins
+void NetStatsWait()
+{
+  s_waitAt = TimerTicks();
+}
+
+//----------------------------------------------------------------
+// Move Sent Again after a Timeout
+void NetStatsResend()
+{
+  s_NetStats.m_resends++;
+}
+
+//----------------------------------------------------------------
+// Received Packet not Used
+void NetStatsReject(int reason)
+{
+  s_NetStats.m_rejects[reason]++;
+}
+
+//----------------------------------------------------------------
+// Peer's Move Accepted - the frame is locked
+// The round trip runs from the first send, so it includes any resends.
+// On the client it also includes the host's frame time.  A wait past
+// STALL_MS, resent or not, counts as a stall.
+void NetStatsAccept()
+{
+  unsigned long now = TimerTicks();
+  unsigned long wait;
+  unsigned long rtt;
+  unsigned long limit;
+  int bucket;
+
+  s_NetStats.m_frames++;
+
+  if(s_sentValid == TRUE)
+  {
+    rtt = TicksToMs(now - s_sentAt);
+    s_sentValid = FALSE;
+
+    bucket = 0;
+    limit  = RTT_BUCKET0_MS;
+    while(bucket < RTT_BUCKETS - 1 && rtt >= limit)
+    {
+      bucket++;
+      limit <<= 1;
+    }
+
+    s_NetStats.m_rttHist[bucket]++;
+    s_NetStats.m_rttTotal += rtt;
+    s_NetStats.m_rounds++;
+    if(rtt > s_NetStats.m_rttMax)
+    {
+      s_NetStats.m_rttMax = (unsigned short)(rtt > 0xFFFF ? 0xFFFF : rtt);
+    }
+  }
+
+  wait = TicksToMs(now - s_waitAt);
+  if(wait > STALL_MS)
+  {
+    s_NetStats.m_stalls++;
+    s_NetStats.m_stallMs += wait;
+  }
+}
+
+//----------------------------------------------------------------
+// Game Joined Late from a Snapshot of bytes - loaded now
+void NetStatsSnapshot(int bytes)
+{
+  unsigned long ms = TicksToMs(TimerTicks() - s_beginAt);
+
+  s_NetStats.m_snapshotBytes = (unsigned short)bytes;
+  s_NetStats.m_snapshotMs    = (unsigned short)(ms > 0xFFFF ? 0xFFFF : ms);
+}
+
+//----------------------------------------------------------------
+// Draw the Last Game's Counters
+// Six text lines and the round trip histogram along the bottom, one bar
+// per bucket from under 4 ms on the left to 256 ms and over on the right.
+void NetStatsDraw()
+{
+  char          line[88];          // The rej line at its longest - four 20 digit counts
+  unsigned long avg = 0;
+  unsigned long most = 0;
+  int           i;
+
+  if(s_NetStats.m_rounds > 0)
+  {
+    avg = s_NetStats.m_rttTotal / s_NetStats.m_rounds;
+  }
+
+  LCD_ClearDisplay();
+
+  sprintf(line, "rtt %lu max %u", avg, s_NetStats.m_rttMax);
+  LCD_PositionCursor(0, 0);
+  LCD_PutString(line);
+
+  sprintf(line, "resend %lu", s_NetStats.m_resends);
+  LCD_PositionCursor(0, 8);
+  LCD_PutString(line);
+
+  sprintf(line, "stall %lu %lu.%lus", s_NetStats.m_stalls,
+          s_NetStats.m_stallMs / 1000, (s_NetStats.m_stallMs / 100) % 10);
+  LCD_PositionCursor(0, 16);
+  LCD_PutString(line);
+
+  sprintf(line, "rej %lu %lu %lu %lu",
+          s_NetStats.m_rejects[REJECT_FRAME], s_NetStats.m_rejects[REJECT_SEED],
+          s_NetStats.m_rejects[REJECT_SESSION], s_NetStats.m_rejects[REJECT_SYNC]);
+  LCD_PositionCursor(0, 24);
+  LCD_PutString(line);
+
+  sprintf(line, "in %lu ov %lu", s_NetStats.m_rxBytes, s_NetStats.m_overruns);
+  LCD_PositionCursor(0, 32);
+  LCD_PutString(line);
+
+  sprintf(line, "out %lu snap %u", s_NetStats.m_txBytes, s_NetStats.m_snapshotBytes);
+  LCD_PositionCursor(0, 40);
+  LCD_PutString(line);
+
+  // Histogram - 16 pixels per bucket, 15 rows for the fullest
+  for(i = 0; i < RTT_BUCKETS; ++i)
+  {
+    if(s_NetStats.m_rttHist[i] > most)
+    {
+      most = s_NetStats.m_rttHist[i];
+    }
+  }
+
+  for(i = 0; i < RTT_BUCKETS && most > 0; ++i)
+  {
+    int height = (int)((s_NetStats.m_rttHist[i] * 15 + most - 1) / most);
+    int x;
+    int y;
+
+    for(x = i * 16; x < i * 16 + 14; ++x)
+    {
+      for(y = 0; y < height; ++y)
+      {
+        LCD_SetPixel(x, LCD_Y_MAX - y);
+      }
+    }
+  }
+}
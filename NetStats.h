@@ -0,0 +1,51 @@
+//
+// NetStats.h
+//
+// Per-game network telemetry - collected by the lockstep in GameCore.c
+//
+
+// Round trip histogram - bucket i counts trips under (4 << i) ms, the last
+// bucket everything longer
+#define RTT_BUCKETS 	8
+#define RTT_BUCKET0_MS 	4
+
+// A lockstep wait longer than this stalls the frame - ms
+#define STALL_MS 	20
+
+// Reasons a received packet is not used
+#define REJECT_FRAME 	0	// Move for another frame - late or duplicate
+#define REJECT_SEED 	1	// Move carrying another seed
+#define REJECT_SESSION 	2	// Another game's traffic
+#define REJECT_SYNC 	3	// Byte dropped to resynchronise the stream
+#define NUM_REJECTS 	4
+
+typedef struct NetStats_
+{
+	unsigned long   m_rttHist[RTT_BUCKETS];  // Round trips by duration
+	unsigned short  m_rttMax;                // Longest round trip - ms
+	unsigned long   m_rttTotal;              // Sum of round trips - ms
+	unsigned long   m_rounds;                // Round trips measured
+	unsigned long   m_frames;                // Frames locked with the peer
+	unsigned long   m_resends;               // Moves sent again on timeout
+	unsigned long   m_stalls;                // Frames that waited past STALL_MS
+	unsigned long   m_stallMs;               // Time those frames waited
+	unsigned long   m_rejects[NUM_REJECTS];  // Unused packets by reason
+	unsigned long   m_rxBytes;               // UART bytes in
+	unsigned long   m_txBytes;               // UART bytes out
+	unsigned long   m_overruns;              // Bytes lost to a full buffer
+	unsigned short  m_snapshotBytes;         // Snapshot joined from, 0 if none
+	unsigned short  m_snapshotMs;            // Join to the snapshot loaded - ms
+} NetStats;
+
+extern NetStats s_NetStats;
+
+// ------ Functions
+void NetStatsBegin();
+void NetStatsEnd();
+void NetStatsSent();
+void NetStatsWait();
+void NetStatsResend();
+void NetStatsReject(int reason);
+void NetStatsAccept();
+void NetStatsSnapshot(int bytes);
+void NetStatsDraw();
@@ -0,0 +1,313 @@
+#include "GameHeader.h"
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "Profile.h"
+#include "timer.h"
+#include "pg12864.h"
+
+// Per Game Zones - zeroed by ProfileReset()
+ProfileStats 	s_ProfileStats;
+
+static unsigned long 	s_budgetMs = FRAME_BUDGET_MS;
+
+#if PROFILE
+static unsigned long 	s_frameAt;      // Start of the frame being timed
+static char 		s_frameValid;
+static unsigned long 	s_frameZones[NUM_ZONES];  // This frame's zones - cycles
+#endif
+
+// Zone Letters on the LCD - P for the CPU player, so C is the collision
+// sweep alone.  F is the whole frame.
+static const char s_zoneLetters[NUM_ZONES + 1] = "NGSICLP";
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Cycles to us
+static unsigned long CyclesToUs(unsigned long cycles)
+{
+  return cycles / TIMER_CYCLES_PER_US;
+}
+
+//----------------------------------------------------------------
+// Mean Time of a Zone - us
+static unsigned long ZoneMeanUs(const ProfileZone* pZone)
+{
+  if(pZone->m_count == 0)
+  {
+    return 0;
+  }
+  // ms * 1000 / count without overflowing for long games
+  return (pZone->m_ms / pZone->m_count) * 1000 +
+         ((pZone->m_ms % pZone->m_count) * 1000 + CyclesToUs(pZone->m_cycles)) / pZone->m_count;
+}
+
+#if PROFILE
+//----------------------------------------------------------------
+// Add one Time to a Zone
+static void ZoneAdd(ProfileZone* pZone, unsigned long cycles)
+{
+  if(pZone->m_count == 0 || cycles < pZone->m_min)
+  {
+    pZone->m_min = cycles;
+  }
+  if(cycles > pZone->m_max)
+  {
+    pZone->m_max = cycles;
+  }
+  pZone->m_count++;
+
+  // Whole ms kept apart so the total does not wrap
+  pZone->m_cycles += cycles;
+  if(pZone->m_cycles >= AT91_TIMER_RC)
+  {
+    pZone->m_ms     += pZone->m_cycles / AT91_TIMER_RC;
+    pZone->m_cycles %= AT91_TIMER_RC;
+  }
+}
+
+//----------------------------------------------------------------
+// Zone Begins - pass the result to ProfileEnd()
+unsigned long ProfileStart()
+{
+  return TimerCycles();
+}
+
+//----------------------------------------------------------------
+// Zone Ends - returns the time now, so the next zone can start from it
+unsigned long ProfileEnd(int zone, unsigned long start)
+{
+  unsigned long now = TimerCycles();
+
+  ZoneAdd(&s_ProfileStats.m_zones[zone], now - start);
+  s_frameZones[zone] += now - start;
+  return now;
+}
+
+//----------------------------------------------------------------
+// Frame over the Budget - note the longest phase and keep a report
+static void Overran(unsigned long frameUs)
+{
+  Overrun* pReport = &s_ProfileStats.m_ring[s_ProfileStats.m_ringNext];
+  int      zone;
+  int      i;
+
+  zone = 0;
+  for(i = 1; i < NUM_PHASES; ++i)
+  {
+    if(s_frameZones[i] > s_frameZones[zone])
+    {
+      zone = i;
+    }
+  }
+
+  pReport->m_frame   = s_ProfileStats.m_frame.m_count;
+  pReport->m_frameUs = frameUs;
+  pReport->m_overUs  = frameUs - s_ProfileStats.m_budgetUs;
+  pReport->m_zone    = (unsigned char)zone;
+  for(i = 0; i < NUM_ZONES; ++i)
+  {
+    pReport->m_zoneUs[i] = CyclesToUs(s_frameZones[i]);
+  }
+
+  s_ProfileStats.m_ringNext = (s_ProfileStats.m_ringNext + 1) % OVERRUN_RING;
+  s_ProfileStats.m_overruns++;
+  s_ProfileStats.m_overrunsBy[zone]++;
+  if(pReport->m_overUs > s_ProfileStats.m_overMaxUs)
+  {
+    s_ProfileStats.m_overMaxUs = pReport->m_overUs;
+  }
+}
+
+//----------------------------------------------------------------
+// One Pass of the Main Loop in Play
+void ProfileFrame()
+{
+  unsigned long now = TimerCycles();
+  unsigned long ms;
+  unsigned long limit;
+  int bucket;
+
+  if(s_frameValid == TRUE)
+  {
+    ZoneAdd(&s_ProfileStats.m_frame, now - s_frameAt);
+
+    ms     = (now - s_frameAt) / AT91_TIMER_RC;
+    bucket = 0;
+    limit  = FRAME_BUCKET0_MS;
+    while(bucket < FRAME_BUCKETS - 1 && ms >= limit)
+    {
+      bucket++;
+      limit <<= 1;
+    }
+    s_ProfileStats.m_frameHist[bucket]++;
+
+    if(CyclesToUs(now - s_frameAt) > s_ProfileStats.m_budgetUs)
+    {
+      Overran(CyclesToUs(now - s_frameAt));
+    }
+  }
+
+  memset(s_frameZones, 0, sizeof(s_frameZones));
+  s_frameAt    = now;
+  s_frameValid = TRUE;
+}
+#endif
+
+//----------------------------------------------------------------
+// Set the Frame Budget - from now on in this game and in later ones
+void ProfileBudget(unsigned int ms)
+{
+  s_budgetMs = ms;
+  s_ProfileStats.m_budgetUs = s_budgetMs * 1000;
+}
+
+//----------------------------------------------------------------
+// Start Timing a New Game
+void ProfileReset()
+{
+  memset(&s_ProfileStats, 0, sizeof(ProfileStats));
+  s_ProfileStats.m_budgetUs = s_budgetMs * 1000;
+#if PROFILE
+  s_frameValid = FALSE;
+#endif
+}
+
+//----------------------------------------------------------------
+// Short Time for the LCD - four characters
+static void FormatTime(char* pText, unsigned long us)
+{
+  if(us < 1000)
+  {
+    sprintf(pText, "%3luu", us);
+  }
+  else if(us < 10000)
+  {
+    sprintf(pText, "%lu.%lum", us / 1000, (us / 100) % 10);
+  }
+  else if(us < 1000000)
+  {
+    sprintf(pText, "%3lum", us / 1000);
+  }
+  else
+  {
+    sprintf(pText, "%3lus", us < 1000000000 ? us / 1000000 : 999);
+  }
+}
+
+//----------------------------------------------------------------
+// One Zone's Line - letter, min, mean and max
+static void DrawZone(int y, char letter, const ProfileZone* pZone)
+{
+  char line[32];
+  char tmin[8];
+  char tmean[8];
+  char tmax[8];
+
+  FormatTime(tmin,  CyclesToUs(pZone->m_min));
+  FormatTime(tmean, ZoneMeanUs(pZone));
+  FormatTime(tmax,  CyclesToUs(pZone->m_max));
+  sprintf(line, "%c %s %s %s", letter, tmin, tmean, tmax);
+
+  LCD_PositionCursor(0, y);
+  LCD_PutString(line);
+}
+
+//----------------------------------------------------------------
+// Draw the Last Game's Zones
+// One line per zone entered - N G S I C L P - and F for the whole frame,
+// with the frame time histogram along the bottom when there is room,
+// under 4 ms on the left to 256 ms and over on the right.
+void ProfileDraw()
+{
+  unsigned long most = 0;
+  int           lines = 0;
+  int           i;
+
+  LCD_ClearDisplay();
+
+  for(i = 0; i < NUM_ZONES; ++i)
+  {
+    if(s_ProfileStats.m_zones[i].m_count > 0)
+    {
+      DrawZone(lines++ * 8, s_zoneLetters[i], &s_ProfileStats.m_zones[i]);
+    }
+  }
+  DrawZone(lines++ * 8, 'F', &s_ProfileStats.m_frame);
+  if(lines * 8 > LCD_Y_MAX - 7)
+  {
+    return;
+  }
+
+  // Histogram - 16 pixels per bucket, 7 rows for the fullest
+  for(i = 0; i < FRAME_BUCKETS; ++i)
+  {
+    if(s_ProfileStats.m_frameHist[i] > most)
+    {
+      most = s_ProfileStats.m_frameHist[i];
+    }
+  }
+
+  for(i = 0; i < FRAME_BUCKETS && most > 0; ++i)
+  {
+    int height = (int)((s_ProfileStats.m_frameHist[i] * 7 + most - 1) / most);
+    int x;
+    int y;
+
+    for(x = i * 16; x < i * 16 + 14; ++x)
+    {
+      for(y = 0; y < height; ++y)
+      {
+        LCD_SetPixel(x, LCD_Y_MAX - y);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Draw the Last Game's Overruns
+// The count against the budget and the worst, then the ring's reports,
+// newest first: frame number, frame time, the longest main loop phase's
+// letter and how far over the budget.  Only the LCD shows the profile -
+// the UART is the XBee link, which would send a dump on to other boards.
+void ProfileDrawOverruns()
+{
+  char line[64];
+  char tframe[8];
+  char tover[8];
+  int  n    = (int)s_ProfileStats.m_overruns;
+  int  room = (LCD_Y_MAX + 1) / 8 - 2;   // Lines under the two above
+  int  i;
+
+  LCD_ClearDisplay();
+
+  FormatTime(tover, s_ProfileStats.m_overMaxUs);
+  sprintf(line, "over %lu of %lum", s_ProfileStats.m_overruns, s_ProfileStats.m_budgetUs / 1000);
+  LCD_PositionCursor(0, 0);
+  LCD_PutString(line);
+  sprintf(line, "worst +%s", tover);
+  LCD_PositionCursor(0, 8);
+  LCD_PutString(line);
+
+  if(s_ProfileStats.m_overruns > OVERRUN_RING)
+  {
+    n = OVERRUN_RING;
+  }
+  if(n > room)
+  {
+    n = room;
+  }
+  for(i = 0; i < n; ++i)
+  {
+    const Overrun* pReport =
+      &s_ProfileStats.m_ring[(s_ProfileStats.m_ringNext + OVERRUN_RING - 1 - i) % OVERRUN_RING];
+
+    FormatTime(tframe, pReport->m_frameUs);
+    FormatTime(tover,  pReport->m_overUs);
+    sprintf(line, "%6lu %s %c +%s", pReport->m_frame % 1000000, tframe,
+            s_zoneLetters[pReport->m_zone], tover);
+    LCD_PositionCursor(0, 16 + i * 8);
+    LCD_PutString(line);
+  }
+}
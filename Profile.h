@@ -0,0 +1,86 @@
+//
+// Profile.h
+//
+// Frame-time profiler - zones timed on the TC0 counter (TimerCycles())
+//
+// Each zone keeps a count, min, mean and max.  A zone's time includes the
+// zones nested in it and any interrupts taken while it runs.  Set PROFILE
+// to 0 in config.h to compile the zones out - include config.h first.
+//
+// A zone is timed from ProfileBegin(start), which declares start, to
+// ProfileEnd(zone, start).  ProfileNext(zone, start) ends one zone and
+// begins the next from the same time.  With PROFILE 0 they are nothing,
+// and start is never declared.
+//
+
+// Zones
+#define ZONE_NETWORK 	0	// UpdateNetwork() - lockstep wait included
+#define ZONE_GAME 	1	// UpdateGame()
+#define ZONE_SCREEN 	2	// UpdateScreen()
+#define ZONE_INPUT 	3	// UpdateInput()
+#define ZONE_COLLISION 	4	// CollisionSweep() - inside ZONE_GAME
+#define ZONE_LCD 	5	// LCD pixel, column and character writes - inside the others
+#define ZONE_CPU 	6	// CpuDecide() - inside ZONE_NETWORK
+#define NUM_ZONES 	7
+#define NUM_PHASES 	4	// Main loop phases - the first zones
+
+// Frame time histogram - bucket i counts frames under (4 << i) ms, the
+// last bucket everything longer
+#define FRAME_BUCKETS 	8
+#define FRAME_BUCKET0_MS 4
+
+// Frame budget - a frame longer than this is an overrun, kept in a ring
+// of the last OVERRUN_RING reports.  Change at run time with ProfileBudget().
+#define OVERRUN_RING 	8
+
+// One Overrun - times in us
+typedef struct Overrun_
+{
+	unsigned long   m_frame;                 // Frame number in the game
+	unsigned long   m_frameUs;               // Whole frame
+	unsigned long   m_overUs;                // Over the budget
+	unsigned long   m_zoneUs[NUM_ZONES];     // Each zone in the frame
+	unsigned char   m_zone;                  // Longest main loop phase
+} Overrun;
+
+typedef struct ProfileZone_
+{
+	unsigned long   m_count;                 // Times entered
+	unsigned long   m_min;                   // Shortest - cycles
+	unsigned long   m_max;                   // Longest - cycles
+	unsigned long   m_ms;                    // Total - whole ms
+	unsigned long   m_cycles;                // Total - cycles under 1 ms
+} ProfileZone;
+
+typedef struct ProfileStats_
+{
+	ProfileZone     m_zones[NUM_ZONES];
+	ProfileZone     m_frame;                 // One main loop pass in play
+	unsigned short  m_frameHist[FRAME_BUCKETS];
+	unsigned long   m_budgetUs;              // Frame budget in force
+	unsigned long   m_overruns;              // Frames over the budget
+	unsigned long   m_overrunsBy[NUM_PHASES];// Overruns by longest phase
+	unsigned long   m_overMaxUs;             // Furthest over the budget
+	Overrun         m_ring[OVERRUN_RING];    // Last overruns
+	unsigned char   m_ringNext;              // Next slot to write
+} ProfileStats;
+
+extern ProfileStats s_ProfileStats;
+
+// ------ Functions
+#if PROFILE
+unsigned long ProfileStart();
+unsigned long ProfileEnd(int zone, unsigned long start);
+void ProfileFrame();
+#define ProfileBegin(start)      unsigned long start = ProfileStart()
+#define ProfileNext(zone, start) ((start) = ProfileEnd(zone, start))
+#else
+#define ProfileBegin(start)
+#define ProfileEnd(zone, start)  ((void)0)
+#define ProfileNext(zone, start) ((void)0)
+#define ProfileFrame()           ((void)0)
+#endif
+void ProfileBudget(unsigned int ms);
+void ProfileReset();
+void ProfileDraw();
+void ProfileDrawOverruns();
@@ -0,0 +1,323 @@
+#include "GameHeader.h"
+#include <string.h>
+#include "config.h"
+#include "Snapshot.h"
+
+// Direction in a snake's first byte - SNAPSHOT_PACKED is above it
+#define SNAPSHOT_DIR 	0x07
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Little Endian Values
+static unsigned char* Put16(unsigned char* pData, unsigned int value)
+{
+  pData[0] = (unsigned char)value;
+  pData[1] = (unsigned char)(value >> 8);
+  return pData + 2;
+}
+
+static unsigned char* Put32(unsigned char* pData, unsigned long value)
+{
+  Put16(pData, (unsigned int)(value & 0xFFFF));
+  return Put16(pData + 2, (unsigned int)(value >> 16));
+}
+
+static unsigned int Get16(const unsigned char* pData)
+{
+  return pData[0] | (pData[1] << 8);
+}
+
+static unsigned long Get32(const unsigned char* pData)
+{
+  return Get16(pData) | ((unsigned long)Get16(pData + 2) << 16);
+}
+
+//----------------------------------------------------------------
+// Fletcher-16 Sum
+static unsigned int Checksum(const unsigned char* pData, int size)
+{
+  unsigned int a = 0;
+  unsigned int b = 0;
+
+  for(int i = 0; i < size; ++i)
+  {
+    a = (a + pData[i]) % 255;
+    b = (b + a) % 255;
+  }
+  return (b << 8) | a;
+}
+
+//----------------------------------------------------------------
+// Runs a Body takes - a new one at each turn and every SNAPSHOT_RUN pieces
+static int CountRuns(const SnakeData* pSnakeData, int laid)
+{
+  unsigned char last = NO_MOVE;
+  int           runs = 0;
+  int           run  = 0;
+
+  for(int iPiece = 0; iPiece < laid; ++iPiece)
+  {
+    unsigned char dir = BodyDir(pSnakeData, iPiece);
+
+    if(dir != last || run == SNAPSHOT_RUN)
+    {
+      last = dir;
+      run  = 0;
+      runs++;
+    }
+    run++;
+  }
+  return runs;
+}
+
+//----------------------------------------------------------------
+// Encode a Body from the Head - returns the byte after it
+static unsigned char* EncodeBody(const SnakeData* pSnakeData, int laid, char packed, unsigned char* pData)
+{
+  int iPiece = 0;
+
+  if(packed)
+  {
+    memset(pData, 0, (laid + 3) / 4);
+    for(iPiece = 0; iPiece < laid; ++iPiece)
+    {
+      pData[iPiece >> 2] |= (unsigned char)((BodyDir(pSnakeData, iPiece) - 1) << ((iPiece & 3) << 1));
+    }
+    return pData + (laid + 3) / 4;
+  }
+
+  while(iPiece < laid)
+  {
+    unsigned char dir = BodyDir(pSnakeData, iPiece);
+    int           run = 1;
+
+    while(iPiece + run < laid && run < SNAPSHOT_RUN && BodyDir(pSnakeData, iPiece + run) == dir)
+    {
+      run++;
+    }
+    *pData++ = (unsigned char)(((dir - 1) << 6) | (run - 1));
+    iPiece  += run;
+  }
+  return pData;
+}
+
+//----------------------------------------------------------------
+// Encode a Game - returns the message's size, at most SNAPSHOT_MAX
+int SnapshotEncode(const SnakeGame* pGame, unsigned char* pData)
+{
+  unsigned char* pNext = pData;
+  int            size;
+
+  *pNext++ = MSG_SNAPSHOT;
+  pNext    = Put16(pNext, 0);
+  pNext    = Put16(pNext, pGame->m_session);
+  pNext    = Put32(pNext, (unsigned long)pGame->m_updateCount);
+  pNext    = Put32(pNext, (unsigned long)pGame->m_randSeed);
+  pNext    = Put32(pNext, (unsigned long)pGame->m_randFrame);
+  *pNext++ = pGame->m_pickupPos[X];
+  *pNext++ = pGame->m_pickupPos[Y];
+  *pNext++ = pGame->m_pickupValue;
+  *pNext++ = pGame->m_pickupTime;
+
+  for(int iPlay = 0; iPlay < 2; ++iPlay)
+  {
+    const SnakeData* pSnakeData = &pGame->m_snakes[iPlay];
+    int              laid       = SNAKE_LAID(pSnakeData);
+    char             packed     = (laid + 3) / 4 < CountRuns(pSnakeData, laid);
+
+    *pNext++ = (unsigned char)(pSnakeData->m_dir | (packed ? SNAPSHOT_PACKED : 0));
+    *pNext++ = pSnakeData->m_head[X];
+    *pNext++ = pSnakeData->m_head[Y];
+    pNext    = Put16(pNext, pSnakeData->m_length);
+    pNext    = Put16(pNext, pSnakeData->m_grow);
+    pNext    = Put32(pNext, (unsigned long)pSnakeData->m_score);
+    pNext    = EncodeBody(pSnakeData, laid, packed, pNext);
+  }
+
+  size = (int)(pNext - pData) + 2;
+  Put16(pData + 1, (unsigned int)size);
+  Put16(pNext, Checksum(pData, size - 2));
+  return size;
+}
+
+//----------------------------------------------------------------
+// Size of the Session's Snapshot a Message Starts - 0 if it cannot be one
+// Only its first SNAPSHOT_PEEK bytes are read, so a receiver can see how
+// much more to wait for.
+int SnapshotSize(const unsigned char* pData, unsigned short session)
+{
+  int size = (int)Get16(pData + 1);
+
+  if(pData[0] != MSG_SNAPSHOT || size < SNAPSHOT_MIN || size > SNAPSHOT_MAX ||
+     Get16(pData + 3) != session)
+  {
+    return 0;
+  }
+  return size;
+}
+
+//----------------------------------------------------------------
+// Square within the Occupancy Map - its bit, as GameRules.c finds it
+static char InMap(const unsigned char* pPos)
+{
+  int bit = pPos[Y] * OCCUPY_ROW + pPos[X];
+
+  return (bit < OCCUPY_ROW * OCCUPY_ROWS) ? TRUE : FALSE;
+}
+
+//----------------------------------------------------------------
+// Next Body Piece - walked from the head, and put in the ring unless
+// only checking
+static char DecodePiece(SnakeData* pSnakeData, int iPiece, unsigned char dir, unsigned char* pPos)
+{
+  UpdatePos(pPos, dir);
+  if(InMap(pPos) == FALSE)
+  {
+    return FALSE;
+  }
+
+  if(pSnakeData != NULL)
+  {
+    pSnakeData->m_body[iPiece >> 2] |= (unsigned char)((dir - 1) << ((iPiece & 3) << 1));
+  }
+  return TRUE;
+}
+
+//----------------------------------------------------------------
+// Decode a Snake - into pSnakeData, or only checked if it is NULL
+// The body ring starts at 0.  Returns the byte after the snake, or NULL
+// if it does not make a snake inside the occupancy map.
+static const unsigned char* DecodeSnake(const unsigned char* pData, const unsigned char* pEnd, SnakeData* pSnakeData)
+{
+  unsigned char dir;
+  char          packed;
+  unsigned char pos[2];
+  int           length;
+  int           grow;
+  int           laid;
+  int           iPiece = 0;
+
+  if(pEnd - pData < SNAPSHOT_SNAKE)
+  {
+    return NULL;
+  }
+
+  dir    = (unsigned char)(pData[0] & SNAPSHOT_DIR);
+  packed = (pData[0] & SNAPSHOT_PACKED) != 0;
+  pos[X] = pData[1];
+  pos[Y] = pData[2];
+  length = (int)Get16(pData + 3);
+  grow   = (int)Get16(pData + 5);
+  if(dir < NORTH || dir > WEST || length > MAX_SNAKE_LENGTH || grow > length || InMap(pos) == FALSE)
+  {
+    return NULL;
+  }
+  laid = length - grow;
+
+  if(pSnakeData != NULL)
+  {
+    memset(pSnakeData, 0, sizeof(SnakeData));
+    pSnakeData->m_dir     = dir;
+    pSnakeData->m_head[X] = pos[X];
+    pSnakeData->m_head[Y] = pos[Y];
+    pSnakeData->m_length  = (unsigned short)length;
+    pSnakeData->m_grow    = (unsigned short)grow;
+    pSnakeData->m_score   = (int)Get32(pData + 7);
+  }
+  pData += SNAPSHOT_SNAKE;
+
+  if(packed)
+  {
+    if(pEnd - pData < (laid + 3) / 4)
+    {
+      return NULL;
+    }
+    for(iPiece = 0; iPiece < laid; ++iPiece)
+    {
+      dir = (unsigned char)(((pData[iPiece >> 2] >> ((iPiece & 3) << 1)) & 3) + 1);
+      if(DecodePiece(pSnakeData, iPiece, dir, pos) == FALSE)
+      {
+        return NULL;
+      }
+    }
+    return pData + (laid + 3) / 4;
+  }
+
+  while(iPiece < laid)
+  {
+    int run;
+
+    if(pData == pEnd)
+    {
+      return NULL;
+    }
+    dir = (unsigned char)((*pData >> 6) + 1);
+    run = (*pData & (SNAPSHOT_RUN - 1)) + 1;
+    if(iPiece + run > laid)
+    {
+      return NULL;
+    }
+    for(; run > 0; --run, ++iPiece)
+    {
+      if(DecodePiece(pSnakeData, iPiece, dir, pos) == FALSE)
+      {
+        return NULL;
+      }
+    }
+    pData++;
+  }
+  return pData;
+}
+
+//----------------------------------------------------------------
+// Load a Game from a Snapshot - or only check it, if pGame is NULL
+// The message is checked whole before anything is written, so a game
+// is left as it was by one that is damaged or cut short.  The loaded
+// game's changes are marked overflowed - the screen is drawn afresh.
+char SnapshotDecode(SnakeGame* pGame, const unsigned char* pData, int size)
+{
+  const unsigned char* pEnd = pData + size - 2;
+  const unsigned char* pNext;
+
+  // Whole and Unharmed
+  if(size < SNAPSHOT_MIN || SnapshotSize(pData, (unsigned short)Get16(pData + 3)) != size ||
+     Get16(pEnd) != Checksum(pData, size - 2) || pData[SNAPSHOT_HEADER - 2] > 2)
+  {
+    return FALSE;
+  }
+
+  // Both Snakes make Sense
+  pNext = DecodeSnake(pData + SNAPSHOT_HEADER, pEnd, NULL);
+  if(pNext == NULL || (pNext = DecodeSnake(pNext, pEnd, NULL)) != pEnd)
+  {
+    return FALSE;
+  }
+  if(pGame == NULL)
+  {
+    return TRUE;
+  }
+
+  // Load
+  pGame->m_session      = (unsigned short)Get16(pData + 3);
+  pGame->m_updateCount  = (int)Get32(pData + 5);
+  pGame->m_randSeed     = (int)Get32(pData + 9);
+  pGame->m_randFrame    = (int)Get32(pData + 13);
+  pGame->m_randDraw     = 0;
+  pGame->m_pickupPos[X] = pData[17];
+  pGame->m_pickupPos[Y] = pData[18];
+  pGame->m_pickupValue  = pData[19];
+  pGame->m_pickupTime   = pData[20];
+
+  memset(pGame->m_occupied, 0, sizeof(pGame->m_occupied));
+  pNext = pData + SNAPSHOT_HEADER;
+  for(int iPlay = 0; iPlay < 2; ++iPlay)
+  {
+    pNext = DecodeSnake(pNext, pEnd, &pGame->m_snakes[iPlay]);
+    SnakeLay(pGame, iPlay);
+  }
+
+  pGame->m_numChanges = GAME_CHANGES + 1;
+  pGame->m_currState  = STATE_PLAYING;
+  return TRUE;
+}
@@ -0,0 +1,40 @@
+//
+// Snapshot.h
+//
+// Game snapshot - the whole shared state of a game in one message, for a
+// board joining a game already under way
+//
+// Frame, random seed and frame, pickup and both snakes.  Random draws
+// start again at each GameStep(), so their count is not sent.  A body
+// goes as runs of one direction, a byte each, or packed 2 bits a piece
+// like the body ring - whichever is shorter.  Turn queues are the local
+// player's and are not sent.
+//
+// Values are little endian, and a Fletcher-16 sum over the rest ends
+// the message.  Include GameHeader.h first.
+//
+
+// Message - type, size, session, frame, random seed and frame, and pickup
+#define SNAPSHOT_HEADER 	21
+
+// Each snake before its body - direction and coding, head, length,
+// growth and score
+#define SNAPSHOT_SNAKE 		11
+
+// Body coding - in the snake's direction byte
+#define SNAPSHOT_PACKED 	0x80	// Packed pieces, else runs
+
+// Longest run in a byte - the low 6 bits hold it less 1
+#define SNAPSHOT_RUN 		64
+
+// Bytes SnapshotSize() reads - type, size and session
+#define SNAPSHOT_PEEK 		5
+
+// Sizes - both snakes a head alone, and both bodies at their longest
+#define SNAPSHOT_MIN 		(SNAPSHOT_HEADER + 2 * SNAPSHOT_SNAKE + 2)
+#define SNAPSHOT_MAX 		(SNAPSHOT_MIN + 2 * (BODY_RING / 4))
+
+// ------ Functions
+int SnapshotEncode(const SnakeGame* pGame, unsigned char* pData);
+int SnapshotSize(const unsigned char* pData, unsigned short session);
+char SnapshotDecode(SnakeGame* pGame, const unsigned char* pData, int size);
@@ -9,7 +9,7 @@
  * harmonics.
  *
  * Call soundInit() first followed by any sequence of playNote(int t, int n)
- * and playRest( int n ), this:
+ * and playRest( int n ), or playTune() with a tune held as data, thus:
  *
  *    soundInit();
  *    playNote( g3, c);        play g3 crotchet
@@ -20,49 +20,135 @@
  * Note frequencies are drawn from {c0,c0s,d0,d0s, ... ,c8s,d8,d8s};
  * c4 is "middle C" 
  *
+ * None of these wait: the notes are queued and played from the timer/
+ * counter 1 interrupt while the game runs.
+ *
  * Original WDH, June, 2006
  * Updated WDH, August, 2008
  *
  */
 
+#include "config.h"
 #include "AT91PIO.h"
 #include "Sound.h"
 #include "Delay.h"
 
-/* Structure holding the halfduration and cycles values for a note */
-
-struct note_record {
-   int halfDuration; /* Micro seconds */
-   int cycles[6];    /* Cycles for a semi-breve */
-} noteTable[100];
-
-
-
-/* An array of note frequency values - Hz */
+/* Half period and cycles for each note, c0..d8s
+ *
+ * Fixed data in flash - not worked out at boot.  For a note of f Hz:
+ *    halfDuration = 1000000 / f / 2           (truncated)
+ *    cycles[d]    = f / 2^d, for sb..dsq     (truncated)
+ * as soundInit() once computed them in floating point.
+ */
 
-float noteFrequency[]= {  16.35,  17.32,  18.35,  19.45,  20.6 ,  21.83,
-                          23.12,  24.50,  25.96,  27.50,  29.14,  30.87,
-                          32.7,   34.65,  36.71,  38.89,  41.20,  43.65,
-                          46.25,  49.00,  51.91,  55.00,  58.27,  61.74,
-                          65.41,  69.30,  73.42,  77.78,  82.41,  87.31,
-                          92.50,  98.00, 103.83, 110.00, 116.54, 123.47,
-                         130.81, 138.59, 146.83, 155.56, 164.81, 174.61,
-                         185.00, 196.00, 207.65, 220.00, 233.08, 246.94,
-                         261.63, 277.18, 293.66, 311.13, 329.63, 349.23,
-                         369.99, 392.00, 415.30, 440.00, 466.16, 493.88,
-                         523.25, 554.37, 587.33, 622.25, 659.26, 698.46,
-                         739.99, 783.99, 830.61, 880.00, 932.33, 987.77,
-                        1046.5, 1108.73,1174.66,1244.51,1318.51,1396.91,
-                        1479.98,1567.98,1661.22,1760.00,1864.66,1975.53,
-                        2093.0, 2217.46,2349.32,2489.02,2637.02,2793.83,
-                        2959.96,3135.96,3322.44,3520.00,3729.31,3951.07,
-                        4186.01,4434.92,4698.64,4978.03 };
+const struct note_record noteTable[100] = {
+   { 30581, {   16,    8,    4,   2,   1,   0 } },  /* c0    16.35 Hz */
+   { 28868, {   17,    8,    4,   2,   1,   0 } },  /* c0s  17.32 Hz */
+   { 27247, {   18,    9,    4,   2,   1,   0 } },  /* d0    18.35 Hz */
+   { 25706, {   19,    9,    4,   2,   1,   0 } },  /* d0s  19.45 Hz */
+   { 24271, {   20,   10,    5,   2,   1,   0 } },  /* e0    20.60 Hz */
+   { 22904, {   21,   10,    5,   2,   1,   0 } },  /* f0    21.83 Hz */
+   { 21626, {   23,   11,    5,   2,   1,   0 } },  /* f0s  23.12 Hz */
+   { 20408, {   24,   12,    6,   3,   1,   0 } },  /* g0    24.50 Hz */
+   { 19260, {   25,   12,    6,   3,   1,   0 } },  /* g0s  25.96 Hz */
+   { 18181, {   27,   13,    6,   3,   1,   0 } },  /* a0    27.50 Hz */
+   { 17158, {   29,   14,    7,   3,   1,   0 } },  /* a0s  29.14 Hz */
+   { 16196, {   30,   15,    7,   3,   1,   0 } },  /* b0    30.87 Hz */
+   { 15290, {   32,   16,    8,   4,   2,   1 } },  /* c1    32.70 Hz */
+   { 14430, {   34,   17,    8,   4,   2,   1 } },  /* c1s  34.65 Hz */
+   { 13620, {   36,   18,    9,   4,   2,   1 } },  /* d1    36.71 Hz */
+   { 12856, {   38,   19,    9,   4,   2,   1 } },  /* d1s  38.89 Hz */
+   { 12135, {   41,   20,   10,   5,   2,   1 } },  /* e1    41.20 Hz */
+   { 11454, {   43,   21,   10,   5,   2,   1 } },  /* f1    43.65 Hz */
+   { 10810, {   46,   23,   11,   5,   2,   1 } },  /* f1s  46.25 Hz */
+   { 10204, {   49,   24,   12,   6,   3,   1 } },  /* g1    49.00 Hz */
+   {  9632, {   51,   25,   12,   6,   3,   1 } },  /* g1s  51.91 Hz */
+   {  9090, {   55,   27,   13,   6,   3,   1 } },  /* a1    55.00 Hz */
+   {  8580, {   58,   29,   14,   7,   3,   1 } },  /* a1s  58.27 Hz */
+   {  8098, {   61,   30,   15,   7,   3,   1 } },  /* b1    61.74 Hz */
+   {  7644, {   65,   32,   16,   8,   4,   2 } },  /* c2    65.41 Hz */
+   {  7215, {   69,   34,   17,   8,   4,   2 } },  /* c2s  69.30 Hz */
+   {  6810, {   73,   36,   18,   9,   4,   2 } },  /* d2    73.42 Hz */
+   {  6428, {   77,   38,   19,   9,   4,   2 } },  /* d2s  77.78 Hz */
+   {  6067, {   82,   41,   20,  10,   5,   2 } },  /* e2    82.41 Hz */
+   {  5726, {   87,   43,   21,  10,   5,   2 } },  /* f2    87.31 Hz */
+   {  5405, {   92,   46,   23,  11,   5,   2 } },  /* f2s  92.50 Hz */
+   {  5102, {   98,   49,   24,  12,   6,   3 } },  /* g2    98.00 Hz */
+   {  4815, {  103,   51,   25,  12,   6,   3 } },  /* g2s 103.83 Hz */
+   {  4545, {  110,   55,   27,  13,   6,   3 } },  /* a2   110.00 Hz */
+   {  4290, {  116,   58,   29,  14,   7,   3 } },  /* a2s 116.54 Hz */
+   {  4049, {  123,   61,   30,  15,   7,   3 } },  /* b2   123.47 Hz */
+   {  3822, {  130,   65,   32,  16,   8,   4 } },  /* c3   130.81 Hz */
+   {  3607, {  138,   69,   34,  17,   8,   4 } },  /* c3s 138.59 Hz */
+   {  3405, {  146,   73,   36,  18,   9,   4 } },  /* d3   146.83 Hz */
+   {  3214, {  155,   77,   38,  19,   9,   4 } },  /* d3s 155.56 Hz */
+   {  3033, {  164,   82,   41,  20,  10,   5 } },  /* e3   164.81 Hz */
+   {  2863, {  174,   87,   43,  21,  10,   5 } },  /* f3   174.61 Hz */
+   {  2702, {  185,   92,   46,  23,  11,   5 } },  /* f3s 185.00 Hz */
+   {  2551, {  196,   98,   49,  24,  12,   6 } },  /* g3   196.00 Hz */
+   {  2407, {  207,  103,   51,  25,  12,   6 } },  /* g3s 207.65 Hz */
+   {  2272, {  220,  110,   55,  27,  13,   6 } },  /* a3   220.00 Hz */
+   {  2145, {  233,  116,   58,  29,  14,   7 } },  /* a3s 233.08 Hz */
+   {  2024, {  246,  123,   61,  30,  15,   7 } },  /* b3   246.94 Hz */
+   {  1911, {  261,  130,   65,  32,  16,   8 } },  /* c4   261.63 Hz */
+   {  1803, {  277,  138,   69,  34,  17,   8 } },  /* c4s 277.18 Hz */
+   {  1702, {  293,  146,   73,  36,  18,   9 } },  /* d4   293.66 Hz */
+   {  1607, {  311,  155,   77,  38,  19,   9 } },  /* d4s 311.13 Hz */
+   {  1516, {  329,  164,   82,  41,  20,  10 } },  /* e4   329.63 Hz */
+   {  1431, {  349,  174,   87,  43,  21,  10 } },  /* f4   349.23 Hz */
+   {  1351, {  369,  184,   92,  46,  23,  11 } },  /* f4s 369.99 Hz */
+   {  1275, {  392,  196,   98,  49,  24,  12 } },  /* g4   392.00 Hz */
+   {  1203, {  415,  207,  103,  51,  25,  12 } },  /* g4s 415.30 Hz */
+   {  1136, {  440,  220,  110,  55,  27,  13 } },  /* a4   440.00 Hz */
+   {  1072, {  466,  233,  116,  58,  29,  14 } },  /* a4s 466.16 Hz */
+   {  1012, {  493,  246,  123,  61,  30,  15 } },  /* b4   493.88 Hz */
+   {   955, {  523,  261,  130,  65,  32,  16 } },  /* c5   523.25 Hz */
+   {   901, {  554,  277,  138,  69,  34,  17 } },  /* c5s 554.37 Hz */
+   {   851, {  587,  293,  146,  73,  36,  18 } },  /* d5   587.33 Hz */
+   {   803, {  622,  311,  155,  77,  38,  19 } },  /* d5s 622.25 Hz */
+   {   758, {  659,  329,  164,  82,  41,  20 } },  /* e5   659.26 Hz */
+   {   715, {  698,  349,  174,  87,  43,  21 } },  /* f5   698.46 Hz */
+   {   675, {  739,  369,  184,  92,  46,  23 } },  /* f5s 739.99 Hz */
+   {   637, {  783,  391,  195,  97,  48,  24 } },  /* g5   783.99 Hz */
+   {   601, {  830,  415,  207, 103,  51,  25 } },  /* g5s 830.61 Hz */
+   {   568, {  880,  440,  220, 110,  55,  27 } },  /* a5   880.00 Hz */
+   {   536, {  932,  466,  233, 116,  58,  29 } },  /* a5s 932.33 Hz */
+   {   506, {  987,  493,  246, 123,  61,  30 } },  /* b5   987.77 Hz */
+   {   477, { 1046,  523,  261, 130,  65,  32 } },  /* c6  1046.50 Hz */
+   {   450, { 1108,  554,  277, 138,  69,  34 } },  /* c6s1108.73 Hz */
+   {   425, { 1174,  587,  293, 146,  73,  36 } },  /* d6  1174.66 Hz */
+   {   401, { 1244,  622,  311, 155,  77,  38 } },  /* d6s1244.51 Hz */
+   {   379, { 1318,  659,  329, 164,  82,  41 } },  /* e6  1318.51 Hz */
+   {   357, { 1396,  698,  349, 174,  87,  43 } },  /* f6  1396.91 Hz */
+   {   337, { 1479,  739,  369, 184,  92,  46 } },  /* f6s1479.98 Hz */
+   {   318, { 1567,  783,  391, 195,  97,  48 } },  /* g6  1567.98 Hz */
+   {   300, { 1661,  830,  415, 207, 103,  51 } },  /* g6s1661.22 Hz */
+   {   284, { 1760,  880,  440, 220, 110,  55 } },  /* a6  1760.00 Hz */
+   {   268, { 1864,  932,  466, 233, 116,  58 } },  /* a6s1864.66 Hz */
+   {   253, { 1975,  987,  493, 246, 123,  61 } },  /* b6  1975.53 Hz */
+   {   238, { 2093, 1046,  523, 261, 130,  65 } },  /* c7  2093.00 Hz */
+   {   225, { 2217, 1108,  554, 277, 138,  69 } },  /* c7s2217.46 Hz */
+   {   212, { 2349, 1174,  587, 293, 146,  73 } },  /* d7  2349.32 Hz */
+   {   200, { 2489, 1244,  622, 311, 155,  77 } },  /* d7s2489.02 Hz */
+   {   189, { 2637, 1318,  659, 329, 164,  82 } },  /* e7  2637.02 Hz */
+   {   178, { 2793, 1396,  698, 349, 174,  87 } },  /* f7  2793.83 Hz */
+   {   168, { 2959, 1479,  739, 369, 184,  92 } },  /* f7s2959.96 Hz */
+   {   159, { 3135, 1567,  783, 391, 195,  97 } },  /* g7  3135.96 Hz */
+   {   150, { 3322, 1661,  830, 415, 207, 103 } },  /* g7s3322.44 Hz */
+   {   142, { 3520, 1760,  880, 440, 220, 110 } },  /* a7  3520.00 Hz */
+   {   134, { 3729, 1864,  932, 466, 233, 116 } },  /* a7s3729.31 Hz */
+   {   126, { 3951, 1975,  987, 493, 246, 123 } },  /* b7  3951.07 Hz */
+   {   119, { 4186, 2093, 1046, 523, 261, 130 } },  /* c8  4186.01 Hz */
+   {   112, { 4434, 2217, 1108, 554, 277, 138 } },  /* c8s4434.92 Hz */
+   {   106, { 4698, 2349, 1174, 587, 293, 146 } },  /* d8  4698.64 Hz */
+   {   100, { 4978, 2489, 1244, 622, 311, 155 } },  /* d8s4978.03 Hz */
+};
 
 /*
  * Sounder_on
  * Turn sounder on
  */
-static void Sounder_on(){
+static RAMFUNC void Sounder_on(){
    OutputHigh( SND );
 }
 
@@ -70,62 +156,246 @@ static void Sounder_on(){
  * Sounder_off
  * Turn sounder off
  */
-static void Sounder_off(){
+static RAMFUNC void Sounder_off(){
    OutputLow( SND );
 }
 
 
+/*
+ * Sequencer
+ *
+ * Tones wait in a queue and are played from the timer/counter 1
+ * interrupt, so playing never holds up the caller.  A note is followed
+ * by a short silence to articulate it; a rest sounds nothing for its
+ * duration.
+ *
+ * By default the interrupt comes every half period and toggles SND.
+ * With SOUND_TC_WAVE timer/counter 2 makes the square wave on TIOA2 by
+ * itself and timer/counter 1 counts its periods, so the interrupt comes
+ * once per tone.
+ */
+
+#define SOUND_QUEUE   64     /* Tones waiting - power of two */
+#define ARTICULATE_MS 15     /* Silence after each note */
+#define SILENT_US     1000   /* Interrupt period while silent */
+#define KICK_US       100    /* Until the first tone starts */
+#define REST_MAX_MS   1000   /* Longest silence timed in one go */
+
+static Tone queue[SOUND_QUEUE];
+static volatile unsigned int head;    /* Written by the game */
+static volatile unsigned int tail;    /* Written by the interrupt */
+static volatile int busy;             /* Interrupt running */
+
+static int articulate;                /* Silence due after this tone */
+static int restLeft;                  /* Silence still to time - ms */
+
+#if SOUND_TC_WAVE
+
+/*
+ * soundTone()
+ *
+ * Start a note - the hardware counts out its periods
+ */
+static void soundTone( int note, int ms ) {
+   int half = noteTable[note].halfDuration;
+   long periods = ms * 500L / half;
+
+   if ( periods < 1 )
+      periods = 1;
+   if ( periods > 0xFFFF )
+      periods = 0xFFFF;
+
+   AT91SoundWaveTone( half, (unsigned int)periods );
+}
+
+static void soundSilence( int ms ) {
+   AT91SoundWaveRest( ms );
+}
+
+#else
+
+static int count;                     /* Interrupts left in this tone */
+static int sounding;                  /* Toggling the sounder */
+static int level;                     /* Sounder output now */
+
+/*
+ * soundTone()
+ *
+ * Start a note - the interrupt counts out its half periods
+ */
+static void soundTone( int note, int ms ) {
+   int half = noteTable[note].halfDuration;
+
+   count = (int)( ms * 1000L / half );
+   if ( count < 1 )
+      count = 1;
+   sounding = 1;
+   level = 1;
+   Sounder_on();
+   AT91SoundTimerPeriod( half );
+}
+
+static void soundSilence( int ms ) {
+   count = ms;
+   AT91SoundTimerPeriod( SILENT_US );
+}
+
+#endif
+
+
+/*
+ * soundInterrupt()
+ *
+ * Timer/counter 1 - the tone playing is over, or one half period of it
+ * has passed
+ */
+static RAMFUNC void soundInterrupt( void ) {
+   Tone tone;
+   int  ms;
+
+#if !SOUND_TC_WAVE
+   if ( count > 1 ) {
+      count--;
+      if ( sounding ) {
+         level = !level;
+         if ( level )
+            Sounder_on();
+         else
+            Sounder_off();
+      }
+      return;
+   }
+
+   Sounder_off();
+   level = 0;
+   sounding = 0;
+#endif
+
+/* Tone over - more of a long rest, the articulation, or the next tone */
+   if ( restLeft > 0 )
+      ms = restLeft;
+   else if ( articulate ) {
+      articulate = 0;
+      ms = ARTICULATE_MS;
+   }
+   else if ( head == tail ) {
+      AT91SoundTimerStop();
+      busy = 0;
+      return;
+   }
+   else {
+      tone = queue[tail % SOUND_QUEUE];
+      tail++;
+
+      if ( tone.note != REST ) {
+         articulate = 1;
+         soundTone( tone.note, tone.ms );
+         return;
+      }
+      ms = tone.ms;
+   }
+
+   restLeft = ms > REST_MAX_MS ? ms - REST_MAX_MS : 0;
+   soundSilence( ms > REST_MAX_MS ? REST_MAX_MS : ms );
+}
+
+
+/*
+ * soundQueue()
+ *
+ * Queue a note or REST lasting ms milliseconds.  Returns at once;
+ * returns 0 if the queue is full and the tone was dropped.
+ */
+int soundQueue( int note, int ms ) {
+   if ( head - tail >= SOUND_QUEUE || ms <= 0 )
+      return 0;
+
+   queue[head % SOUND_QUEUE].note = (unsigned char)note;
+   queue[head % SOUND_QUEUE].ms = (unsigned short)ms;
+   head++;
+
+/* Idle - start the interrupt, which takes the tone from the queue */
+   if ( !busy ) {
+      busy = 1;
+      AT91SoundTimerStart( KICK_US );
+   }
+   return 1;
+}
+
+
+/*
+ * playTune()
+ *
+ * Queue a tune - an array of Tones ending with a zero duration
+ */
+void playTune( const Tone* tune ) {
+   while ( tune->ms != 0 ) {
+      soundQueue( tune->note, tune->ms );
+      tune++;
+   }
+}
+
+
+/*
+ * soundStop()
+ *
+ * Silence the sounder and empty the queue
+ */
+void soundStop( void ) {
+   AT91SoundTimerStop();
+   tail = head;
+   articulate = 0;
+   restLeft = 0;
+#if !SOUND_TC_WAVE
+   count = 0;
+   sounding = 0;
+   level = 0;
+#endif
+   Sounder_off();
+   busy = 0;
+}
+
+
+/*
+ * soundBusy()
+ *
+ * Non-zero while anything is playing or queued
+ */
+int soundBusy( void ) {
+   return busy;
+}
+
+
 /*
  * playNote( );
- * Parameters t: half period in us
- *            n: Number of cycles - duration
+ * Parameters t: note
+ *            n: duration - sb..dsq
+ * Queued - returns at once
  */
 void playNote(int t, int n) {
-   int i;
-   for (i=0; i< noteTable[t].cycles[n]; i++){
-      Sounder_on();
-      Delay_us(noteTable[t].halfDuration);
-      Sounder_off();
-      Delay_us(noteTable[t].halfDuration);
-   }
-   Delay_ms(15); // Inter-note articulation
+   soundQueue( t, DUR_MS(n) );
 }
 
 
 
 /* 
  * playRest();
- * Parameter n: Number of cycles - duration
+ * Parameter n: duration - sb..dsq
+ * Queued - returns at once
  */
 void playRest( int n ) {
-   int i;
-   for (i=0; i< noteTable[0].cycles[n]; i++){
-      Sounder_off();
-      Delay_us(noteTable[0].halfDuration);
-      Sounder_off();
-      Delay_us(noteTable[0].halfDuration);
-   }
+   soundQueue( REST, DUR_MS(n) );
 }
 
 /*
  * soundInit()
  *
- * Fills noteTable values - halfDurations and cycles
+ * Connects the sequencer to its timer interrupt
  * Call this once before calling playRest() or playNote()
  *
  */
 void soundInit() {
-   int n;
-   int mult;
-   int d;
-   for (n= 0; n < 100; n++) {
-      noteTable[n].halfDuration= 1.0 / noteFrequency[n] / 2 * 1000000;
-      mult= 1;
-      for ( d= 0; d <= 5; d++ ) {
-         noteTable[n].cycles[d]= noteFrequency[n] / mult; 
-         mult <<= 1; 
-      }
-   }
+   AT91InitSoundTimer( soundInterrupt );
 }
 
 
@@ -7,6 +7,10 @@
 
 enum dur {sb,m,c,q,sq,dsq};
 
+/* Length of a duration in ms - a semi-breve lasts one second */
+
+#define DUR_MS(d) (1000 >> (d))
+
 /* Names of notes, middle C is c4 */
 
 enum note {c0,c0s,d0,d0s,e0,f0,f0s,g0,g0s,a0,a0s,b0,
@@ -17,9 +21,31 @@ enum note {c0,c0s,d0,d0s,e0,f0,f0s,g0,g0s,a0,a0s,b0,
            c5,c5s,d5,d5s,e5,f5,f5s,g5,g5s,a5,a5s,b5,
            c6,c6s,d6,d6s,e6,f6,f6s,g6,g6s,a6,a6s,b6,
            c7,c7s,d7,d7s,e7,f7,f7s,g7,g7s,a7,a7s,b7,
-           c8,c8s,d8,d8s};
+           c8,c8s,d8,d8s,
+           REST};
+
+/* One step of a tune - a note, or REST, and its length.  A tune is an
+   array of these ending with a zero length */
+
+typedef struct {
+   unsigned char  note;
+   unsigned short ms;
+} Tone;
+
+/* Half period and cycles values for a note - noteTable[note] */
+
+struct note_record {
+   unsigned short halfDuration; /* Micro seconds */
+   unsigned short cycles[6];    /* Cycles for a semi-breve...demi-semi-quaver */
+};
+
+extern const struct note_record noteTable[100];
 
 void soundInit( void );
 void Click ( void );
 void playNote(int t, int n);
 void playRest( int n );
+int soundQueue( int note, int ms );
+void playTune( const Tone* tune );
+void soundStop( void );
+int soundBusy( void );
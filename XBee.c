@@ -13,7 +13,7 @@
  *
  * The uart module (uart.c) provides a serial interface to the XBee; the
  * uart interface must be configured prior to calling XBeeInit using:
- *    UartInit(AT91UartGetchar, AT91UartPutchar),
+ *    UartInit(AT91UartGetchar, AT91UartPutchar, AT91UartSetBaud),
  *    AT91InitInterrupt(TimerBeat, UartRxrdy);
  *    AT91UartInit();
  *
@@ -26,31 +26,248 @@
  *
  * Original - WDH, August, 2008
  * Modified - November, 2008 to include Channel initialisation
+ * Modified - fast bring-up: short negotiated guard time, settings persisted
+ *            with WR, replies parsed as they arrive and command mode skipped
+ *            when the module is already configured
+ * Modified - XBeeSetBaud() raises the line speed above the power-on rate
+ * Modified - MY derived from the factory serial number and
+ *            XBeeSetDestination() for unicast links between paired boards
  *
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "config.h"
 #include "uart.h"
-#include "pg12864.h"
-#include "Delay.h"
+#include "timer.h"
+#include "XBee.h"
+
+/* Guard times - ms.  The factory GT is one second either side of "+++";
+ * XBeeInit() programs XBEE_GT_FAST and persists it with WR so that later
+ * boots only pay a few tens of ms to enter command mode */
+#define XBEE_GT_DEFAULT 1000
+#define XBEE_GT_FAST    20
+
+/* Time allowed for each reply line once a command has been sent - ms */
+#define XBEE_REPLY_TIMEOUT 100
+
+/* WR commits to non-volatile memory and is slow to answer - ms */
+#define XBEE_WRITE_TIMEOUT 1000
+
+#define XBEE_SIGNATURE 0x58426565
+
+/* s_xbeeDL after a failed change - matches no real destination */
+#define XBEE_DL_UNKNOWN 0xFFFFFFFF
+
+/* Configuration signature - survives a warm reset of the AT91 (the XBee
+ * keeps its configuration across it) so command mode can be skipped */
+static __no_init unsigned long s_xbeeSignature;
+
+/* Current line speed of the module - also survives a warm reset */
+static __no_init int s_xbeeBaud;
+
+/* s_xbeeBaud after a failed change that neither speed answered - the next
+   XBeeInit() tries every rate */
+#define XBEE_BAUD_LOST 0x4C4F5354
+
+/* Source address and destination in use - also survive a warm reset */
+static __no_init unsigned int s_xbeeMY;
+static __no_init unsigned int s_xbeeDL;
+
+/* Line speeds selected by ATBD0..ATBD7 */
+static const int s_xbeeRates[] = {
+   1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200
+};
+
+/* Time spent in the last XBeeInit() - ms */
+static int s_xbeeElapsed;
+
+
+/*
+ * XBeeWait()
+ *
+ * Sleep and account for the time spent in bring-up
+ */
+static void XBeeWait( int period ) {
+   Sleep( period );
+   s_xbeeElapsed += period;
+}
+
+
+/*
+ * XBeeRateCode()
+ *
+ * Returns the BD parameter for a line speed, or -1 if the module
+ * does not support it
+ */
+static int XBeeRateCode( int baud ) {
+   int i;
+
+   for ( i = 0; i < (int)( sizeof(s_xbeeRates) / sizeof(s_xbeeRates[0]) ); i++ )
+      if ( s_xbeeRates[i] == baud )
+         return i;
+
+   return -1;
+}
+
+
+/*
+ * XBeeReadReply()
+ *
+ * Collect one <CR> terminated reply line from the module as it arrives.
+ * Replies are upper case letters and hex digits; any other byte is RF data
+ * received while in command mode and restarts the line.  A reply is never
+ * empty, so a lone <CR> is RF data too.
+ * Returns the length of the line or -1 if no complete line arrived
+ * within timeout ms.
+ */
+static int XBeeReadReply( char* reply, int size, int timeout ) {
+   int n = 0;
+   char c;
+
+   while ( timeout > 0 ) {
+      if ( RecvData( &c, 1 ) > 0 ) {
+         if ( c == '\r' && n > 0 ) {
+            reply[n] = 0;
+            return n;
+         }
+         if ( !( ( c >= '0' && c <= '9' ) || ( c >= 'A' && c <= 'Z' ) ) )
+            n = 0;
+         else if ( n < size - 1 )
+            reply[n++] = c;
+      }
+      else {
+         XBeeWait( 1 );
+         timeout--;
+      }
+   }
+
+   reply[n] = 0;
+   return -1;
+}
+
+
+/*
+ * XBeeExpectOK()
+ *
+ * Parse count "OK" replies, each within timeout ms of the previous one.
+ * Returns 1 if all arrived, 0 on a timeout or an error reply.
+ */
+static int XBeeExpectOK( int count, int timeout ) {
+   char reply[16];
+
+   while ( count-- > 0 ) {
+      if ( XBeeReadReply( reply, sizeof(reply), timeout ) < 0 )
+         return 0;
+      if ( strcmp( reply, "OK" ) != 0 )
+         return 0;
+   }
+
+   return 1;
+}
+
+
+/*
+ * XBeeCommandMode()
+ *
+ * Enter command mode assuming the module's guard time is guardTime ms.
+ * The "OK" is taken as soon as it arrives rather than after a fixed delay.
+ * Returns 1 if the module is now in command mode.
+ */
+static int XBeeCommandMode( int guardTime ) {
+   UartFlush();
+   /* Silence before the prefix - counted from when the USART has shifted
+      out the last two characters it may still hold (15 bit times each) */
+   XBeeWait( guardTime + 1 + 30000 / s_xbeeBaud );
+   SendData( "+++", 3 );
+
+   return XBeeExpectOK( 1, guardTime + XBEE_REPLY_TIMEOUT );
+}
+
+
+/*
+ * XBeeSerialAddress()
+ *
+ * Fold the low word of the factory serial number into a 16-bit source
+ * address.  0xFFFE and 0xFFFF select 64-bit addressing and zero is kept
+ * free to mean "no address", so those are moved.
+ */
+static unsigned int XBeeSerialAddress( unsigned long SL ) {
+   unsigned int MY = (unsigned int)( SL & 0xFFFF );
+
+   if ( MY >= 0xFFFE )
+      MY ^= 0x8000;
+   if ( MY == 0 )
+      MY = 1;
+
+   return MY;
+}
+
+
+/*
+ * XBeeCheckConfig()
+ *
+ * In command mode, read back SL, CH, ID, MY, DH and DL in a single command
+ * line.  A requested MY of XBEE_MY_SERIAL is resolved from SL in place.
+ * Every reply is read before comparing so that none is left to be taken
+ * for the "OK" of a later command.
+ * Returns 1 if every value matches, 0 if any differs and -1 if the module
+ * did not answer.
+ */
+static int XBeeCheckConfig( unsigned int* config, int count ) {
+   char reply[16];
+   unsigned long value[6];
+   int i;
+
+   SendLine( "ATSL,CH,ID,MY,DH,DL\r" );
+
+   for ( i = 0; i < count + 1; i++ ) {
+      if ( XBeeReadReply( reply, sizeof(reply), XBEE_REPLY_TIMEOUT ) <= 0 )
+         return -1;
+      value[i] = strtoul( reply, NULL, 16 );
+   }
+
+   if ( config[2] == XBEE_MY_SERIAL )
+      config[2] = XBeeSerialAddress( value[0] );
+
+   for ( i = 0; i < count; i++ )
+      if ( value[i + 1] != config[i] )
+         return 0;
+
+   return 1;
+}
+
 
 /*
  * XBeeInit - Initialise XBee module
  *
- * Enter command mode - "+++"
- * Issue AT command prefix - "AT"
- * Assign PanID - "ID"
- * Assign MY address - "MY"
- * Assign Destination address - "DH", "DL"
+ * Skip command mode if this configuration was applied before a warm reset
+ * Enter command mode - "+++" with the fast guard time, falling back to
+ *                      the factory guard time for a new module
+ * Read back the configuration - "ATSL,CH,ID,MY,DH,DL"
+ * If it differs:
+ *    Assign Channel - "CH"
+ *    Assign PanID - "ID"
+ *    Assign MY address - "MY"
+ *    Assign Destination address - "DH", "DL"
+ *    Assign fast guard time - "GT"
+ *    Assign power-on line speed - "BD"
+ *    Persist settings - "WR"
  * Exit command mode - "CN"
  *
+ * A module left at a raised line speed by XBeeSetBaud() before a warm reset
+ * is addressed at that speed first.  Only the power-on speed, BAUD_RATE,
+ * is ever written to non-volatile memory.  One whose speed XBeeSetBaud()
+ * lost track of is looked for at every speed, fastest first.
+ *
  * Parameters:
  *     Channel: in {0x0B..0x1A}
  *     PanID: PANID in {0x0000..0xFFFF}
- *     Source address: MY in {0x0000..0xFFFF}
+ *     Source address: MY in {0x0000..0xFFFF}, or XBEE_MY_SERIAL to derive
+ *                     a unique MY from the module's serial number (SL)
  *     Desination address high: DH in {0x00000000..0xFFFFFFFF}
- *     Desination address low:  DL in {0x00000000..0xFFFFFFFF}
+ *     Desination address low:  DL in {0x0000..0xFFFF}
  *
  * Point-to-point (unicast) addressing:
  *     16-bit source address:
@@ -76,11 +293,21 @@
  *     a broadcast.
  *     Broadcast destination address to the PAN is DH+DL= 0x00000000 0000FFFF)
  *
+ * Timing (9600 baud):
+ *     Warm reset, same configuration:     0 ms
+ *     Configured module:                ~80 ms (2 x GT, "OK", 6 values, CN)
+ *     Factory module (first boot only): ~2.1 s (2 x factory GT, WR)
+ * The previous sequence took over 4 s on every boot.  XBeeInitTime()
+ * returns the figure for the last call.
+ *
+ * Note - a factory module ignores the fast "+++" and forwards it as data,
+ * so a peer may see three stray bytes the first time a module is set up.
+ *
  * Returns -1 - argument error
  *         -2 - command failed to get XBee response
  *          0 - success
  *
- * Requires UartInit(), SendData() and ReceiveLine() in uart.c and
+ * Requires UartInit(), SendData() and RecvData() in uart.c and
  * AT91InitInterrupt() and AT91UartInit() in at91.c
  */
  int XBeeInit( unsigned int Channel,
@@ -90,41 +317,294 @@
                unsigned int DL ){
 
     char commandString[100];
+    unsigned int config[5];
+    unsigned long signature;
+    int configured;
+    int lost;
+    int match;
     int n;
     
+   s_xbeeElapsed = 0;
+
+   lost = ( s_xbeeBaud == XBEE_BAUD_LOST );
+   if ( XBeeRateCode( s_xbeeBaud ) < 0 )  /* Cold boot - power-on rate */
+      s_xbeeBaud = BAUD_RATE;
+   if ( s_xbeeBaud != BAUD_RATE )
+      UartSetBaud( s_xbeeBaud );
+
 /* Check parameters */
    if ( ( Channel < 0x0B ) || ( Channel > 0x1A ) )
       return -1;
    if ( PANID > 0xFFFF )
       return -1;
-   if ( MY > 0xFFFF )
+   if ( ( MY > 0xFFFF ) && ( MY != XBEE_MY_SERIAL ) )
+      return -1;
+   if ( DL > 0xFFFF )
       return -1;
 
-/* Flush Rx buffer */
-   ReceiveLine(commandString, 2000);
+   config[0] = Channel;
+   config[1] = PANID;
+   config[2] = MY;
+   config[3] = DH;
+   config[4] = DL;
 
-/* Send command prefix */
-   SendData( "+++", 3 );
-   Delay_ms(2000);
-   
-/* Assemble command string */
-   sprintf( commandString, "ATCH%.2X,ID%.4X,MY%.4X,DH%.8X,DL%.8X,CN\r",
-            Channel, PANID, MY, DH, DL );
-
-/* Send command string to XBee module
- * E.g., "ATCH1A,ID3330,MY0001,DH00000000,DL00000002,CN<CR>"
+   signature = XBEE_SIGNATURE ^ ( Channel << 24 ) ^ ( PANID << 8 ) ^ MY ^
+               ( DH << 16 );
+
+/* Module already carries this configuration - stay in transparent mode,
+   restoring the destination if it was left paired */
+   if ( s_xbeeSignature == signature ) {
+      UartFlush();
+      return XBeeSetDestination( DL );
+   }
+   s_xbeeSignature = 0;
+
+/* Enter command mode - a configured module answers within the fast GT */
+   configured = XBeeCommandMode( XBEE_GT_FAST );
+   if ( !configured && ( s_xbeeBaud != BAUD_RATE ) ) {
+      s_xbeeBaud = BAUD_RATE;             /* Module has been reset */
+      UartSetBaud( BAUD_RATE );
+      configured = XBeeCommandMode( XBEE_GT_FAST );
+   }
+
+/* A failed XBeeSetBaud() lost the module's rate - try each, fastest first */
+   for ( n = sizeof(s_xbeeRates) / sizeof(s_xbeeRates[0]) - 1;
+         lost && !configured && ( n >= 0 ); n-- ) {
+      if ( s_xbeeRates[n] == BAUD_RATE )
+         continue;
+      s_xbeeBaud = s_xbeeRates[n];
+      UartSetBaud( s_xbeeBaud );
+      configured = XBeeCommandMode( XBEE_GT_FAST );
+   }
+   if ( !configured && ( s_xbeeBaud != BAUD_RATE ) ) {
+      s_xbeeBaud = BAUD_RATE;
+      UartSetBaud( BAUD_RATE );
+   }
+
+   if ( !configured && !XBeeExpectOK( 1, XBEE_GT_DEFAULT ) &&
+        !XBeeCommandMode( XBEE_GT_DEFAULT ) ) {
+      /* A factory module may still accept the fast "+++" once its own
+         guard time has passed; otherwise retry with the factory GT */
+      return -2;
+   }
+
+   match = XBeeCheckConfig( config, 5 );
+   if ( match < 0 )
+      return -2;
+
+   s_xbeeMY = config[2];
+   s_xbeeDL = DL;
+
+   if ( match ) {
+      SendLine( "ATCN\r" );
+      if ( !XBeeExpectOK( 1, XBEE_REPLY_TIMEOUT ) )
+         return -2;
+
+      s_xbeeSignature = signature;
+      return 0;
+   }
+
+/* Assemble command string
+ * E.g., "ATCH1A,ID3330,MY1,DH0,DL2,GT14,BD3,WR,CN<CR>"
  */
-   SendData( commandString, 46 );         /* 46 characters in command string */
-//   Delay_ms(2000);
+   n = sprintf( commandString, "ATCH%X,ID%X,MY%X,DH%X,DL%X,GT%X,BD%X,WR,CN\r",
+                Channel, PANID, config[2], DH, DL, XBEE_GT_FAST,
+                XBeeRateCode( BAUD_RATE ) );
 
-/* Wait for 8 "OK" response */
-   n= ReceiveLine(commandString, 2000);
-   commandString[n]= 0;
+/* Send command string to XBee module */
+   SendData( commandString, n );
 
-/* Check response from XBee module */
-   if ( *strstr(commandString,"OKOKOKOKOKOKOK") == NULL )
+/* Parse an "OK" for each of CH, ID, MY, DH, DL, GT and BD, then WR and CN */
+   if ( !XBeeExpectOK( 7, XBEE_REPLY_TIMEOUT ) )
       return -2;
-   else
+   if ( !XBeeExpectOK( 2, XBEE_WRITE_TIMEOUT ) )
+      return -2;
+
+/* BD takes effect as command mode exits */
+   if ( s_xbeeBaud != BAUD_RATE ) {
+      s_xbeeBaud = BAUD_RATE;
+      UartSetBaud( BAUD_RATE );
+   }
+
+   s_xbeeSignature = signature;
+   return 0;
+}
+
+
+/*
+ * XBeeSetBaud()
+ *
+ * Switch the module and the USART to a new line speed.  The module's BD is
+ * changed (not persisted), the USART follows as command mode exits and the
+ * new rate is verified by a round trip - command mode is re-entered at the
+ * new speed and BD read back.  If the probe fails the module is told to go
+ * back to the previous speed, and the USART follows once it has said OK.
+ * Failing that, each speed is tried in turn and the USART is left at the
+ * one the module answers.
+ *
+ * Serialisation of one SnakeMove (12 bytes, 15 bit times each with the
+ * USART's 5 bit transmit guard), and the mean lockstep wait a frame that
+ * netsim measures on its ideal link (build/netsim -p ideal -b baud):
+ *
+ *        baud   per move   lockstep wait
+ *        9600   18.8 ms       73 ms
+ *       57600    3.1 ms       15 ms
+ *      115200    1.6 ms        8 ms
+ *
+ * Must be called after XBeeInit().
+ *
+ * Parameter:
+ *     baud: one of 1200 .. 115200
+ *
+ * Returns -1 - unsupported rate
+ *         -2 - module did not respond, previous speed kept
+ *         -3 - module answers at neither speed; XBeeInit() must find it
+ *          0 - success
+ */
+int XBeeSetBaud( int baud ) {
+   char commandString[24];            /* ATBD, 8 hex digits and ,CN\r */
+   char reply[16];
+   int previous = s_xbeeBaud;
+   int code = XBeeRateCode( baud );
+
+   if ( code < 0 )
+      return -1;
+   if ( s_xbeeBaud == XBEE_BAUD_LOST )
+      return -3;
+   if ( baud == s_xbeeBaud )
       return 0;
 
+   if ( !XBeeCommandMode( XBEE_GT_FAST ) )
+      return -2;
+
+   sprintf( commandString, "ATBD%X,CN\r", code );
+   SendLine( commandString );
+   if ( !XBeeExpectOK( 2, XBEE_REPLY_TIMEOUT ) ) {
+      SendLine( "ATCN\r" );              /* Rate refused - leave command mode */
+      XBeeExpectOK( 1, XBEE_REPLY_TIMEOUT );
+      return -2;
+   }
+
+   UartSetBaud( baud );
+
+/* Round trip probe at the new rate */
+   if ( XBeeCommandMode( XBEE_GT_FAST ) ) {
+      SendLine( "ATBD\r" );
+      if ( ( XBeeReadReply( reply, sizeof(reply), XBEE_REPLY_TIMEOUT ) > 0 ) &&
+           ( strtoul( reply, NULL, 16 ) == code ) ) {
+         SendLine( "ATCN\r" );
+         if ( XBeeExpectOK( 1, XBEE_REPLY_TIMEOUT ) ) {
+            s_xbeeBaud = baud;
+            return 0;
+         }
+      }
+   }
+
+/* Fall back - the module took BD, so it listens at the new rate.  The
+   restore goes at that rate, its OKs come back at it, and the USART
+   follows the module back once BD applies. */
+   if ( XBeeCommandMode( XBEE_GT_FAST ) ) {
+      sprintf( commandString, "ATBD%X,CN\r", XBeeRateCode( previous ) );
+      SendLine( commandString );
+      if ( XBeeExpectOK( 2, XBEE_REPLY_TIMEOUT ) ) {
+         UartSetBaud( previous );
+         return -2;
+      }
+      SendLine( "ATCN\r" );
+      XBeeExpectOK( 1, XBEE_REPLY_TIMEOUT );
+   }
+
+/* No word of the restore - find which speed the module is at */
+   UartSetBaud( previous );
+   s_xbeeBaud = previous;
+   if ( !XBeeCommandMode( XBEE_GT_FAST ) ) {
+      UartSetBaud( baud );
+      s_xbeeBaud = baud;
+      if ( !XBeeCommandMode( XBEE_GT_FAST ) ) {
+         s_xbeeBaud = XBEE_BAUD_LOST;
+         s_xbeeSignature = 0;
+         return -3;
+      }
+   }
+   SendLine( "ATCN\r" );
+   XBeeExpectOK( 1, XBEE_REPLY_TIMEOUT );
+
+   return s_xbeeBaud == baud ? 0 : -2;
+}
+
+
+/*
+ * XBeeBaud()
+ *
+ * Returns the current line speed to the module - baud, or 0 if it was lost
+ */
+int XBeeBaud( void ) {
+   if ( s_xbeeBaud == XBEE_BAUD_LOST )
+      return 0;
+   return s_xbeeBaud;
+}
+
+
+/*
+ * XBeeInitTime()
+ *
+ * Returns the time taken by the last XBeeInit() and any XBeeSetBaud()
+ * since - ms
+ */
+int XBeeInitTime( void ) {
+   return s_xbeeElapsed;
+}
+
+
+/*
+ * XBeeSetDestination()
+ *
+ * Point the module at a new destination address without persisting it -
+ * DL from XBeeInit() stays in non-volatile memory.  Used to switch between
+ * broadcast (0xFFFF) in the lobby and unicast to the paired board during a
+ * game, so that the module discards other games' packets itself rather
+ * than passing them to the USART.
+ *
+ * Costs two fast guard times and a short reply, ~50 ms.  Anything already
+ * in the receive buffer is discarded.
+ *
+ * Must be called after XBeeInit().
+ *
+ * Parameter:
+ *     DL: destination address in {0x0000..0xFFFF}
+ *
+ * Returns -2 - module did not respond; the next call always reprograms DL
+ *          0 - success
+ */
+int XBeeSetDestination( unsigned int DL ) {
+   char commandString[24];            /* ATDL, 8 hex digits and ,CN\r */
+
+   if ( DL == s_xbeeDL )
+      return 0;
+
+   if ( !XBeeCommandMode( XBEE_GT_FAST ) )
+      return -2;
+
+   sprintf( commandString, "ATDL%X,CN\r", DL );
+   SendLine( commandString );
+   if ( !XBeeExpectOK( 2, XBEE_REPLY_TIMEOUT ) ) {
+      SendLine( "ATCN\r" );
+      XBeeExpectOK( 1, XBEE_REPLY_TIMEOUT );
+      s_xbeeDL = XBEE_DL_UNKNOWN;         /* DL may or may not have changed */
+      return -2;
+   }
+
+   s_xbeeDL = DL;
+   return 0;
+}
+
+
+/*
+ * XBeeAddress()
+ *
+ * Returns the 16-bit source address (MY) in use, resolved from the serial
+ * number when XBeeInit() was given XBEE_MY_SERIAL
+ */
+unsigned int XBeeAddress( void ) {
+   return s_xbeeMY;
 }
@@ -3,9 +3,23 @@
  *
  */
 
+/* MY argument to XBeeInit() - derive the source address from SL */
+#define XBEE_MY_SERIAL 0x10000
+
 /* Initialise the XBee module - assign PANID, MY and DH,DL addresses */
 int XBeeInit( unsigned int Channel,
               unsigned int PANID,
               unsigned int MY,
               unsigned int DH,
               unsigned int DL );
+
+/* Switch module and USART line speed, verified by a round trip */
+int XBeeSetBaud( int baud );
+int XBeeBaud( void );
+
+/* Time taken by the last XBeeInit() and XBeeSetBaud() - ms */
+int XBeeInitTime( void );
+
+/* Unicast to a paired board, or broadcast with DL= 0xFFFF */
+int XBeeSetDestination( unsigned int DL );
+unsigned int XBeeAddress( void );
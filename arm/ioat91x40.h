@@ -0,0 +1,115 @@
+/*
+ * ioat91x40.h
+ *
+ * AT91x40 peripheral registers for the arm-none-eabi build - a stand-in
+ * for the header of the same name that ships with IAR, holding the names
+ * the board code uses.  Addresses are from the AT91x40 datasheet.
+ */
+
+#ifndef IOAT91X40_H
+#define IOAT91X40_H
+
+typedef volatile unsigned long __REG32;
+
+#define __AT91_REG(address)     (*(__REG32*)(address))
+
+// Peripheral identifiers - bit numbers in the AIC registers
+#define FIQ     0
+#define SWIRQ   1
+#define US0IRQ  2
+#define US1IRQ  3
+#define TC0IRQ  4
+#define TC1IRQ  5
+#define TC2IRQ  6
+#define WDIRQ   7
+#define PIOIRQ  8
+
+typedef struct
+{
+  __REG32 fiq:1, swirq:1, us0irq:1, us1irq:1, tc0irq:1, tc1irq:1, tc2irq:1,
+          wdirq:1, pioirq:1, :23;
+} __aic_bits;
+
+typedef struct
+{
+  __REG32 covfs:1, lovrs:1, cpas:1, cpbs:1, cpcs:1, ldras:1, ldrbs:1, etrgs:1, :24;
+} __tc_sr_bits;
+
+// Special function - protect mode
+#define __SF_PMR        __AT91_REG(0xFFF00018)
+
+// USART 0
+#define __US_CR         __AT91_REG(0xFFFD0000)
+#define __US_MR         __AT91_REG(0xFFFD0004)
+#define __US_IER        __AT91_REG(0xFFFD0008)
+#define __US_IDR        __AT91_REG(0xFFFD000C)
+#define __US_IMR        __AT91_REG(0xFFFD0010)
+#define __US_CSR        __AT91_REG(0xFFFD0014)
+#define __US_RHR        __AT91_REG(0xFFFD0018)
+#define __US_THR        __AT91_REG(0xFFFD001C)
+#define __US_BRGR       __AT91_REG(0xFFFD0020)
+#define __US_RTOR       __AT91_REG(0xFFFD0024)
+#define __US_TTGR       __AT91_REG(0xFFFD0028)
+
+// Timer/counter 0 - the heartbeat
+#define __TC_CCR        __AT91_REG(0xFFFE0000)
+#define __TC_CMR        __AT91_REG(0xFFFE0004)
+#define __TC_CV         __AT91_REG(0xFFFE0010)
+#define __TC_RA         __AT91_REG(0xFFFE0014)
+#define __TC_RB         __AT91_REG(0xFFFE0018)
+#define __TC_RC         __AT91_REG(0xFFFE001C)
+#define __TC_SR         __AT91_REG(0xFFFE0020)
+#define __TC_IER        __AT91_REG(0xFFFE0024)
+#define __TC_IER_bit    (*(volatile __tc_sr_bits*)0xFFFE0024)
+#define __TC_IDR        __AT91_REG(0xFFFE0028)
+#define __TC_IMR        __AT91_REG(0xFFFE002C)
+#define __TC_BCR        __AT91_REG(0xFFFE00C0)
+#define __TC_BMR        __AT91_REG(0xFFFE00C4)
+
+// Parallel I/O
+#define __PIO_PER       __AT91_REG(0xFFFF0000)
+#define __PIO_PDR       __AT91_REG(0xFFFF0004)
+#define __PIO_PSR       __AT91_REG(0xFFFF0008)
+#define __PIO_OER       __AT91_REG(0xFFFF0010)
+#define __PIO_ODR       __AT91_REG(0xFFFF0014)
+#define __PIO_OSR       __AT91_REG(0xFFFF0018)
+#define __PIO_SODR      __AT91_REG(0xFFFF0030)
+#define __PIO_CODR      __AT91_REG(0xFFFF0034)
+#define __PIO_ODSR      __AT91_REG(0xFFFF0038)
+#define __PIO_PDSR      __AT91_REG(0xFFFF003C)
+#define __PIO_IER       __AT91_REG(0xFFFF0040)
+#define __PIO_IDR       __AT91_REG(0xFFFF0044)
+#define __PIO_IMR       __AT91_REG(0xFFFF0048)
+#define __PIO_ISR       __AT91_REG(0xFFFF004C)
+
+// Power saving
+#define __PS_CR         __AT91_REG(0xFFFF4000)
+#define __PS_PCER       __AT91_REG(0xFFFF4004)
+#define __PS_PCDR       __AT91_REG(0xFFFF4008)
+#define __PS_PCSR       __AT91_REG(0xFFFF400C)
+
+// Advanced interrupt controller - mode and vector registers are arrays
+// of 32, one for each source, so only the first is named alone
+#define __AIC_SMR0      __AT91_REG(0xFFFFF000)
+#define __AIC_SMR2      __AT91_REG(0xFFFFF008)
+#define __AIC_SMR4      __AT91_REG(0xFFFFF010)
+#define __AIC_SMR5      __AT91_REG(0xFFFFF014)
+#define __AIC_SVR0      __AT91_REG(0xFFFFF080)
+#define __AIC_SVR2      __AT91_REG(0xFFFFF088)
+#define __AIC_SVR4      __AT91_REG(0xFFFFF090)
+#define __AIC_SVR5      __AT91_REG(0xFFFFF094)
+#define __AIC_IVR       __AT91_REG(0xFFFFF100)
+#define __AIC_FVR       __AT91_REG(0xFFFFF104)
+#define __AIC_ISR       __AT91_REG(0xFFFFF108)
+#define __AIC_IPR       __AT91_REG(0xFFFFF10C)
+#define __AIC_IMR       __AT91_REG(0xFFFFF110)
+#define __AIC_IECR      __AT91_REG(0xFFFFF120)
+#define __AIC_IECR_bit  (*(volatile __aic_bits*)0xFFFFF120)
+#define __AIC_IDCR      __AT91_REG(0xFFFFF124)
+#define __AIC_ICCR      __AT91_REG(0xFFFFF128)
+#define __AIC_ICCR_bit  (*(volatile __aic_bits*)0xFFFFF128)
+#define __AIC_ISCR      __AT91_REG(0xFFFFF12C)
+#define __AIC_EOICR     __AT91_REG(0xFFFFF130)
+#define __AIC_SPU       __AT91_REG(0xFFFFF134)
+
+#endif
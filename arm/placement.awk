@@ -0,0 +1,30 @@
+# placement.awk - size and placement of every function and object
+#
+#    arm-none-eabi-nm -S --defined-only snake.elf | awk -f placement.awk
+#
+# One line each: where it runs (flash or sram), what it is (arm or thumb
+# code, or data) and its size in bytes.  nm gives Thumb functions odd
+# addresses.
+
+function hex(s,    i, n)
+{
+  n = 0
+  s = tolower(s)
+  for(i = 1; i <= length(s); ++i)
+    n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+  return n
+}
+
+NF == 4 {
+  address = hex($1)
+  size    = hex($2)
+
+  if($3 ~ /^[tTwW]$/)
+    kind = (address % 2) ? "thumb" : "arm"
+  else if($3 ~ /^[dDbBrR]$/)
+    kind = "data"
+  else
+    next
+
+  printf "%-6s %-6s %7d  %s\n", (address >= 16777216 ? "flash" : "sram"), kind, size, $4
+}
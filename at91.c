@@ -7,6 +7,27 @@
 
 static void(*timer_function)();
 static void(*rxrdy_function)();
+static void(*sound_function)();
+
+// Timer/counter channel 1 - addressed from the TC block base (0xFFFE0000,
+// 0x40 per channel).
+#define TC1_REG(offset) (*(volatile unsigned long*)(0xFFFE0040 + (offset)))
+#define TC1_CCR TC1_REG(0x00)
+#define TC1_CMR TC1_REG(0x04)
+#define TC1_RC  TC1_REG(0x1C)
+#define TC1_SR  TC1_REG(0x20)
+#define TC1_IER TC1_REG(0x24)
+#define TC1_IDR TC1_REG(0x28)
+
+// Timer/counter channel 2 and the block mode register.
+#define TC2_REG(offset) (*(volatile unsigned long*)(0xFFFE0080 + (offset)))
+#define TC2_CCR TC2_REG(0x00)
+#define TC2_CMR TC2_REG(0x04)
+#define TC2_RA  TC2_REG(0x14)
+#define TC2_RC  TC2_REG(0x1C)
+#define TC_BMR  (*(volatile unsigned long*)0xFFFE00C4)
+
+#define TIOA2 0x00000080 // P7
 
 
 //
@@ -19,13 +40,61 @@ void AT91EnablePeripheralClocks()
   __PS_PCER = 0x00017c;
 }
 
+// Idle mode - stop the processor clock until the next interrupt.  The
+// peripherals keep running.
+void AT91Idle()
+{
+  __PS_CR = 1;
+}
+
+#if !__IAR_SYSTEMS_ICC__
+// Interrupt masking for the gcc build - the I bit in the CPSR, which
+// only ARM code can reach.
+__arm void HalDisableInterrupts(void)
+{
+  unsigned long cpsr;
+
+  __asm__ volatile ("mrs %0, cpsr\n\torr %0, %0, #0x80\n\tmsr cpsr_c, %0" : "=r" (cpsr) : : "memory");
+}
+
+__arm void HalEnableInterrupts(void)
+{
+  unsigned long cpsr;
+
+  __asm__ volatile ("mrs %0, cpsr\n\tbic %0, %0, #0x80\n\tmsr cpsr_c, %0" : "=r" (cpsr) : : "memory");
+}
+#endif
+
+// Mask interrupts and return whether they were masked already - the I bit
+// again, for a lock that puts it back as it found it.
+__arm int HalSaveInterrupts(void)
+{
+  unsigned long cpsr;
+
+#if __IAR_SYSTEMS_ICC__
+  cpsr = __get_CPSR();
+  __set_CPSR(cpsr | 0x80);
+#else
+  unsigned long masked;
+
+  __asm__ volatile ("mrs %0, cpsr\n\torr %1, %0, #0x80\n\tmsr cpsr_c, %1" : "=r" (cpsr), "=r" (masked) : : "memory");
+#endif
+  return (cpsr & 0x80) != 0;
+}
+
+__arm void HalRestoreInterrupts(int masked)
+{
+  if (!masked)
+    HalEnableInterrupts();
+}
+
 
 //
 // Interrupt handlers.
 //
 
  /* Timer interrupt handler */
-__irq __arm void heartbeat_irq(void)
+__irq __arm RAMFUNC void heartbeat_irq(void)
 {
   // Called at 1000 Hz rate.
   __AIC_IVR = 0; // Debug variant of vector read, protected mode is used.
@@ -37,8 +106,20 @@ __irq __arm void heartbeat_irq(void)
 }
 
 
+/* Sound timer interrupt handler */
+__irq __arm RAMFUNC void sound_irq(void)
+{
+  __AIC_IVR = 0; // Debug variant of vector read, protected mode is used.
+
+  (*sound_function)(); // Call sound callback function.
+
+  TC1_SR; // Read timer/counter 1 status register.
+  __AIC_EOICR = 0; // Signal end of interrupt to AIC.
+}
+
+
 /* Serial port RX interrupt handler */
-__irq __arm void usart0_rxrdy_interrupt(void)
+__irq __arm RAMFUNC void usart0_rxrdy_interrupt(void)
 {
   __AIC_IVR = 0; // Debug variant of vector read, protected mode is used.
 
@@ -115,8 +196,8 @@ void AT91InitTimer()
   __AIC_ICCR_bit.tc0irq = 1; // Clears timer/counter 0 interrupt.
   __AIC_IECR_bit.tc0irq = 1; // Enable timer/counter 0 interrupt.
   
-  __TC_CMR = 0x00004002; // Capture mode, CPCTRG=1, TCCLKS=2 (/32).
-  __TC_RC = AT91_MCK / 32 / 4000; // Set RC (compare register), 0.25 ms interval.
+  __TC_CMR = 0x00004000; // Capture mode, CPCTRG=1, TCCLKS=0 (/2).
+  __TC_RC = AT91_TIMER_RC; // Set RC (compare register), 1 ms interval.
   __TC_CCR = 1; // Enable the clock.
   __TC_CCR = 5; // Software trigger.
   __TC_CCR = 1; // Clear trigger.
@@ -129,6 +210,116 @@ void AT91StartTimer()
   __TC_IER_bit.cpcs = 1; // Interrupt on RC compare.
 }
 
+// Timer/counter 0 value - counts MCK/2 from 0 to AT91_TIMER_RC - 1 within
+// each millisecond.
+unsigned int AT91TimerCount()
+{
+  return __TC_CV;
+}
+
+// Non-zero while an RC compare waits in the AIC for heartbeat_irq() -
+// the counter has wrapped but the millisecond is not yet counted.
+int AT91TimerPending()
+{
+  return (__AIC_IPR & (1 << TC0IRQ)) != 0;
+}
+
+
+//
+// Sound timer functions - timer/counter 1 interrupts at the period set.
+//
+
+void AT91InitSoundTimer(void(*sound_func)())
+{
+  sound_function = sound_func;
+
+  TC1_IDR = 0xff; // Disable all timer/counter 1 interrupts.
+  __AIC_SVR5 = (unsigned long)&sound_irq;
+  __AIC_SMR5 = 0x25; // Edge-triggered, below the heartbeat at prio 5.
+  __AIC_ICCR = 1 << TC1IRQ; // Clears timer/counter 1 interrupt.
+  __AIC_IECR = 1 << TC1IRQ; // Enable timer/counter 1 interrupt.
+
+#if SOUND_TC_WAVE
+  // TIOA2 is held low by the PIO except while a tone plays.
+  __PIO_PER = TIOA2;
+  __PIO_OER = TIOA2;
+  __PIO_CODR = TIOA2;
+  TC_BMR = 0x0000000C; // TC1XC1S=3 - TIOA2 clocks timer/counter 1 as XC1.
+#endif
+}
+
+// Period in us, up to 31 ms.  Takes effect from the next compare, so it
+// may be called from the sound callback.
+void AT91SoundTimerPeriod(unsigned int us)
+{
+  TC1_RC = us * (AT91_MCK / 32 / 1000) / 1000;
+}
+
+void AT91SoundTimerStart(unsigned int us)
+{
+  TC1_CMR = 0x00004002; // Capture mode, CPCTRG=1, TCCLKS=2 (/32).
+  AT91SoundTimerPeriod(us);
+  TC1_CCR = 5; // Enable the clock, software trigger.
+  TC1_SR; // Clear flags.
+  TC1_IER = 0x10; // Interrupt on RC compare.
+}
+
+void AT91SoundTimerStop()
+{
+  TC1_IDR = 0xff; // No more interrupts.
+  TC1_CCR = 2; // Disable the clock.
+#if SOUND_TC_WAVE
+  TC2_CCR = 2; // Stop the tone.
+  __PIO_PER = TIOA2; // Pin back to the PIO, low.
+#endif
+}
+
+#if SOUND_TC_WAVE
+// Play a square wave of half period halfUs on TIOA2 for the given number
+// of periods.  Timer/counter 2 makes the wave with no interrupts; timer/
+// counter 1, clocked by TIOA2, interrupts once when the periods are done.
+void AT91SoundWaveTone(unsigned int halfUs, unsigned int periods)
+{
+  unsigned int counts = 2 * halfUs * (AT91_MCK / 32 / 1000) / 1000;
+  unsigned int clock = 2; // TCCLKS=2 (/32).
+
+  if (counts > 0xFFFF)
+  {
+    counts /= 4;
+    clock = 3; // TCCLKS=3 (/128) for notes below 32 Hz.
+  }
+
+  TC2_CCR = 2; // Stop the last tone.
+  // Waveform mode, CPCTRG=1, RA compare sets TIOA, RC compare and the
+  // software trigger clear it, external event XC0 so TIOB stays unused.
+  TC2_CMR = 0x0089C400 | clock;
+  TC2_RA = counts / 2;
+  TC2_RC = counts;
+
+  TC1_CMR = 0x00004005; // Capture mode, CPCTRG=1, TCCLKS=5 (XC1 = TIOA2).
+  TC1_RC = periods;
+
+  __PIO_PDR = TIOA2; // TIOA2 drives the pin.
+  TC1_CCR = 5; // Enable, software trigger.
+  TC2_CCR = 5;
+  TC1_SR; // Clear flags.
+  TC1_IER = 0x10; // Interrupt on RC compare.
+}
+
+// Silence for ms, up to 1000, with one interrupt at the end.
+void AT91SoundWaveRest(unsigned int ms)
+{
+  TC2_CCR = 2; // Stop the tone.
+  __PIO_PER = TIOA2; // Pin back to the PIO, low.
+
+  TC1_CMR = 0x00004004; // Capture mode, CPCTRG=1, TCCLKS=4 (/1024).
+  TC1_RC = ms * (AT91_MCK / 1024) / 1000;
+  TC1_CCR = 5; // Enable, software trigger.
+  TC1_SR; // Clear flags.
+  TC1_IER = 0x10; // Interrupt on RC compare.
+}
+#endif
+
 
 //
 // Serial communication functions.
@@ -155,6 +346,18 @@ void AT91UartInit()
   __US_CR = 0x00000050; // Enable receiver, enable transmitter.
 }
 
+
+/*
+ * Change the baud rate.  The divisor is rounded to nearest, which keeps
+ * 115200 within 0.6% at MCK = 66 MHz (truncation would give 2.3%).
+ */
+void AT91UartSetBaud(int baud)
+{
+  while ((__US_CSR & 0x200) == 0) ; // Wait for TXEMPTY
+
+  __US_BRGR = (AT91_MCK + baud * 8) / (baud * 16); // Set baud rate.
+}
+
   
 int AT91UartGetchar()
 {
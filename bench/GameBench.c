@@ -0,0 +1,390 @@
+//
+// GameBench.c
+//
+// Micro-benchmarks for the game's hot functions on the native build
+//
+//    gamebench [-t ms] [-q]
+//
+//    -t  time spent on each function in each state, default 200 ms
+//    -q  quick run - 20 ms each
+//
+// Each function is timed in each board state:
+//
+//    early   both snakes as SetupGame() leaves them - length 4
+//    mid     both snakes at length 50
+//    full    both snakes at length 100 - the cap before bodies were packed
+//    max     both snakes at MAX_SNAKE_LENGTH
+//
+// Output is CSV on stdout, one line per function and state, so runs on
+// two commits can be compared line by line:
+//
+//    function,state,calls,mean_ns,min_ns,max_ns,lcd_data,lcd_commands
+//
+// CpuDecide is timed from a reset player, so each call clears the old
+// ways, starts a search and spends the whole of CPU_BUDGET_NODES - its
+// worst tick.  UpdateScreen
+// draws one tick of both snakes moving onto a screen drawn before it, and
+// CameraScroll the first tick of a scroll to the right - the camera's
+// step and the CAMERA_BYTES of it sent that tick.
+// SnapshotDecode loads the state from the message SnapshotEncode makes
+// of it.
+//
+// Times are host nanoseconds per call.  The LCD columns count the bytes a
+// call sends to the controller.  They are the same on the board, where
+// each byte costs about 20 us of bit-banging.
+//
+
+#define _POSIX_C_SOURCE 200112L
+#include "GameHeader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "timer.h"
+#include "uart.h"
+#include "keypad.h"
+#include "pg12864.h"
+#include "Sound.h"
+#include "CpuPlayer.h"
+#include "Camera.h"
+#include "Snapshot.h"
+
+typedef struct BenchState_
+{
+  const char*     m_name;
+  int             m_length;
+} BenchState;
+
+typedef struct BenchResult_
+{
+  long long       m_calls;
+  long long       m_totalNs;
+  long long       m_minNs;
+  long long       m_maxNs;
+  unsigned long   m_lcdData;
+  unsigned long   m_lcdCommands;
+} BenchResult;
+
+static const BenchState s_states[] =
+{
+  { "early", 4 },
+  { "mid",   50 },
+  { "full",  100 },
+  { "max",   MAX_SNAKE_LENGTH },
+};
+
+static long long  s_budgetNs = 200000000LL;
+static SnakeGame  s_snapshot;
+
+// Free cells for the collision sweep - a whole pass misses every snake
+static unsigned char s_probes[64][2];
+
+//----------------------------------------------------------------
+// Host clock - ns
+static long long Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------
+// Lay a Snake out in a Serpentine
+// The tail fills rows of 40 cells, turning at each end, with the head
+// just above its first cell and heading north into open board.  The
+// snake is walked in from its tail end, so the occupancy map follows.
+static void Piece(int x0, int i, unsigned char* pPos)
+{
+  const int width = 40;
+  const int y0    = PLAY_OFFSETY + 10;
+  int row    = i / width;
+  int column = i % width;
+
+  if(i < 0)
+  {
+    pPos[X] = (unsigned char)x0;
+    pPos[Y] = (unsigned char)(y0 - 1);
+    return;
+  }
+  pPos[X] = (unsigned char)(x0 + ((row & 1) ? width - 1 - column : column));
+  pPos[Y] = (unsigned char)(y0 + row);
+}
+
+static void LayOut(int iPlay, int x0, int length)
+{
+  SnakeData*    pSnake = &s_GameInstance.m_snakes[iPlay];
+  unsigned char from[2];
+  unsigned char to[2];
+  int i;
+
+  Piece(x0, length - 1, from);
+  SnakeStart(&s_GameInstance, iPlay, from[X], from[Y], NORTH, length);
+
+  for(i = length - 2; i >= -1; --i)
+  {
+    Piece(x0, i, to);
+    pSnake->m_dir = to[X] > from[X] ? EAST : to[X] < from[X] ? WEST : to[Y] > from[Y] ? SOUTH : NORTH;
+    MoveSnake(&s_GameInstance, iPlay);
+    from[X] = to[X];
+    from[Y] = to[Y];
+  }
+  pSnake->m_dir = NORTH;
+}
+
+//----------------------------------------------------------------
+// Set the Board up for a State - kept in s_snapshot for each call
+static void SetupState(const BenchState* pState)
+{
+  int i;
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  s_GameInstance.m_randSeed    = 12345;
+  s_GameInstance.m_currState   = STATE_PLAYING;
+  s_GameInstance.m_pickupPos[X] = PLAY_OFFSETX + PLAY_WIDTH - 2;
+  s_GameInstance.m_pickupPos[Y] = PLAY_OFFSETY + PLAY_HEIGHT - 2;
+  s_GameInstance.m_pickupTime  = 100;
+
+  LayOut(0, PLAY_OFFSETX + 4, pState->m_length);
+  LayOut(1, PLAY_OFFSETX + 64, pState->m_length);
+  s_GameInstance.m_numChanges = 0;
+
+  for(i = 0; i < 64; ++i)
+  {
+    s_probes[i][X] = (unsigned char)(PLAY_OFFSETX + 2 * i);
+    s_probes[i][Y] = (unsigned char)(PLAY_OFFSETY + 2);
+  }
+
+  s_snapshot = s_GameInstance;
+}
+
+//----------------------------------------------------------------
+// Functions Timed - each restores its state first, outside the timing
+
+static CpuPlayer s_cpuPlayer;
+
+static void RestoreState(void)
+{
+  s_GameInstance = s_snapshot;
+  soundStop();
+  CpuReset(&s_cpuPlayer);
+  CameraCentre(s_GameInstance.m_snakes[0].m_head);
+}
+
+static void BenchCollisionSweep(void)
+{
+  int i;
+
+  // Batches of 64 - one call is too short to time alone
+  for(i = 0; i < 64; ++i)
+  {
+    CollisionSweep(&s_GameInstance, s_probes[i]);
+  }
+}
+
+static void BenchUpdateSnake(void)
+{
+  UpdateSnake(&s_GameInstance, 0);
+}
+
+static void BenchCpuDecide(void)
+{
+  CpuDecide(&s_cpuPlayer, &s_GameInstance, 0);
+}
+
+static void BenchRandomNumber(void)
+{
+  int i;
+
+  // Batches of 64, as the sweep
+  for(i = 0; i < 64; ++i)
+  {
+    RandomNumber(&s_GameInstance);
+  }
+}
+
+static void BenchGeneratePickup(void)
+{
+  GeneratePickup();
+}
+
+static void BenchRedrawFullGame(void)
+{
+  RedrawFullGame();
+}
+
+static void StepTick(void)
+{
+  int winner;
+
+  RedrawFullGame();
+  GameStep(&s_GameInstance, &winner);
+}
+
+static void BenchUpdateScreen(void)
+{
+  UpdateScreen();
+}
+
+static void BenchCameraScroll(void)
+{
+  unsigned char right[2] = { PLAY_OFFSETX + 100, PLAY_OFFSETY + 20 };
+
+  CameraFollow(right);
+  CameraSend(CAMERA_BYTES);
+}
+
+static unsigned char s_message[SNAPSHOT_MAX];
+static int           s_messageSize;
+
+static void BenchSnapshotEncode(void)
+{
+  s_messageSize = SnapshotEncode(&s_GameInstance, s_message);
+}
+
+static void BenchSnapshotDecode(void)
+{
+  SnapshotDecode(&s_GameInstance, s_message, s_messageSize);
+}
+
+static void ClearPixel(void)
+{
+  LCD_ClearPixel(64, 32);
+}
+
+static void BenchSetPixel(void)
+{
+  LCD_SetPixel(64, 32);
+}
+
+typedef struct BenchFunction_
+{
+  const char*     m_name;
+  void            (*m_call)(void);
+  int             m_batch;            // Calls made by one m_call
+  void            (*m_prepare)(void); // Untimed before each m_call, or NULL
+} BenchFunction;
+
+static const BenchFunction s_functions[] =
+{
+  { "CollisionSweep", BenchCollisionSweep, 64, NULL },
+  { "UpdateSnake",    BenchUpdateSnake,     1, NULL },
+  { "CpuDecide",      BenchCpuDecide,       1, NULL },
+  { "RandomNumber",   BenchRandomNumber,   64, NULL },
+  { "GeneratePickup", BenchGeneratePickup,  1, NULL },
+  { "RedrawFullGame", BenchRedrawFullGame,  1, NULL },
+  { "UpdateScreen",   BenchUpdateScreen,    1, StepTick },
+  { "CameraScroll",   BenchCameraScroll,    1, RedrawFullGame },
+  { "SnapshotEncode", BenchSnapshotEncode,  1, NULL },
+  { "SnapshotDecode", BenchSnapshotDecode,  1, BenchSnapshotEncode },
+  { "LCD_SetPixel",   BenchSetPixel,        1, ClearPixel },
+};
+
+//----------------------------------------------------------------
+// Time one Function until the Budget is spent - at least 3 calls
+static void Run(const BenchFunction* pFunction, BenchResult* pResult)
+{
+  long long      end = Now() + s_budgetNs;
+  unsigned long  data0;
+  unsigned long  commands0;
+  unsigned long  data1;
+  unsigned long  commands1;
+
+  memset(pResult, 0, sizeof(BenchResult));
+  pResult->m_minNs = -1;
+
+  while(pResult->m_calls < 3 || Now() < end)
+  {
+    long long start;
+    long long ns;
+
+    RestoreState();
+    if(pFunction->m_prepare != NULL)
+    {
+      (*pFunction->m_prepare)();
+    }
+    LCD_GetCounters(&data0, &commands0);
+
+    start = Now();
+    (*pFunction->m_call)();
+    ns = (Now() - start) / pFunction->m_batch;
+
+    LCD_GetCounters(&data1, &commands1);
+
+    pResult->m_calls   += pFunction->m_batch;
+    pResult->m_totalNs += ns * pFunction->m_batch;
+    if(pResult->m_minNs < 0 || ns < pResult->m_minNs)
+    {
+      pResult->m_minNs = ns;
+    }
+    if(ns > pResult->m_maxNs)
+    {
+      pResult->m_maxNs = ns;
+    }
+
+    // The same every call - the state is restored
+    pResult->m_lcdData     = (data1 - data0) / pFunction->m_batch;
+    pResult->m_lcdCommands = (commands1 - commands0) / pFunction->m_batch;
+  }
+}
+
+//----------------------------------------------------------------
+// Bring up the Board as main() does - without the XBee
+static void Boot(void)
+{
+  AT91InitialisePIO();
+  keyInit();
+  UartInit(AT91UartGetchar, AT91UartPutchar, AT91UartSetBaud);
+
+  HalDisableInterrupts();
+  AT91InitInterrupt(TimerBeat, UartRxrdy);
+  AT91InitTimer();
+  AT91UartInit();
+  HalEnableInterrupts();
+
+  AT91StartTimer();
+  soundInit();
+  LCD_Init();
+}
+
+int main(int argc, char** argv)
+{
+  int option;
+  int s;
+  int f;
+
+  while((option = getopt(argc, argv, "t:q")) != -1)
+  {
+    switch(option)
+    {
+      case 't': s_budgetNs = atoll(optarg) * 1000000LL; break;
+      case 'q': s_budgetNs = 20000000LL;                break;
+      default:
+        fprintf(stderr, "usage: gamebench [-t ms] [-q]\n");
+        return 2;
+    }
+  }
+
+  Boot();
+
+  printf("function,state,calls,mean_ns,min_ns,max_ns,lcd_data,lcd_commands\n");
+  for(f = 0; f < (int)(sizeof(s_functions) / sizeof(s_functions[0])); ++f)
+  {
+    for(s = 0; s < (int)(sizeof(s_states) / sizeof(s_states[0])); ++s)
+    {
+      BenchResult result;
+
+      SetupState(&s_states[s]);
+      Run(&s_functions[f], &result);
+
+      printf("%s,%s,%lld,%lld,%lld,%lld,%lu,%lu\n", s_functions[f].m_name, s_states[s].m_name,
+             result.m_calls, result.m_totalNs / result.m_calls, result.m_minNs, result.m_maxNs,
+             result.m_lcdData, result.m_lcdCommands);
+      fflush(stdout);
+    }
+  }
+
+  return 0;
+}
@@ -12,23 +12,83 @@
 //#define BAUD_RATE 38400
 #define BAUD_RATE 9600
 
+// XBeeSetBaud() moves the XBee and the USART up to this rate once the
+// module is configured; BAUD_RATE stays the power-on rate of both.
+#define BAUD_RATE_FAST 115200
+
 // Serial port receive buffer size.
 #define RXBUF_SIZE 4096
 
-// cstartup build flags
+// Sound from timer/counter 2 in waveform mode on TIOA2 (P7) instead of
+// toggling SND (P6) from an interrupt every half period.  Needs the
+// sounder wired to P7.
+#ifndef SOUND_TC_WAVE
+#define SOUND_TC_WAVE 0
+#endif
+
+// Time the main loop phases, collision sweeps and LCD writes on the TC0
+// counter (Profile.c).  Costs two counter reads per zone.
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+// Frame budget for the profiler's overrun monitor - 25 frames a second.
+#ifndef FRAME_BUDGET_MS
+#define FRAME_BUDGET_MS 40
+#endif
+
+// CPU opponent (CpuPlayer.c) - cells of work per tick: three flood fills
+// of up to 256 come off first, clearing old ways costs one per 64 bytes,
+// and the search gets the rest.  The worst self-play tick measured on the
+// host is 78 us for 1232 cells; at about 100 cycles a cell it would be
+// 2 ms on the ARM7 at 66 MHz, an estimate the profiler's cpu zone checks.
+#ifndef CPU_BUDGET_NODES
+#define CPU_BUDGET_NODES 1280
+#endif
+
+// Tick of a game against the CPU - there is no lockstep to pace it.
+#ifndef CPU_TICK_MS
+#define CPU_TICK_MS 15
+#endif
+
+// Camera (Camera.c) - squares the camera steps while it scrolls, a byte
+// column's width, and LCD bytes a tick may send of a step.  A step sends
+// at most 16 columns of changed bytes; a column starts only if its worst,
+// 98 bytes, fits what is left, so a tick's share stays under 256 bytes -
+// 5 ms at about 20 us a byte.
+#ifndef CAMERA_STEP
+#define CAMERA_STEP 8
+#endif
+
+#ifndef CAMERA_BYTES
+#define CAMERA_BYTES 256
+#endif
+
+// cstartup build flags - IAR only.  The arm-none-eabi build (arm/) is
+// Thumb with RAMFUNC code as ARM, see hal.h.
 //#define __THUMB_LIBRARY__ 1
 #define __ARM_LIBRARY__ 1
 
 
-#define AT91_EBXX  1
+// Target - 0 for the AT91 board, 1 for the native Linux build, where
+// hal_linux.c (or the simulator's SimPlatform.c) stands in for the board.
+#ifndef HAL_LINUX
+#define HAL_LINUX 0
+#endif
+
+#define AT91_EBXX  (!HAL_LINUX)
 #define AT91_MCK 66000000
 
+#if !HAL_LINUX
 #include <ioat91x40.h>
+#endif
 
 #if __IAR_SYSTEMS_ICC__
 #include <inarm.h>
 #endif
 
-#if AT91_EBXX && __IAR_SYSTEMS_ICC__
+#include "hal.h"
+
+#if AT91_EBXX
 #include "at91.h"
 #endif
@@ -0,0 +1,98 @@
+/*
+ * hal.h
+ *
+ * Board interface - everything the portable sources (the game, timer.c,
+ * uart.c, keypad.c, Delay.c, Sound.c, pg12864.c, XBee.c) need from the
+ * hardware.  at91.c and AT91PIO.c implement it on the AT91 board,
+ * hal_linux.c for the native build (HAL_LINUX in config.h) and
+ * sim/SimPlatform.c for the network simulator.
+ *
+ * Names keep their AT91 prefix so the board code reads as before.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+// Timer/counter 0 runs from MCK/2 and wraps at RC every millisecond.
+#define AT91_TIMER_RC (AT91_MCK / 2 / 1000)
+
+// Interrupt masking - compiler intrinsics on the board.
+// HalSaveInterrupts() masks them and returns nonzero if they were masked
+// already; HalRestoreInterrupts() given that unmasks them only if not.
+//
+// RAMFUNC marks the hot code - the heartbeat with the key scan and clock
+// it runs each beat, the sound interrupt down to the sounder pin, the
+// USART receive path, the LCD's bit-banging and the snake update.  From
+// flash (arm/Makefile) it is built as ARM and copied to internal SRAM at
+// startup; everything else stays in flash as Thumb.  Put it on the
+// definition only - calls in and out of SRAM go through linker stubs.
+#if HAL_LINUX
+void HalDisableInterrupts(void);
+void HalEnableInterrupts(void);
+int HalSaveInterrupts(void);
+void HalRestoreInterrupts(int masked);
+
+// IAR extended keywords
+#define __no_init
+#define RAMFUNC
+
+// hal_linux.c only - the other side of the USART and the keypad
+void HalLinuxReceive(const char* pData, int size);
+int HalLinuxTransmitted(char* pData, int max);
+void HalLinuxKey(int key);
+void HalLinuxKeys(unsigned int keys);
+#elif __IAR_SYSTEMS_ICC__
+#include <intrinsic.h>
+#define HalDisableInterrupts() __disable_interrupt()
+#define HalEnableInterrupts()  __enable_interrupt()
+int HalSaveInterrupts(void);
+void HalRestoreInterrupts(int masked);
+
+// CODE_I - ARM or Thumb as the project's processor mode
+#define RAMFUNC __ramfunc
+#else
+// arm-none-eabi-gcc - Thumb cannot reach the CPSR, so masking is a call
+// to ARM code in at91.c
+void HalDisableInterrupts(void);
+void HalEnableInterrupts(void);
+int HalSaveInterrupts(void);
+void HalRestoreInterrupts(int masked);
+
+// IAR extended keywords
+#define __irq      __attribute__((interrupt("IRQ")))
+#define __arm      __attribute__((target("arm")))
+#define __no_init  __attribute__((section(".noinit")))
+#define RAMFUNC    __attribute__((section(".ramfunc"), target("arm"), noinline))
+#endif
+
+// Interrupts and idle
+void AT91InitInterrupt(void(*timer_func)(), void(*rxrdy_func)());
+void AT91Idle();
+
+// Heartbeat - timer/counter 0
+void AT91InitTimer();
+void AT91StartTimer();
+unsigned int AT91TimerCount();
+int AT91TimerPending();
+
+// Sound - timer/counter 1, and 2 in waveform mode
+void AT91InitSoundTimer(void(*sound_func)());
+void AT91SoundTimerPeriod(unsigned int us);
+void AT91SoundTimerStart(unsigned int us);
+void AT91SoundTimerStop();
+void AT91SoundWaveTone(unsigned int halfUs, unsigned int periods);
+void AT91SoundWaveRest(unsigned int ms);
+
+// USART 0 - the XBee
+void AT91UartInit();
+void AT91UartSetBaud(int baud);
+int AT91UartGetchar();
+void AT91UartPutchar(int ch);
+
+// Parallel I/O - LCD, keypad and sounder
+void AT91InitialisePIO();
+void OutputLow( unsigned long bit );
+void OutputHigh( unsigned long bit );
+unsigned long AT91ReadPins();
+
+#endif
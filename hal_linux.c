@@ -0,0 +1,336 @@
+/*
+ * hal_linux.c
+ *
+ * Board interface (hal.h) for the native Linux build - config.h with
+ * HAL_LINUX set to 1.  The portable sources, keypad.c and Delay.c
+ * included, run on it unchanged, so their timing can be measured and
+ * their behaviour tested on a workstation.
+ *
+ * Time is the host's monotonic clock.  There are no real interrupts: each
+ * time the firmware reads the timer, idles or unmasks interrupts, every
+ * heartbeat and sound timer period that has passed is delivered in order,
+ * as TC0 and TC1 would have.  Masking holds them off until unmasked.
+ *
+ * The USART transmits into a capture buffer, read with
+ * HalLinuxTransmitted(), and receives through HalLinuxReceive(), which
+ * feeds each byte through the RXRDY handler.  The keypad matrix is
+ * emulated at the pins - HalLinuxKey() holds a key down - so keyScan()
+ * debounces it as on the board.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <time.h>
+#include "config.h"
+#include "keypad.h"
+
+// Bytes kept from the USART until read - the oldest are dropped
+#define HAL_TX_CAPTURE  4096
+
+#define HAL_BEAT_NS     1000000LL
+
+static void      (*s_timerIrq)();
+static void      (*s_rxrdyIrq)();
+static void      (*s_soundIrq)();
+
+static long long s_origin = -1;
+static long long s_nextBeat = -1;       // -1 until AT91StartTimer()
+static long long s_soundPeriod;         // 0 while the sound timer is stopped
+static long long s_nextSound;
+static int       s_masked;
+static int       s_inIrq;
+
+static unsigned long s_pins;            // Output levels
+static unsigned  s_keys;               // Keys held down - a bit per key code
+static int       s_rxByte;
+
+static char      s_txBuf[HAL_TX_CAPTURE];
+static int       s_txHead;
+static int       s_txTail;
+
+extern int keyCode[4][4];
+
+//----------------------------------------------------------------
+// Host clock - ns since the first read
+
+static long long HalNow(void)
+{
+  struct timespec ts;
+  long long now;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  now = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  if(s_origin < 0)
+  {
+    s_origin = now;
+  }
+  return now - s_origin;
+}
+
+//----------------------------------------------------------------
+// Deliver the interrupts due - they do not nest
+static void HalCatchUp(void)
+{
+  if(s_masked || s_inIrq)
+  {
+    return;
+  }
+  s_inIrq = 1;
+
+  for(;;)
+  {
+    long long now = HalNow();
+
+    if(s_soundPeriod > 0 && s_nextSound <= now &&
+       (s_nextBeat < 0 || s_nextSound < s_nextBeat))
+    {
+      s_nextSound += s_soundPeriod;
+      (*s_soundIrq)();
+    }
+    else if(s_nextBeat >= 0 && s_nextBeat <= now)
+    {
+      s_nextBeat += HAL_BEAT_NS;
+      (*s_timerIrq)();
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  s_inIrq = 0;
+}
+
+//----------------------------------------------------------------
+// Interrupts and idle
+
+void HalDisableInterrupts(void)
+{
+  s_masked = 1;
+}
+
+void HalEnableInterrupts(void)
+{
+  s_masked = 0;
+  HalCatchUp();
+}
+
+int HalSaveInterrupts(void)
+{
+  int masked = s_masked;
+
+  s_masked = 1;
+  return masked;
+}
+
+void HalRestoreInterrupts(int masked)
+{
+  if(!masked)
+  {
+    HalEnableInterrupts();
+  }
+}
+
+void AT91InitInterrupt(void(*timer_func)(), void(*rxrdy_func)())
+{
+  s_timerIrq = timer_func;
+  s_rxrdyIrq = rxrdy_func;
+}
+
+// Sleep until the next timer interrupt
+void AT91Idle()
+{
+  long long wake = s_nextBeat >= 0 ? s_nextBeat : HalNow() + HAL_BEAT_NS;
+  struct timespec ts;
+
+  if(s_soundPeriod > 0 && s_nextSound < wake)
+  {
+    wake = s_nextSound;
+  }
+  wake += s_origin;
+  ts.tv_sec  = (time_t)(wake / 1000000000LL);
+  ts.tv_nsec = (long)(wake % 1000000000LL);
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+  HalCatchUp();
+}
+
+//----------------------------------------------------------------
+// Heartbeat
+
+void AT91InitTimer() {}
+
+void AT91StartTimer()
+{
+  s_nextBeat = HalNow() + HAL_BEAT_NS;
+}
+
+// The counter within the current heartbeat.  Beats due are delivered
+// first unless masked; one held off shows as pending, the counter having
+// wrapped.  Held off for longer than the board allows, the counter stops
+// half way through the next millisecond rather than letting time go back.
+unsigned int AT91TimerCount()
+{
+  long long now;
+  long long into;
+
+  if(s_nextBeat < 0)
+  {
+    return 0;
+  }
+
+  do
+  {
+    HalCatchUp();
+    now = HalNow();
+  } while(!s_masked && !s_inIrq && now >= s_nextBeat);
+
+  into = now - (s_nextBeat - HAL_BEAT_NS);
+  if(into >= HAL_BEAT_NS)
+  {
+    into -= HAL_BEAT_NS;
+    if(into >= HAL_BEAT_NS / 2)
+    {
+      into = HAL_BEAT_NS / 2 - 1;
+    }
+  }
+  return (unsigned int)(into * AT91_TIMER_RC / HAL_BEAT_NS);
+}
+
+// Only a beat that cannot be delivered is ever seen pending
+int AT91TimerPending()
+{
+  return (s_masked || s_inIrq) && s_nextBeat >= 0 && s_nextBeat <= HalNow();
+}
+
+//----------------------------------------------------------------
+// Sound timer - waveform mode gives one interrupt per tone or silence
+
+void AT91InitSoundTimer(void(*sound_func)())
+{
+  s_soundIrq = sound_func;
+}
+
+void AT91SoundTimerPeriod(unsigned int us)
+{
+  s_soundPeriod = us * 1000LL;
+}
+
+void AT91SoundTimerStart(unsigned int us)
+{
+  AT91SoundTimerPeriod(us);
+  s_nextSound = HalNow() + s_soundPeriod;
+}
+
+void AT91SoundTimerStop()
+{
+  s_soundPeriod = 0;
+}
+
+void AT91SoundWaveTone(unsigned int halfUs, unsigned int periods)
+{
+  AT91SoundTimerStart(2 * halfUs * periods);
+}
+
+void AT91SoundWaveRest(unsigned int ms)
+{
+  AT91SoundTimerStart(ms * 1000);
+}
+
+//----------------------------------------------------------------
+// USART
+
+void AT91UartInit() {}
+void AT91UartSetBaud(int baud) {}
+
+int AT91UartGetchar()
+{
+  return s_rxByte;
+}
+
+void AT91UartPutchar(int ch)
+{
+  s_txBuf[s_txHead] = (char)ch;
+  s_txHead = (s_txHead + 1) % HAL_TX_CAPTURE;
+  if(s_txHead == s_txTail)
+  {
+    s_txTail = (s_txTail + 1) % HAL_TX_CAPTURE;
+  }
+}
+
+// Bytes arriving from the XBee - each raises RXRDY
+void HalLinuxReceive(const char* pData, int size)
+{
+  int i;
+
+  for(i = 0; i < size; ++i)
+  {
+    s_rxByte = (unsigned char)pData[i];
+    (*s_rxrdyIrq)();
+  }
+}
+
+// Bytes transmitted since the last call, up to max
+int HalLinuxTransmitted(char* pData, int max)
+{
+  int n = 0;
+
+  while(n < max && s_txTail != s_txHead)
+  {
+    pData[n++] = s_txBuf[s_txTail];
+    s_txTail = (s_txTail + 1) % HAL_TX_CAPTURE;
+  }
+  return n;
+}
+
+//----------------------------------------------------------------
+// Parallel I/O - the keypad matrix is wired at the pins
+
+void AT91InitialisePIO()
+{
+  s_pins = 0;
+}
+
+void OutputLow(unsigned long bit)
+{
+  s_pins &= ~bit;
+}
+
+void OutputHigh(unsigned long bit)
+{
+  s_pins |= bit;
+}
+
+// Columns are pulled up; a held key pulls its column low while its row
+// is driven low
+unsigned long AT91ReadPins()
+{
+  static const unsigned long rowLine[4] = { Y1, Y2, Y3, Y4 };
+  static const unsigned long columnLine[4] = { X1, X2, X3, X4 };
+  unsigned long pins = s_pins | X1 | X2 | X3 | X4;
+  int row;
+  int column;
+
+  for(row = 0; row < 4; ++row)
+  {
+    for(column = 0; column < 4; ++column)
+    {
+      if((s_keys & (1u << keyCode[row][column])) && (s_pins & rowLine[row]) == 0)
+      {
+        pins &= ~columnLine[column];
+      }
+    }
+  }
+  return pins;
+}
+
+// Hold a key down - -1 releases it
+void HalLinuxKey(int key)
+{
+  s_keys = key < 0 ? 0 : 1u << key;
+}
+
+// Hold several keys down at once - a bit per key code, 0 releases them
+void HalLinuxKeys(unsigned int keys)
+{
+  s_keys = keys;
+}
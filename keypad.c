@@ -1,22 +1,30 @@
 /* keypad.c
  *
  * Keypad driver
- * Provides a single function:
- *     int keyPress();
- * Returns -1 if no key pressed
- *         and 0x00..0x0F to identify
- *         a key thas is pressed
+ *
+ * The matrix is scanned from the heartbeat interrupt - keyScan() is
+ * called by TimerBeat() once a millisecond and reads one row - and each
+ * key is debounced on its own.  Presses and releases are queued with the
+ * time they happened, so the game never waits for the keypad:
+ *
+ *     keyInit();              before the heartbeat starts
+ *     key= keyPoll();         next key pressed, -1 if none
+ *     keyEvent( &event );     next press or release, 0 if none
+ *     key= keyHeld();         key held down now, -1 if none
+ *     keyIsDown( key );       1 if that key is held down now
+ *
+ * Keys are 0x00..0x0F as printed, with * = 0x0A and # = 0x0B
  *
  * Original - WDH September 2006
  * Updated (improved documentation) - WDH September 2008
+ * Scanned from the timer interrupt, event queue
  *
  */
 
 #include "config.h"
 #include "keypad.h"
-#include "Delay.h"
+#include "timer.h"
 #include "AT91PIO.h"
-#include "Sound.h"
 
 int keyCode[4][4] =
 {
@@ -26,113 +34,151 @@ int keyCode[4][4] =
    {0x0a,0x00,0x0b,0x0c}
 };
 
-static void PullRowsLow( void ){
-   OutputLow( Y1 );
-   OutputLow( Y2 );
-   OutputLow( Y3 );   /* In error */
-   OutputLow( Y4 );
+static const unsigned long rowLine[4] = { Y1, Y2, Y3, Y4 };
+static const unsigned long columnLine[4] = { X1, X2, X3, X4 };
+
+/* Scanner state - written by keyScan() only */
+static int row;                       /* Row driven low, read next beat */
+static volatile unsigned short down;  /* Debounced state, bit per key code */
+static unsigned char count[16];       /* Samples disagreeing with down */
+static unsigned long edge[16];        /* Time of the first of them */
+
+/* Event queue - keyScan() writes head, the game reads tail */
+static KeyEvent queue[KEY_QUEUE];
+static volatile unsigned int head;
+static volatile unsigned int tail;
+static unsigned long dropped;
+
+
+/*
+ * keyInit()
+ *
+ * Drive the first row low and the others high, ready for the first scan
+ */
+void keyInit( void ) {
+   int i;
+
+   for ( i = 0; i < 4; i++ )
+      OutputHigh( rowLine[i] );
+   row= 0;
+   OutputLow( rowLine[row] );
 }
 
+
 /*
- * Check each column - the column line with a keypress should be low
+ * keyScan()
+ *
+ * Heartbeat interrupt - read the columns of the row driven low on the
+ * previous beat, which has had a millisecond to settle, then move on to
+ * the next row.  A key changes state once it has read the same for
+ * KEY_DEBOUNCE_MS.
  */
-static int calculateColumn( unsigned long port ) {
-   if ( !(port & X1) )
-      return 1;
-   else if ( !(port & X2) )
-      return 2;
-   else if ( !(port & X3) )
-      return 3;
-   else
-      return 4;
+RAMFUNC void keyScan( void ) {
+   unsigned long port = AT91ReadPins();
+   unsigned long now = TimerNow();
+   int column;
+
+   for ( column = 0; column < 4; column++ ) {
+      int key = keyCode[row][column];
+      unsigned short bit = (unsigned short)( 1 << key );
+      int pressed = !( port & columnLine[column] );
+
+      if ( pressed == !!( down & bit ) ) {
+         count[key]= 0;
+         continue;
+      }
+
+      if ( count[key]++ == 0 )
+         edge[key]= now;
+
+      if ( count[key] * KEY_SCAN_MS >= KEY_DEBOUNCE_MS ) {
+         count[key]= 0;
+         down ^= bit;
+
+         if ( head - tail < KEY_QUEUE ) {
+            queue[head % KEY_QUEUE].time = edge[key];
+            queue[head % KEY_QUEUE].key = (char)key;
+            queue[head % KEY_QUEUE].pressed = (char)pressed;
+            head++;
+         }
+         else
+            dropped++;
+      }
+   }
+
+   OutputHigh( rowLine[row] );
+   row= ( row + 1 ) % 4;
+   OutputLow( rowLine[row] );
 }
 
 
-int calculateRow( unsigned long column ) {
+/*
+ * keyEvent()
+ *
+ * Returns 1 and the oldest press or release, or 0 if there is none
+ */
+int keyEvent( KeyEvent* event ) {
+   if ( head == tail )
+      return 0;
+
+   *event = queue[tail % KEY_QUEUE];
+   tail++;
+   return 1;
+}
+
 
-   OutputLow(Y1);
-   OutputHigh(Y2);
-   OutputHigh(Y3);
-   OutputHigh(Y4);
+/* keyPoll()
+ *   Returns -1 if no key has been pressed
+ *           and 0x00..0x0F for the next key
+ *           pressed, oldest first
+ *
+ * Never waits; releases are skipped
+ */
+int keyPoll( void ) {
+   KeyEvent event;
 
-   if ( column & ~__PIO_PDSR )
-      return 1;
-      
-   OutputHigh(Y1);
-   OutputLow(Y2);
+   while ( keyEvent( &event ) )
+      if ( event.pressed )
+         return event.key;
+
+   return -1;
+}
 
-   if ( column & ~__PIO_PDSR )
-      return 2;
-      
-   OutputHigh(Y2);
-   OutputLow(Y3);
 
-   if ( column & ~__PIO_PDSR )
-      return 3;
+/* keyHeld()
+ *   Returns -1 if no key is held down
+ *           and 0x00..0x0F for the lowest
+ *           key code held
+ */
+int keyHeld( void ) {
+   int key;
 
-   OutputHigh(Y3);
-   OutputLow(Y4);
+   for ( key = 0; key < 16; key++ )
+      if ( down & ( 1 << key ) )
+         return key;
 
-   if ( column & ~__PIO_PDSR )
-      return 4;
-   
-   return 5;
+   return -1;
 }
 
 
+/* keyIsDown()
+ *   Returns 1 if key 0x00..0x0F is held
+ *           down, whatever else is, and
+ *           0 if not
+ */
+int keyIsDown( int key ) {
+   if ( ( key < 0 ) || ( key > 0x0F ) )
+      return 0;
+
+   return ( down >> key ) & 1;
+}
+
 
-/* keyPress()
- *   Returns -1 if no key pressed
- *           and 0x00..0x0F to identify
- *           a key thas is pressed
+/*
+ * keyDropped()
  *
- * Columns - X1..X4 configured for Input;
- * Rows    - Y1..Y4 configured for Output;
- * Pull rows low;
- * Read columns;
- * If (no column low)
- *    return -1;
- * Assign column value;
+ * Events lost to a full queue since start
  */
-int keyPress(){
-
-   unsigned long port; // IOPort value
-   int column;
-   int row;
-   
-   PullRowsLow();
-   
-/* Read IO port */
-   port = __PIO_PDSR;
-   
-/* Return -1 if no key pressed */
-   if ( ( port & X1 ) && ( port & X2 ) && ( port & X3 ) && ( port & X4 ) )
-      return -1;
-      
-/* Calculate column position */
-   column= calculateColumn( port );
-   
-/* Delay for key bounce interval */
-   Delay_ms( 20 );
-
-/* Read port again */
-   port = __PIO_PDSR;   /* Pin Data Status Register */
-   
-/* Test for key bounce */
-   if ( column != calculateColumn( port ) )
-      return -1;
-   
-   if ( !(port & X1) )
-      row= calculateRow( X1 );
-   else if ( !(port & X2) )
-      row= calculateRow( X2 );
-   else if ( !(port & X3) )
-      row= calculateRow( X3 );
-   else if ( !(port & X4) )
-      row= calculateRow( X4 );     
-   else
-      return -1;     
-
-   return keyCode[row-1][column-1];
- 
+unsigned long keyDropped( void ) {
+   return dropped;
 }
@@ -19,5 +19,21 @@
 #define Y3 0x00000100 /* P8 */
 #define Y4 0x00800000 /* P23 */
 
+/* One row is scanned per 1 ms heartbeat */
+#define KEY_SCAN_MS       4   /* Between reads of one key */
+#define KEY_DEBOUNCE_MS  20   /* Steady for this long to change state */
+#define KEY_QUEUE        16   /* Events waiting - power of two */
 
-int keyPress( void );
+typedef struct {
+   unsigned long time;        /* TimerNow() when the key changed */
+   char          key;         /* 0x00..0x0F */
+   char          pressed;     /* 1 pressed, 0 released */
+} KeyEvent;
+
+void keyInit( void );
+void keyScan( void );
+int keyEvent( KeyEvent* event );
+int keyPoll( void );
+int keyHeld( void );
+int keyIsDown( int key );
+unsigned long keyDropped( void );
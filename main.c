@@ -15,23 +15,53 @@
 #include "pg12864.h"
 #include "keypad.h"
 #include "Delay.h"
-#include "sound.h"
+#include "Sound.h"
 #include "XBee.h"
 #include "GameHeader.h"
+#include "Profile.h"
+
+/*
+ * Delay self-test - hold any key during reset
+ *
+ * Shows the error of one Delay_us/Delay_ms call, in ns, for each
+ * period.  Build at each optimisation level and compare.
+ */
+static void delayReport(void) {
+   static const int period[]= { 1, 10, 100, 1000, 10000 };
+   char message[24];
+   int  i;
+
+   LCD_ClearDisplay();
+   LCD_PutString("Delay error\n");
+   for ( i= 0; i < sizeof(period) / sizeof(period[0]); i++ ) {
+      sprintf( message, "%6ius %+6ins\n", period[i], Delay_error( period[i] ) );
+      LCD_PutString( message );
+   }
+
+   while ( keyHeld() != -1 )
+      TimerIdle();
+   Sleep(5000);
+   LCD_ClearDisplay();
+}
 
 void main(void) {
    int        key;        /* keycode */
    int        XBeeCode;   /* XBee initialisation code */
+   int        rateCode;   /* XBeeSetBaud() code */
+   char       message[40];
    SnakeMove  snakeBuffer;
 
 /* Initialise GPIO */
    AT91InitialisePIO();
+
+/* Keypad rows - scanned from the heartbeat once it starts */
+   keyInit();
    
 /* Initialize UART module and register getchar/putchar callbacks. */
-   UartInit(AT91UartGetchar, AT91UartPutchar);
+   UartInit(AT91UartGetchar, AT91UartPutchar, AT91UartSetBaud);
 	
 /* First disable interrupts. */
-   __disable_interrupt();
+   HalDisableInterrupts();
 	
 /* Setup interrupt controller - for timer and UART Rx services */
    AT91InitInterrupt(TimerBeat, UartRxrdy);
@@ -43,7 +73,7 @@ void main(void) {
    AT91UartInit();
 	
 /* Enable interrupts - timer and UART Rx services */
-   __enable_interrupt();
+   HalEnableInterrupts();
 
 /* Start periodic timer. */
    AT91StartTimer();
@@ -53,21 +83,38 @@ void main(void) {
    
 /* Initialise LCD and clear display */
    LCD_Init();
-   Delay_ms(500);
+   Sleep(500);
    LCD_ClearDisplay();
 
+/* Hold any key during reset for the delay self-test */
+   if ( keyHeld() != -1 )
+      delayReport();
+
 /* Title string */
    LCD_PutString("Starting Snake \n");
       
 /* Initialise XBee module
    Channel= 0x0C
    PAN ID= 0x3330
-   Source address= 0x0001
-   Destination address= 0x0000 0000 0000 FFFF - a broadcast address */
-   XBeeCode= XBeeInit( 0x0C, 0x3330, 0x0001, 0x00000000, 0x0000FFFF );
+   Source address= from the module's serial number - unique per board
+   Destination address= 0x0000 0000 0000 FFFF - a broadcast address for the
+   lobby; a game switches to unicast once paired */
+   XBeeCode= XBeeInit( 0x0C, 0x3330, XBEE_MY_SERIAL, 0x00000000, 0x0000FFFF );
+
+/* Raise the line speed - stays at BAUD_RATE if the module does not follow,
+   and the module is found again if it was lost at neither speed */
+   if ( XBeeCode == 0 ) {
+      rateCode= XBeeSetBaud( BAUD_RATE_FAST );
+      if ( rateCode == -2 )
+         rateCode= XBeeSetBaud( BAUD_RATE_FAST / 2 );
+      if ( rateCode == -3 )
+         XBeeCode= XBeeInit( 0x0C, 0x3330, XBEE_MY_SERIAL, 0x00000000, 0x0000FFFF );
+   }
    
-   if ( XBeeCode == 0 )
-      LCD_PutString("XBee OK\n");
+   if ( XBeeCode == 0 ) {
+      sprintf( message, "XBee OK %ims\n%i baud\n", XBeeInitTime(), XBeeBaud() );
+      LCD_PutString( message );
+   }
    else if ( XBeeCode == -2 )
       LCD_PutString("XBee init error\n");
    else if ( XBeeCode == -1 )
@@ -81,6 +128,9 @@ void main(void) {
 /* Main loop - print anything received and send message if key is pressed */
    while (TRUE) 
    {
+     /* Idle time is measured per game state */
+     TimerIdleState(s_GameInstance.m_currState);
+
      switch(s_GameInstance.m_currState)
      {
      case STATE_WAITING_FOR_HOST:
@@ -100,41 +150,73 @@ void main(void) {
          case  8:  LCD_PutString("-_______-^");   break;
          case  9:  LCD_PutString("^-_______-");   break;
          }        
+
+         // Time the Core slept - here and in games so far
+         sprintf( message, "idle %i%% play %i%%  ",
+                  TimerIdlePercent(STATE_WAITING_FOR_HOST),
+                  TimerIdlePercent(STATE_PLAYING) );
+         LCD_PositionCursor(0,48);
+         LCD_PutString( message );
          
          // Press a button to claim hostship
-         if ( ( key= keyPress() ) == 0x0F ) 
+         if ( ( key= keyPoll() ) == 0x0F ) 
          {
            LCD_ClearDisplay();
            LCD_PutString("Game Started \n");           
            StartGame(key);           
          }     
-         // Check if someone is hosting Game
-         else if( RecvData((char*)&snakeBuffer, sizeof(SnakeMove)) > 0)
+         // Play the CPU - no second board needed
+         else if ( key == 0x0D )
+         {
+           LCD_ClearDisplay();
+           LCD_PutString("CPU Game \n");
+           StartCpuGame(key);
+         }
+         // Show the last game's profile, then its overruns
+         else if ( key == 0x0E )
+         {
+           ProfileDraw();
+           Sleep(3000);
+           ProfileDrawOverruns();
+           Sleep(3000);
+
+           LCD_ClearDisplay();
+           LCD_PutString("Game Lobby \n");
+         }
+         // Check if someone is hosting Game - only unpaired hosts advertise
+         else if( RecvMove(&snakeBuffer) == TRUE )
          {
-           // Check its a game starting and not a game in progress
-           if(snakeBuffer.m_updateCount == 1)
-           {
-             LCD_ClearDisplay();
-             LCD_PutString("Game Joined \n");
-             JoinGame(&snakeBuffer);
-           }
+           LCD_ClearDisplay();
+           LCD_PutString("Game Joined \n");
+           JoinGame(&snakeBuffer);
          }
          
-         // DO NOT CLEAR SCREEN!!!
-         Sleep(500);
+         // DO NOT CLEAR SCREEN!!! - and no wait once in a game, where
+         // the peer is already waiting
+         if(s_GameInstance.m_currState == STATE_WAITING_FOR_HOST)
+         {
+           Sleep(500);
+         }
        }
        break;
        
      case STATE_PLAYING:
        {
-         // Normal Game loop
+         // Normal Game loop - each phase timed in its zone
+         ProfileBegin(at);
+
          UpdateNetwork();
+         ProfileNext(ZONE_NETWORK, at);
          
          if(s_GameInstance.m_currState == STATE_PLAYING)
          {
            UpdateGame();
+           ProfileNext(ZONE_GAME, at);
            UpdateScreen();
+           ProfileNext(ZONE_SCREEN, at);
            UpdateInput();
+           ProfileEnd(ZONE_INPUT, at);
+           ProfileFrame();
          }         
        }
        break;
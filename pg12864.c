@@ -78,6 +78,7 @@
 #include "pg12864.h"
 #include "AT91PIO.h"
 #include "Delay.h"
+#include "Profile.h"
 
 
 /* Delay between serial bits */
@@ -97,6 +98,10 @@ static char LCD_y_global;
  */
 static unsigned char VRAM[LCD_X_MAX + 1][LCD_Y_MAX + 1];
 
+/* Bytes sent to the controller since start - see LCD_GetCounters() */
+static unsigned long LCD_data_count;
+static unsigned long LCD_command_count;
+
 
 /*
  * LCD_Init()
@@ -174,7 +179,7 @@ void LCD_Init() {
  * Clears video RAM - assigns 0x00 to all bytes
  *
  */
-static void LCD_ClearVRAM() {
+void LCD_ClearVRAM() {
    unsigned int row;           /* Scans over rows */
    unsigned int col;           /* Scans over columns */
 
@@ -200,7 +205,7 @@ static void LCD_ClearVRAM() {
  * specifies the serial interface protocol used here.
  *
  */
-static void LCD_WriteByte( unsigned char c, unsigned char type ) {
+RAMFUNC void LCD_WriteByte( unsigned char c, unsigned char type ) {
 
    unsigned char bit;        /* Used to index through bits in the data */
 
@@ -251,6 +256,23 @@ static void LCD_WriteByte( unsigned char c, unsigned char type ) {
          LCD_y_global= 0;               /* Yes - start next row */
    }
 
+   if ( type == 1 )
+      LCD_command_count++;
+   else
+      LCD_data_count++;
+}
+
+
+/*
+ * LCD_GetCounters( &data, &commands )
+ *
+ * Bytes sent to the LH155BA since start - data (clear screen included)
+ * and commands, cursor positioning being most of those.  Compare counts
+ * by difference.
+ */
+void LCD_GetCounters( unsigned long* data, unsigned long* commands ) {
+   *data= LCD_data_count;
+   *commands= LCD_command_count;
 }
 
 
@@ -416,7 +438,7 @@ void LCD_ClearDisplay() {
  * Y in {0..LCD_Y_MAX}
  *
  * Sets the pixel in VRAM and then writes the byte containing that pixel
- * to the LCD
+ * to the LCD, unless the pixel was already set
  *
  * If the pixel address is out of range, the function does nothing
  *
@@ -428,18 +450,25 @@ void LCD_SetPixel( unsigned char x, unsigned char y ) {
   if ( ( x > ( LCD_X_MAX * 8 + 7 ) ) || ( y > LCD_Y_MAX ) )
      return;
 
+/* Already set - the display has the byte */
+
+  if ( VRAM[ x / 8 ][ y ] & ( 0x80 >> ( x % 8 ) ) )
+     return;
+
 /* Logical OR this pixel with remaining pixels in this byte */
 
   VRAM[ x / 8 ][ y ] |= 0x80 >> ( x % 8 );
 
-/* Position cursor */
+/* Position cursor - the write timed in ZONE_LCD */
 
+  ProfileBegin( start );
   LCD_x_pos( x / 8 );
   LCD_y_pos( y );
 
 /* Update the display */
 
   LCD_WriteByte( VRAM[ x / 8 ][ y ], 0 );
+  ProfileEnd( ZONE_LCD, start );
 
 }
 
@@ -454,7 +483,7 @@ void LCD_SetPixel( unsigned char x, unsigned char y ) {
  * Y in {0..LCD_Y_MAX}
  *
  * Clears the pixel in VRAM and then writes the byte containing that pixel
- * to the LCD
+ * to the LCD, unless the pixel was already clear
  *
  * If the pixel address is out of range, the function does nothing
  *
@@ -466,23 +495,88 @@ void LCD_ClearPixel( unsigned char x, unsigned char y ) {
   if ( ( x > ( LCD_X_MAX * 8 + 7 ) ) || ( y > LCD_Y_MAX ) )
      return;
 
+/* Already clear - the display has the byte */
+
+  if ( !( VRAM[ x / 8 ][ y ] & ( 0x80 >> ( x % 8 ) ) ) )
+     return;
+
 /* Logical AND this pixel with remaining pixels in this byte */
 
   VRAM[ x / 8 ][ y ] &= ~(0x80 >> ( x % 8 ));
 
-/* Position cursor */
+/* Position cursor - the write timed in ZONE_LCD */
 
+  ProfileBegin( start );
   LCD_x_pos( x / 8 );
   LCD_y_pos( y );
 
 /* Update the display */
 
   LCD_WriteByte( VRAM[ x / 8 ][ y ], 0 );
+  ProfileEnd( ZONE_LCD, start );
 
 }
 
 
 
+/*
+ * LCD_WriteColumn( X, Y, bytes, count )
+ *
+ * Writes count bytes down byte column X, from line Y on
+ *
+ * X in {0..LCD_X_MAX}
+ * Y in {0..LCD_Y_MAX}
+ *
+ * Only runs of bytes that differ from VRAM are sent.  The LH155BA steps
+ * its Y address after each data byte (increment control, LCD_Init()), so
+ * a run costs one cursor position - 3 commands - and a byte a line.  A
+ * gap of fewer than 3 unchanged bytes is sent through rather than
+ * positioning again.  Lines past LCD_Y_MAX are dropped.
+ *
+ */
+void LCD_WriteColumn( unsigned char x, unsigned char y, const unsigned char * bytes, unsigned char count ) {
+
+   unsigned char i= 0;
+   unsigned char gap;
+
+   if ( ( x > LCD_X_MAX ) || ( y > LCD_Y_MAX ) )
+      return;
+
+   if ( count > LCD_Y_MAX + 1 - y )
+      count= LCD_Y_MAX + 1 - y;
+
+   ProfileBegin( start );    /* The column timed in ZONE_LCD */
+
+   while ( i < count ) {
+
+/* Skip bytes the display already has */
+
+      if ( VRAM[ x ][ y + i ] == bytes[ i ] ) {
+         i++;
+         continue;
+      }
+
+/* Position once and send the run */
+
+      LCD_x_pos( x );
+      LCD_y_pos( y + i );
+
+      do {
+         VRAM[ x ][ y + i ]= bytes[ i ];
+         LCD_WriteByte( bytes[ i ], 0 );
+         i++;
+
+         for ( gap= 0; ( i + gap < count ) && ( VRAM[ x ][ y + i + gap ] == bytes[ i + gap ] ); gap++ )
+            ;
+      } while ( ( i + gap < count ) && ( gap < 3 ) );
+
+      i+= gap;
+   }
+
+   ProfileEnd( ZONE_LCD, start );
+}
+
+
 /*
  * Print a single character on the LCD at the current cursor position
  */
@@ -490,6 +584,7 @@ void LCD_PutChar(char c) {
    unsigned char i;
    unsigned char fontIndex;
    unsigned char y;
+   unsigned char b;
 
 /* Handle line feed character */
 
@@ -511,19 +606,23 @@ void LCD_PutChar(char c) {
    fontIndex = ( c - 32 ) % 32;       /* Compute index within a font table */
    y = LCD_y_global;
 
-/* Get font data and output to display */
-/* Note: does not update VRAM! */
+/* Get font data and output to display - timed in ZONE_LCD.  VRAM
+   follows, so pixel writes over text later see what is on screen. */
 
+   ProfileBegin( start );
    for ( i = 0; i < 8; i++ ) {
       switch ( ( c - 32 ) / 32 ) {
-	 case 0: LCD_WriteByte( _LCD1_1_FONT[fontIndex].b[i], 0 ); break;
-	 case 1: LCD_WriteByte( _LCD1_2_FONT[fontIndex].b[i], 0 ); break;
-	 case 2: LCD_WriteByte( _LCD1_3_FONT[fontIndex].b[i], 0 ); break;
-	 case 3: LCD_WriteByte( _LCD1_4_FONT[fontIndex].b[i], 0 ); break;
-	 case 4: LCD_WriteByte( _LCD1_5_FONT[fontIndex].b[i], 0 ); break;
-	 case 5: LCD_WriteByte( _LCD1_6_FONT[fontIndex].b[i], 0 ); break;
-	 case 6: LCD_WriteByte( _LCD1_7_FONT[fontIndex].b[i], 0 ); break;
+	 case 0:  b = _LCD1_1_FONT[fontIndex].b[i]; break;
+	 case 1:  b = _LCD1_2_FONT[fontIndex].b[i]; break;
+	 case 2:  b = _LCD1_3_FONT[fontIndex].b[i]; break;
+	 case 3:  b = _LCD1_4_FONT[fontIndex].b[i]; break;
+	 case 4:  b = _LCD1_5_FONT[fontIndex].b[i]; break;
+	 case 5:  b = _LCD1_6_FONT[fontIndex].b[i]; break;
+	 default: b = _LCD1_7_FONT[fontIndex].b[i]; break;
       }
+      if ( y + i <= LCD_Y_MAX )
+         VRAM[ (unsigned char)LCD_x_global ][ y + i ]= b;
+      LCD_WriteByte( b, 0 );
    }
 
 /* Adjust cursor position */
@@ -538,6 +637,7 @@ void LCD_PutChar(char c) {
          LCD_x_pos( 0 );
    }
 
+   ProfileEnd( ZONE_LCD, start );
 }
 
 
@@ -20,9 +20,11 @@ void LCD_Home();
 void LCD_ClearDisplay();
 void LCD_SetPixel( unsigned char x, unsigned char y );
 void LCD_ClearPixel( unsigned char x, unsigned char y );
+void LCD_WriteColumn( unsigned char x, unsigned char y, const unsigned char * bytes, unsigned char count );
 void LCD_PutString( char * string );
 void LCD_PositionCursor( unsigned char x, unsigned char y );
 void LCD_PutChar( char c );
 
 void LCD_WriteByte( unsigned char, unsigned char );
+void LCD_GetCounters( unsigned long* data, unsigned long* commands );
 void LCD_ClearVRAM( void );
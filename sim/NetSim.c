@@ -0,0 +1,1386 @@
+/*
+ * NetSim.c
+ *
+ * Network channel simulator for lockstep play on Linux - one or more pairs
+ * of boards sharing a radio channel.
+ *
+ * Each board runs a private copy of the firmware (libsnakefw.so - main.c,
+ * GameCore.c, GameRules.c, uart.c, XBee.c, pg12864.c, Sound.c and
+ * SimPlatform.c) as a coroutine on a shared virtual clock.  Everything the firmware sees of the
+ * outside world is modelled here:
+ *
+ *    - the USART line to the XBee at the board's baud rate, including the
+ *      5 bit transmit time guard set in AT91UartInit();
+ *    - the XBee itself: guard time and "+++", AT commands (CH, ID, MY, DH,
+ *      DL, GT, BD, SH, SL, WR, CN), packetisation after 3 silent character
+ *      times and 16-bit/broadcast address filtering;
+ *    - a shared 250 kbit/s radio channel with configurable latency, jitter,
+ *      packet loss, duplication and byte corruption;
+ *    - a keypad bot: one board of each pair hosts from the lobby, the other
+ *      joins whichever game it hears first, and both steer away from walls
+ *      and snakes.  A board that makes no progress for 5 s presses cancel,
+ *      as a player would.
+ *
+ * Reported per channel profile and line speed:
+ *    boot      time from reset to the lobby - XBee bring-up included
+ *    ticks/s   frames per second of play
+ *    wait      mean and worst time per frame in UpdateNetwork()
+ *    stall     share of play spent in UpdateNetwork()
+ *    desync    frames where a board's game state differs from its peer's
+ *    air       mean share of the channel each board's module transmits for
+ *    rx        mean bytes per second each module passes to its board - the
+ *              receive buffer load, including other games' traffic
+ *    idle      mean share of play the core spent in idle mode
+ *
+ * Usage:
+ *    netsim [-p profile|all] [-b baud|all] [-t seconds] [-s seed]
+ *           [-g pairs] [-r seconds] [-f] [-x] [-v] [-l libsnakefw.so]
+ *
+ *    -g  games in range of each other - pairs of boards on one channel
+ *    -f  start from factory XBee modules instead of configured ones
+ *    -r  every so many seconds in a game, the joining board of each pair
+ *        drops out to the lobby and joins again from the host's snapshot.
+ *        Reported per channel profile and line speed: drops, rejoins, mean
+ *        time from the drop back to lockstep, mean snapshot size and mean
+ *        time from the join to the snapshot loaded
+ *    -x  exit with status 1 if any desync was seen
+ *    -v  per-board detail, including the NetStats and profile of each board's
+ *        last game
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <limits.h>
+
+#include "GameHeader.h"
+#include "NetStats.h"
+#include "Profile.h"
+#include "SimHost.h"
+
+#define MS 1000000LL
+#define US 1000LL
+#define SEC (1000LL * MS)
+
+#define MAX_BOARDS      16
+#define STACK_SIZE      (512 * 1024)
+
+/* A busy board yields after this much CPU time so others keep up - ns */
+#define SPEND_QUANTUM   (1 * MS)
+
+/* A playing board with no new frame for this long presses cancel - ns */
+#define STUCK_TIMEOUT   (5 * SEC)
+
+/* The hosting board presses start after this long in the lobby - ns.
+ * Later pairs wait a little longer so that their seeds differ */
+#define HOST_DELAY      (1 * SEC)
+#define HOST_STAGGER    (700 * MS)
+
+#define HASH_RING       256
+
+// ------ XBee model
+#define XB_FACTORY_GT     1000          // ms
+#define XB_FACTORY_BD     3             // 9600
+#define XB_AIR_BYTE_NS    32000         // 250 kbit/s
+#define XB_AIR_OVERHEAD   18            // PHY and MAC bytes per packet
+#define XB_MAX_PACKET     100
+#define XB_CMD_NS         (1 * MS)      // Per command reply
+#define XB_WR_NS          (60 * MS)     // Non-volatile write
+#define XB_CT_NS          (10 * SEC)    // Command mode timeout
+#define XB_BROADCAST      0xFFFF
+
+/* USART character: start, 8 data, stop and a 5 bit transmit time guard */
+#define HOST_CHAR_BITS    15
+#define XB_CHAR_BITS      10
+
+static const int s_rates[] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+
+// ------ Channel profiles
+typedef struct Profile_
+{
+  const char* m_name;
+  double      m_latencyMs;
+  double      m_jitterMs;
+  double      m_loss;
+  double      m_dup;
+  double      m_corrupt;      // Per byte
+} Profile;
+
+static const Profile s_profiles[] =
+{
+  { "ideal",   0.0, 0.0, 0.00, 0.00, 0.0000 },
+  { "office",  2.0, 1.0, 0.01, 0.00, 0.0000 },
+  { "lossy",   3.0, 2.0, 0.05, 0.01, 0.0010 },
+  { "hostile", 5.0, 5.0, 0.15, 0.03, 0.0050 },
+};
+
+#define NUM_PROFILES ((int)(sizeof(s_profiles) / sizeof(s_profiles[0])))
+
+static const int s_bauds[] = { 9600, 57600, 115200 };
+
+#define NUM_BAUDS ((int)(sizeof(s_bauds) / sizeof(s_bauds[0])))
+
+// ------ Events
+enum
+{
+  EV_UART_RX,       // Bytes reach a board's USART
+  EV_RF_RX,         // Packet reaches a module over the air
+  EV_MODEM_FLUSH,   // Packetisation timeout check
+  EV_MODEM_GUARD,   // Guard time after "+++" check
+};
+
+typedef struct Event_
+{
+  long long   m_time;
+  long long   m_seq;
+  int         m_type;
+  int         m_board;
+  int         m_rate;       // Line speed the bytes were sent at
+  int         m_size;
+  char*       m_data;
+} Event;
+
+// ------ XBee module
+typedef struct Modem_
+{
+  unsigned int  m_nv[7];          // Persisted CH ID MY DH DL GT BD
+  unsigned int  m_ch, m_id, m_my, m_dh, m_dl, m_gt, m_bd;
+  unsigned int  m_serial;
+  int           m_maxBd;
+  int           m_pendingBd;
+  int           m_command;        // In command mode
+
+  long long     m_lastRx;         // Last byte from the board
+  long long     m_plusTime;
+  int           m_plus;
+
+  char          m_tx[XB_MAX_PACKET];
+  int           m_txLen;
+
+  char          m_cmd[128];
+  int           m_cmdLen;
+
+  long long     m_hostLineFree;   // Board -> module line busy until
+  long long     m_uartFree;       // Module -> board line busy until
+  long long     m_linkLast[MAX_BOARDS];
+} Modem;
+
+// ------ Board
+typedef struct Board_
+{
+  int             m_index;
+  void*           m_lib;
+  SimAttachFn     m_attach;
+  SimMainFn       m_main;
+  SimReceiveFn    m_receive;
+  SimCollisionFn  m_collision;
+  SnakeGame*      m_game;
+  NetStats*       m_netStats;
+  ProfileStats*   m_profile;
+
+  ucontext_t      m_ctx;
+  char*           m_stack;
+  long long       m_clock;
+  long long       m_syncClock;
+  long long       m_accounted;
+  int             m_baud;
+  Modem           m_modem;
+
+  // Bot
+  int             m_isHostRole;
+  int             m_decide;
+  int             m_lastState;
+  long long       m_lobbySince;
+  long long       m_lastProgress;
+  long long       m_playSince;
+  long long       m_dropAt;
+  unsigned long long m_rng;
+
+  // Stats
+  long long       m_bootNs;
+  long long       m_playNs;
+  long long       m_waitNs;
+  long long       m_waitMax;
+  long long       m_frames;
+  long long       m_games;
+  long long       m_aborts;
+  long long       m_desyncs;
+  long long       m_drops;
+  long long       m_rejoins;
+  long long       m_rejoinNs;
+  long long       m_snapshotBytes;
+  long long       m_snapshotMs;
+  long long       m_airNs;
+  long long       m_txBytes;
+  long long       m_rxBytes;
+
+  struct { int m_seed; int m_frame; unsigned int m_hash; } m_ring[HASH_RING];
+} Board;
+
+// ------ Simulation state
+static Board          s_boards[MAX_BOARDS];
+static int            s_numBoards = 2;
+static ucontext_t     s_schedCtx;
+static const Profile* s_profile;
+static long long      s_airFree;
+static unsigned long long s_rng;
+
+static Event*         s_events;
+static int            s_numEvents;
+static int            s_maxEvents;
+static long long      s_eventSeq;
+
+static char           s_libPath[PATH_MAX];
+static char           s_tmpDir[PATH_MAX];
+static int            s_loadCount;
+static int            s_verbose;
+static int            s_factory;
+static long long      s_dropNs;
+
+//----------------------------------------------------------------
+// Random numbers - xorshift64*, deterministic for a given seed
+
+static unsigned long long NextRandom(unsigned long long* pState)
+{
+  unsigned long long x = *pState;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *pState = x;
+  return x * 2685821657736338717ULL;
+}
+
+static double Uniform(unsigned long long* pState)
+{
+  return (NextRandom(pState) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//----------------------------------------------------------------
+// Event queue - binary heap ordered by time then insertion
+
+static int EventBefore(const Event* a, const Event* b)
+{
+  if(a->m_time != b->m_time)
+  {
+    return a->m_time < b->m_time;
+  }
+  return a->m_seq < b->m_seq;
+}
+
+static void PushEvent(long long time, int type, int board, int rate, const char* data, int size)
+{
+  Event ev;
+  int i;
+
+  if(s_numEvents == s_maxEvents)
+  {
+    s_maxEvents = s_maxEvents ? s_maxEvents * 2 : 1024;
+    s_events = realloc(s_events, s_maxEvents * sizeof(Event));
+  }
+
+  ev.m_time  = time;
+  ev.m_seq   = s_eventSeq++;
+  ev.m_type  = type;
+  ev.m_board = board;
+  ev.m_rate  = rate;
+  ev.m_size  = size;
+  ev.m_data  = NULL;
+  if(size > 0)
+  {
+    ev.m_data = malloc(size);
+    memcpy(ev.m_data, data, size);
+  }
+
+  i = s_numEvents++;
+  while(i > 0 && EventBefore(&ev, &s_events[(i - 1) / 2]))
+  {
+    s_events[i] = s_events[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  s_events[i] = ev;
+}
+
+static Event PopEvent(void)
+{
+  Event top = s_events[0];
+  Event last = s_events[--s_numEvents];
+  int i = 0;
+
+  for(;;)
+  {
+    int child = i * 2 + 1;
+    if(child >= s_numEvents)
+    {
+      break;
+    }
+    if(child + 1 < s_numEvents && EventBefore(&s_events[child + 1], &s_events[child]))
+    {
+      child++;
+    }
+    if(!EventBefore(&s_events[child], &last))
+    {
+      break;
+    }
+    s_events[i] = s_events[child];
+    i = child;
+  }
+  s_events[i] = last;
+
+  return top;
+}
+
+//----------------------------------------------------------------
+// XBee module model
+
+static int ModemRate(const Modem* pModem)
+{
+  return s_rates[pModem->m_bd];
+}
+
+static long long CharTime(int rate, int bits)
+{
+  return bits * SEC / rate;
+}
+
+/* Module -> board: serialise bytes onto the board's USART */
+static void ModemOutput(Board* pBoard, const char* data, int size, long long time)
+{
+  Modem* pModem = &pBoard->m_modem;
+  long long start = time > pModem->m_uartFree ? time : pModem->m_uartFree;
+
+  pModem->m_uartFree = start + size * CharTime(ModemRate(pModem), XB_CHAR_BITS);
+  PushEvent(pModem->m_uartFree, EV_UART_RX, pBoard->m_index, ModemRate(pModem), data, size);
+}
+
+static void ModemReply(Board* pBoard, const char* reply, long long time)
+{
+  ModemOutput(pBoard, reply, strlen(reply), time);
+}
+
+/* Transparent mode: send the buffered bytes as one RF packet */
+static void ModemEmit(Board* pBoard, long long time)
+{
+  Modem* pModem = &pBoard->m_modem;
+  long long airTime = (pModem->m_txLen + XB_AIR_OVERHEAD) * (long long)XB_AIR_BYTE_NS;
+  long long start = time > s_airFree ? time : s_airFree;
+  int i;
+
+  s_airFree = start + airTime;
+  pBoard->m_airNs += airTime;
+
+  for(i = 0; i < s_numBoards; ++i)
+  {
+    Board* pDest = &s_boards[i];
+    Modem* pRecv = &pDest->m_modem;
+    int copies;
+
+    if(pDest == pBoard || pRecv->m_ch != pModem->m_ch || pRecv->m_id != pModem->m_id)
+    {
+      continue;
+    }
+    if(pModem->m_dl != XB_BROADCAST && pModem->m_dl != pRecv->m_my)
+    {
+      continue;
+    }
+    if(Uniform(&s_rng) < s_profile->m_loss)
+    {
+      continue;
+    }
+
+    copies = (Uniform(&s_rng) < s_profile->m_dup) ? 2 : 1;
+    while(copies-- > 0)
+    {
+      char data[XB_MAX_PACKET];
+      long long arrive;
+      int b;
+
+      memcpy(data, pModem->m_tx, pModem->m_txLen);
+      for(b = 0; b < pModem->m_txLen; ++b)
+      {
+        if(Uniform(&s_rng) < s_profile->m_corrupt)
+        {
+          data[b] ^= (char)(1 << (NextRandom(&s_rng) % 8));
+        }
+      }
+
+      arrive = s_airFree
+             + (long long)(s_profile->m_latencyMs * MS)
+             + (long long)(Uniform(&s_rng) * s_profile->m_jitterMs * MS);
+      if(arrive < pModem->m_linkLast[i])
+      {
+        arrive = pModem->m_linkLast[i];     // Links do not reorder
+      }
+      pModem->m_linkLast[i] = arrive;
+
+      PushEvent(arrive, EV_RF_RX, i, 0, data, pModem->m_txLen);
+    }
+  }
+
+  pModem->m_txLen = 0;
+}
+
+static void ModemQueue(Board* pBoard, char ch, long long time)
+{
+  Modem* pModem = &pBoard->m_modem;
+
+  if(pModem->m_txLen == XB_MAX_PACKET)
+  {
+    ModemEmit(pBoard, time);
+  }
+  pModem->m_tx[pModem->m_txLen++] = ch;
+}
+
+/* Execute one AT command line */
+static void ModemCommand(Board* pBoard, long long time)
+{
+  Modem* pModem = &pBoard->m_modem;
+  char* line = pModem->m_cmd;
+  char reply[32];
+
+  pModem->m_cmd[pModem->m_cmdLen] = 0;
+  pModem->m_cmdLen = 0;
+
+  if(toupper(line[0]) != 'A' || toupper(line[1]) != 'T')
+  {
+    ModemReply(pBoard, "ERROR\r", time + XB_CMD_NS);
+    return;
+  }
+  line += 2;
+
+  if(*line == 0)
+  {
+    ModemReply(pBoard, "OK\r", time + XB_CMD_NS);
+    return;
+  }
+
+  while(*line)
+  {
+    char name[3] = { (char)toupper(line[0]), line[0] ? (char)toupper(line[1]) : 0, 0 };
+    unsigned int* pValue = NULL;
+    unsigned int value = 0;
+    int hasValue = 0;
+
+    line += line[1] ? 2 : 1;
+    while(isxdigit((unsigned char)*line))
+    {
+      value = value * 16 + (isdigit((unsigned char)*line) ? *line - '0' : toupper(*line) - 'A' + 10);
+      hasValue = 1;
+      line++;
+    }
+    if(*line == ',')
+    {
+      line++;
+    }
+
+    time += XB_CMD_NS;
+
+    if(!strcmp(name, "CH")) pValue = &pModem->m_ch;
+    else if(!strcmp(name, "ID")) pValue = &pModem->m_id;
+    else if(!strcmp(name, "MY")) pValue = &pModem->m_my;
+    else if(!strcmp(name, "DH")) pValue = &pModem->m_dh;
+    else if(!strcmp(name, "DL")) pValue = &pModem->m_dl;
+    else if(!strcmp(name, "GT")) pValue = &pModem->m_gt;
+
+    if(pValue != NULL)
+    {
+      if(hasValue)
+      {
+        *pValue = value;
+        ModemReply(pBoard, "OK\r", time);
+      }
+      else
+      {
+        sprintf(reply, "%X\r", *pValue);
+        ModemReply(pBoard, reply, time);
+      }
+    }
+    else if(!strcmp(name, "BD"))
+    {
+      if(!hasValue)
+      {
+        sprintf(reply, "%X\r", pModem->m_pendingBd >= 0 ? (unsigned int)pModem->m_pendingBd : pModem->m_bd);
+        ModemReply(pBoard, reply, time);
+      }
+      else if((int)value > pModem->m_maxBd)
+      {
+        ModemReply(pBoard, "ERROR\r", time);
+        return;
+      }
+      else
+      {
+        pModem->m_pendingBd = value;
+        ModemReply(pBoard, "OK\r", time);
+      }
+    }
+    else if(!strcmp(name, "SH") || !strcmp(name, "SL"))
+    {
+      sprintf(reply, "%X\r", name[1] == 'H' ? 0x0013A200 : pModem->m_serial);
+      ModemReply(pBoard, reply, time);
+    }
+    else if(!strcmp(name, "WR"))
+    {
+      time += XB_WR_NS;
+      pModem->m_nv[0] = pModem->m_ch;
+      pModem->m_nv[1] = pModem->m_id;
+      pModem->m_nv[2] = pModem->m_my;
+      pModem->m_nv[3] = pModem->m_dh;
+      pModem->m_nv[4] = pModem->m_dl;
+      pModem->m_nv[5] = pModem->m_gt;
+      pModem->m_nv[6] = pModem->m_pendingBd >= 0 ? (unsigned int)pModem->m_pendingBd : pModem->m_bd;
+      ModemReply(pBoard, "OK\r", time);
+    }
+    else if(!strcmp(name, "CN"))
+    {
+      ModemReply(pBoard, "OK\r", time);
+      pModem->m_command = 0;
+      if(pModem->m_pendingBd >= 0)
+      {
+        pModem->m_bd = (unsigned int)pModem->m_pendingBd;  // After the OK has gone out
+        pModem->m_pendingBd = -1;
+      }
+      return;
+    }
+    else
+    {
+      ModemReply(pBoard, "ERROR\r", time);
+      return;
+    }
+  }
+}
+
+/* Board -> module: one byte has arrived at the module */
+static void ModemInput(Board* pBoard, char ch, long long time)
+{
+  Modem* pModem = &pBoard->m_modem;
+  long long silence = time - pModem->m_lastRx;
+  long long guard = pModem->m_gt * MS;
+
+  pModem->m_lastRx = time;
+
+  if(pModem->m_command && silence > XB_CT_NS)
+  {
+    pModem->m_command = 0;
+    pModem->m_cmdLen = 0;
+  }
+
+  if(pModem->m_command)
+  {
+    if(ch == '\r')
+    {
+      ModemCommand(pBoard, time);
+    }
+    else if(pModem->m_cmdLen < (int)sizeof(pModem->m_cmd) - 1)
+    {
+      pModem->m_cmd[pModem->m_cmdLen++] = ch;
+    }
+    return;
+  }
+
+  // Command sequence - guard time, "+++", guard time
+  if(ch == '+' && pModem->m_plus < 3 && (pModem->m_plus > 0 || silence >= guard))
+  {
+    pModem->m_plus++;
+    pModem->m_plusTime = time;
+    if(pModem->m_plus == 3)
+    {
+      PushEvent(time + guard, EV_MODEM_GUARD, pBoard->m_index, 0, NULL, 0);
+    }
+    return;
+  }
+
+  // Held "+" characters turn out to be data
+  while(pModem->m_plus > 0)
+  {
+    ModemQueue(pBoard, '+', time);
+    pModem->m_plus--;
+  }
+
+  ModemQueue(pBoard, ch, time);
+  PushEvent(time + 3 * CharTime(ModemRate(pModem), XB_CHAR_BITS), EV_MODEM_FLUSH,
+            pBoard->m_index, 0, NULL, 0);
+}
+
+static unsigned int ModemSerial(const Board* pBoard)
+{
+  return 0x40000000 + 0x1234 * (pBoard->m_index + 1);
+}
+
+static void ModemReset(Board* pBoard, int maxBaud)
+{
+  Modem* pModem = &pBoard->m_modem;
+  int i;
+
+  memset(pModem, 0, sizeof(Modem));
+
+  if(s_factory)
+  {
+    unsigned int factory[7] = { 0x0C, 0x3332, 0, 0, 0, XB_FACTORY_GT, XB_FACTORY_BD };
+    memcpy(pModem->m_nv, factory, sizeof(factory));
+  }
+  else
+  {
+    // As left by XBeeInit() on a previous boot - MY from the serial number
+    unsigned int configured[7] = { 0x0C, 0x3330, 0, 0, XB_BROADCAST, 0x14, XB_FACTORY_BD };
+    memcpy(pModem->m_nv, configured, sizeof(configured));
+    pModem->m_nv[2] = ModemSerial(pBoard) & 0xFFFF;
+  }
+
+  pModem->m_ch = pModem->m_nv[0];
+  pModem->m_id = pModem->m_nv[1];
+  pModem->m_my = pModem->m_nv[2];
+  pModem->m_dh = pModem->m_nv[3];
+  pModem->m_dl = pModem->m_nv[4];
+  pModem->m_gt = pModem->m_nv[5];
+  pModem->m_bd = pModem->m_nv[6];
+  pModem->m_pendingBd = -1;
+  pModem->m_serial = ModemSerial(pBoard);
+  pModem->m_lastRx = -SEC * 1000;
+
+  pModem->m_maxBd = 0;
+  for(i = 0; i < (int)(sizeof(s_rates) / sizeof(s_rates[0])); ++i)
+  {
+    if(s_rates[i] <= maxBaud)
+    {
+      pModem->m_maxBd = i;
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Game state checks
+
+static unsigned int HashGame(const SnakeGame* pGame)
+{
+  unsigned int hash = 2166136261u;
+  int i;
+
+#define HASH_VALUE(v) (hash = (hash ^ (unsigned int)(v)) * 16777619u)
+
+  for(i = 0; i < 2; ++i)
+  {
+    HASH_VALUE(pGame->m_snakes[i].m_head[X]);
+    HASH_VALUE(pGame->m_snakes[i].m_head[Y]);
+    HASH_VALUE(pGame->m_snakes[i].m_dir);
+    HASH_VALUE(pGame->m_snakes[i].m_length);
+    HASH_VALUE(pGame->m_snakes[i].m_score);
+  }
+  HASH_VALUE(pGame->m_pickupPos[X]);
+  HASH_VALUE(pGame->m_pickupPos[Y]);
+  HASH_VALUE(pGame->m_pickupValue);
+  HASH_VALUE(pGame->m_pickupTime);
+  HASH_VALUE(pGame->m_randFrame);
+  HASH_VALUE(pGame->m_randDraw);
+
+#undef HASH_VALUE
+
+  return hash;
+}
+
+/* The board this one's module is unicasting to, or its pair partner while
+ * the module broadcasts */
+static Board* Peer(Board* pBoard)
+{
+  int i;
+
+  if(pBoard->m_modem.m_dl != XB_BROADCAST)
+  {
+    for(i = 0; i < s_numBoards; ++i)
+    {
+      if(i != pBoard->m_index && s_boards[i].m_modem.m_my == pBoard->m_modem.m_dl)
+      {
+        return &s_boards[i];
+      }
+    }
+  }
+  return &s_boards[pBoard->m_index ^ 1];
+}
+
+//----------------------------------------------------------------
+// Keypad bot
+
+static const int s_dirKeys[5] = { -1, 0x02, 0x06, 0x08, 0x04 };  // N E S W
+
+static int BotSafe(Board* pBoard, const SnakeData* pSnake, int dir)
+{
+  unsigned char pos[2] = { pSnake->m_head[X], pSnake->m_head[Y] };
+
+  switch(dir)
+  {
+    case NORTH: pos[Y]--; break;
+    case EAST:  pos[X]++; break;
+    case SOUTH: pos[Y]++; break;
+    case WEST:  pos[X]--; break;
+  }
+
+  return pBoard->m_collision(pBoard->m_game, pos) == FALSE;
+}
+
+static int BotSteer(Board* pBoard)
+{
+  const SnakeGame* pGame = pBoard->m_game;
+  const SnakeData* pSnake = &pGame->m_snakes[!pGame->m_isHost];
+  int dir = pSnake->m_dir;
+  int options[3];
+  int count = 0;
+  int pick;
+
+  if(BotSafe(pBoard, pSnake, dir) && (NextRandom(&pBoard->m_rng) % 100) >= 8)
+  {
+    return -1;
+  }
+
+  if(BotSafe(pBoard, pSnake, dir))              options[count++] = dir;
+  if(BotSafe(pBoard, pSnake, (dir + 2) % 4 + 1)) options[count++] = (dir + 2) % 4 + 1;
+  if(BotSafe(pBoard, pSnake, dir % 4 + 1))       options[count++] = dir % 4 + 1;
+
+  if(count == 0)
+  {
+    return -1;
+  }
+
+  pick = options[NextRandom(&pBoard->m_rng) % count];
+  return (pick == dir) ? -1 : s_dirKeys[pick];
+}
+
+//----------------------------------------------------------------
+// SimHost callbacks - run on the board's coroutine
+
+static void Yield(Board* pBoard)
+{
+  swapcontext(&pBoard->m_ctx, &s_schedCtx);
+}
+
+static void HostSpend(void* context, long long ns)
+{
+  Board* pBoard = context;
+
+  pBoard->m_clock += ns;
+  if(pBoard->m_clock - pBoard->m_syncClock >= SPEND_QUANTUM)
+  {
+    Yield(pBoard);
+  }
+}
+
+static void HostSleep(void* context, long long ns)
+{
+  Board* pBoard = context;
+
+  pBoard->m_clock += ns;
+  Yield(pBoard);
+}
+
+static long long HostNow(void* context)
+{
+  return ((Board*)context)->m_clock;
+}
+
+static long long HostTransmit(void* context, int ch)
+{
+  Board* pBoard = context;
+  Modem* pModem = &pBoard->m_modem;
+  long long start = pBoard->m_clock > pModem->m_hostLineFree ? pBoard->m_clock : pModem->m_hostLineFree;
+
+  pModem->m_hostLineFree = start + CharTime(pBoard->m_baud, HOST_CHAR_BITS);
+  pBoard->m_txBytes++;
+
+  // A byte sent at the wrong speed is a framing error at the module
+  if(pBoard->m_baud == ModemRate(pModem))
+  {
+    ModemInput(pBoard, (char)ch, pModem->m_hostLineFree);
+  }
+
+  return start - pBoard->m_clock;
+}
+
+static void HostSetBaud(void* context, int baud)
+{
+  Board* pBoard = context;
+
+  // AT91UartSetBaud() waits for the transmitter to drain
+  if(pBoard->m_modem.m_hostLineFree > pBoard->m_clock)
+  {
+    pBoard->m_clock = pBoard->m_modem.m_hostLineFree;
+  }
+  pBoard->m_baud = baud;
+}
+
+static int HostKey(void* context)
+{
+  Board* pBoard = context;
+  SnakeGame* pGame = pBoard->m_game;
+  int state = pGame->m_currState;
+  int entered = (state != pBoard->m_lastState);
+
+  pBoard->m_lastState = state;
+
+  if(state == STATE_WAITING_FOR_HOST)
+  {
+    if(pBoard->m_bootNs < 0)
+    {
+      pBoard->m_bootNs = pBoard->m_clock;
+    }
+    if(entered || pBoard->m_lobbySince < 0)
+    {
+      pBoard->m_lobbySince = pBoard->m_clock;
+    }
+    if(pBoard->m_isHostRole &&
+       pBoard->m_clock - pBoard->m_lobbySince >= HOST_DELAY + (pBoard->m_index / 2) * HOST_STAGGER)
+    {
+      pBoard->m_lobbySince = -1;
+      pBoard->m_lastProgress = pBoard->m_clock;
+      return 0x0F;
+    }
+    return -1;
+  }
+
+  if(state == STATE_PLAYING)
+  {
+    if(entered)
+    {
+      pBoard->m_lastProgress = pBoard->m_clock;
+      pBoard->m_playSince = pBoard->m_clock;
+    }
+    if(s_dropNs > 0 && !pBoard->m_isHostRole && pBoard->m_dropAt < 0 &&
+       pBoard->m_clock - pBoard->m_playSince >= s_dropNs)
+    {
+      pBoard->m_drops++;
+      pBoard->m_dropAt = pBoard->m_clock;
+      return 0x0C;
+    }
+    if(pBoard->m_clock - pBoard->m_lastProgress > STUCK_TIMEOUT)
+    {
+      pBoard->m_aborts++;
+      pBoard->m_lastProgress = pBoard->m_clock;
+      return 0x0C;
+    }
+    if(pBoard->m_decide)
+    {
+      pBoard->m_decide = 0;
+      return BotSteer(pBoard);
+    }
+  }
+
+  return -1;
+}
+
+static void HostFrame(void* context)
+{
+  Board* pBoard = context;
+  SnakeGame* pGame = pBoard->m_game;
+  int frame = pGame->m_updateCount;
+  Board* pPeer = Peer(pBoard);
+  unsigned int hash = HashGame(pGame);
+  int slot = frame % HASH_RING;
+
+  pBoard->m_frames++;
+  pBoard->m_decide = 1;
+  pBoard->m_lastProgress = pBoard->m_clock;
+  if(frame == 1)
+  {
+    pBoard->m_games++;
+  }
+
+  // First frame since dropping out - back in the same game if it came
+  // from a snapshot
+  if(pBoard->m_dropAt >= 0)
+  {
+    if(pBoard->m_netStats->m_snapshotBytes > 0)
+    {
+      pBoard->m_rejoins++;
+      pBoard->m_rejoinNs += pBoard->m_clock - pBoard->m_dropAt;
+      pBoard->m_snapshotBytes += pBoard->m_netStats->m_snapshotBytes;
+      pBoard->m_snapshotMs += pBoard->m_netStats->m_snapshotMs;
+    }
+    pBoard->m_dropAt = -1;
+  }
+
+  pBoard->m_ring[slot].m_seed  = pGame->m_randSeed;
+  pBoard->m_ring[slot].m_frame = frame;
+  pBoard->m_ring[slot].m_hash  = hash;
+
+  if(pPeer->m_ring[slot].m_frame == frame && pPeer->m_ring[slot].m_seed == pGame->m_randSeed &&
+     pPeer->m_ring[slot].m_hash != hash)
+  {
+    pBoard->m_desyncs++;
+  }
+}
+
+static void HostNetWait(void* context, long long ns)
+{
+  Board* pBoard = context;
+
+  pBoard->m_waitNs += ns;
+  if(ns > pBoard->m_waitMax)
+  {
+    pBoard->m_waitMax = ns;
+  }
+}
+
+//----------------------------------------------------------------
+// Board lifetime
+
+static Board* s_starting;
+
+static void BoardEntry(void)
+{
+  Board* pBoard = s_starting;
+
+  pBoard->m_main();
+
+  // The firmware never returns; park the board if it does
+  pBoard->m_clock = LLONG_MAX;
+  Yield(pBoard);
+}
+
+static void BoardLoad(Board* pBoard, int index, int maxBaud)
+{
+  char path[PATH_MAX + 32];
+  char command[2 * PATH_MAX + 64];
+  SimHost host;
+
+  memset(pBoard, 0, sizeof(Board));
+  pBoard->m_index = index;
+
+  // A private copy of the library gives each board its own globals
+  snprintf(path, sizeof(path), "%s/fw%d.so", s_tmpDir, s_loadCount++);
+  snprintf(command, sizeof(command), "cp '%s' '%s'", s_libPath, path);
+  if(system(command) != 0)
+  {
+    fprintf(stderr, "netsim: cannot copy %s\n", s_libPath);
+    exit(2);
+  }
+
+  pBoard->m_lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  unlink(path);
+  if(pBoard->m_lib == NULL)
+  {
+    fprintf(stderr, "netsim: %s\n", dlerror());
+    exit(2);
+  }
+
+  pBoard->m_attach    = (SimAttachFn)dlsym(pBoard->m_lib, "SimAttach");
+  pBoard->m_main      = (SimMainFn)dlsym(pBoard->m_lib, "SimMain");
+  pBoard->m_receive   = (SimReceiveFn)dlsym(pBoard->m_lib, "SimReceive");
+  pBoard->m_collision = (SimCollisionFn)dlsym(pBoard->m_lib, "CollisionSweep");
+  pBoard->m_game      = ((SimGameFn)dlsym(pBoard->m_lib, "SimGame"))();
+  pBoard->m_netStats  = (NetStats*)dlsym(pBoard->m_lib, "s_NetStats");
+  pBoard->m_profile   = (ProfileStats*)dlsym(pBoard->m_lib, "s_ProfileStats");
+
+  host.m_context  = pBoard;
+  host.m_spend    = HostSpend;
+  host.m_sleep    = HostSleep;
+  host.m_now      = HostNow;
+  host.m_transmit = HostTransmit;
+  host.m_setBaud  = HostSetBaud;
+  host.m_key      = HostKey;
+  host.m_frame    = HostFrame;
+  host.m_netWait  = HostNetWait;
+  pBoard->m_attach(&host);
+
+  pBoard->m_baud = 9600;
+  pBoard->m_bootNs = -1;
+  pBoard->m_lobbySince = -1;
+  pBoard->m_lastState = -1;
+  pBoard->m_dropAt = -1;
+  pBoard->m_isHostRole = (index % 2 == 0);
+  pBoard->m_rng = 0x9E3779B97F4A7C15ULL * (index + 1) ^ s_rng;
+  ModemReset(pBoard, maxBaud);
+
+  pBoard->m_stack = malloc(STACK_SIZE);
+  getcontext(&pBoard->m_ctx);
+  pBoard->m_ctx.uc_stack.ss_sp = pBoard->m_stack;
+  pBoard->m_ctx.uc_stack.ss_size = STACK_SIZE;
+  pBoard->m_ctx.uc_link = NULL;
+  makecontext(&pBoard->m_ctx, BoardEntry, 0);
+
+  // Run up to the first block
+  s_starting = pBoard;
+  swapcontext(&s_schedCtx, &pBoard->m_ctx);
+}
+
+static void BoardUnload(Board* pBoard)
+{
+  dlclose(pBoard->m_lib);
+  free(pBoard->m_stack);
+}
+
+//----------------------------------------------------------------
+// Scheduler
+
+static void ProcessEvent(Event* pEvent)
+{
+  Board* pBoard = &s_boards[pEvent->m_board];
+  Modem* pModem = &pBoard->m_modem;
+
+  switch(pEvent->m_type)
+  {
+    case EV_UART_RX:
+      if(pEvent->m_rate == pBoard->m_baud)
+      {
+        pBoard->m_rxBytes += pEvent->m_size;
+        pBoard->m_receive(pEvent->m_data, pEvent->m_size);
+      }
+      break;
+
+    case EV_RF_RX:
+      ModemOutput(pBoard, pEvent->m_data, pEvent->m_size, pEvent->m_time);
+      break;
+
+    case EV_MODEM_FLUSH:
+      if(pModem->m_txLen > 0 &&
+         pEvent->m_time >= pModem->m_lastRx + 3 * CharTime(ModemRate(pModem), XB_CHAR_BITS))
+      {
+        ModemEmit(pBoard, pEvent->m_time);
+      }
+      break;
+
+    case EV_MODEM_GUARD:
+      if(pModem->m_plus == 3 && pModem->m_lastRx == pModem->m_plusTime)
+      {
+        pModem->m_plus = 0;
+        pModem->m_command = 1;
+        pModem->m_cmdLen = 0;
+        ModemReply(pBoard, "OK\r", pEvent->m_time);
+      }
+      break;
+  }
+
+  free(pEvent->m_data);
+}
+
+static void Run(long long duration)
+{
+  for(;;)
+  {
+    Board* pBoard = &s_boards[0];
+    int i;
+
+    for(i = 1; i < s_numBoards; ++i)
+    {
+      if(s_boards[i].m_clock < pBoard->m_clock)
+      {
+        pBoard = &s_boards[i];
+      }
+    }
+    if(pBoard->m_clock >= duration)
+    {
+      break;
+    }
+
+    while(s_numEvents > 0 && s_events[0].m_time <= pBoard->m_clock)
+    {
+      Event ev = PopEvent();
+      ProcessEvent(&ev);
+    }
+
+    pBoard->m_syncClock = pBoard->m_clock;
+    swapcontext(&s_schedCtx, &pBoard->m_ctx);
+
+    if(pBoard->m_game->m_currState == STATE_PLAYING)
+    {
+      pBoard->m_playNs += pBoard->m_clock - pBoard->m_accounted;
+    }
+    pBoard->m_accounted = pBoard->m_clock;
+  }
+
+  while(s_numEvents > 0)
+  {
+    Event ev = PopEvent();
+    free(ev.m_data);
+  }
+}
+
+//----------------------------------------------------------------
+// Reporting
+
+static void PrintNetStats(const NetStats* pStats)
+{
+  int i;
+
+  if(pStats == NULL || pStats->m_frames == 0)
+  {
+    return;
+  }
+
+  printf("             last game: frames %lu  rtt %lu/%u ms  resends %lu  stalls %lu (%lu ms)  "
+         "rejects %lu/%lu/%lu/%lu  in %lu B  out %lu B  overruns %lu\n"
+         "             rtt histogram:",
+         pStats->m_frames, pStats->m_rounds ? pStats->m_rttTotal / pStats->m_rounds : 0,
+         pStats->m_rttMax, pStats->m_resends, pStats->m_stalls, pStats->m_stallMs,
+         pStats->m_rejects[REJECT_FRAME], pStats->m_rejects[REJECT_SEED],
+         pStats->m_rejects[REJECT_SESSION], pStats->m_rejects[REJECT_SYNC],
+         pStats->m_rxBytes, pStats->m_txBytes, pStats->m_overruns);
+  for(i = 0; i < RTT_BUCKETS; ++i)
+  {
+    printf(" %s%d:%lu", i == RTT_BUCKETS - 1 ? ">=" : "<",
+           RTT_BUCKET0_MS << (i == RTT_BUCKETS - 1 ? i - 1 : i), pStats->m_rttHist[i]);
+  }
+  printf("\n");
+}
+
+static void PrintZone(const char* pName, const ProfileZone* pZone)
+{
+  const double usPerCycle = 2.0 / 66.0;    // TC0 counts MCK/2 at 66 MHz
+
+  if(pZone->m_count == 0)
+  {
+    return;
+  }
+  printf("             %-9s %8lu  min %8.1f  mean %8.1f  max %8.1f us\n", pName, pZone->m_count,
+         pZone->m_min * usPerCycle, (pZone->m_ms * 1000.0 + pZone->m_cycles * usPerCycle) / pZone->m_count,
+         pZone->m_max * usPerCycle);
+}
+
+static void PrintProfile(const ProfileStats* pStats)
+{
+  static const char* const names[NUM_ZONES] =
+  {
+    "network", "game", "screen", "input", "collision", "lcd", "cpu"
+  };
+  int i;
+
+  if(pStats == NULL || pStats->m_frame.m_count == 0)
+  {
+    return;
+  }
+
+  printf("             profile (this game):\n");
+  for(i = 0; i < NUM_ZONES; ++i)
+  {
+    PrintZone(names[i], &pStats->m_zones[i]);
+  }
+  PrintZone("frame", &pStats->m_frame);
+  printf("             frame histogram:");
+  for(i = 0; i < FRAME_BUCKETS; ++i)
+  {
+    printf(" %s%d:%u", i == FRAME_BUCKETS - 1 ? ">=" : "<",
+           FRAME_BUCKET0_MS << (i == FRAME_BUCKETS - 1 ? i - 1 : i), pStats->m_frameHist[i]);
+  }
+  printf("\n             overruns of %lu us: %lu (worst +%lu us) by phase",
+         pStats->m_budgetUs, pStats->m_overruns, pStats->m_overMaxUs);
+  for(i = 0; i < NUM_PHASES; ++i)
+  {
+    printf(" %s:%lu", names[i], pStats->m_overrunsBy[i]);
+  }
+  printf("\n");
+  for(i = 0; i < OVERRUN_RING && i < (int)pStats->m_overruns; ++i)
+  {
+    const Overrun* pReport = &pStats->m_ring[(pStats->m_ringNext + OVERRUN_RING - 1 - i) % OVERRUN_RING];
+
+    printf("               frame %6lu  %7lu us  +%7lu  %-7s  (net %lu game %lu screen %lu input %lu)\n",
+           pReport->m_frame, pReport->m_frameUs, pReport->m_overUs, names[pReport->m_zone],
+           pReport->m_zoneUs[ZONE_NETWORK], pReport->m_zoneUs[ZONE_GAME],
+           pReport->m_zoneUs[ZONE_SCREEN], pReport->m_zoneUs[ZONE_INPUT]);
+  }
+}
+
+typedef struct Result_
+{
+  double    m_bootMs;
+  double    m_ticks;
+  double    m_waitMs;
+  double    m_waitMaxMs;
+  double    m_stall;
+  long long m_frames;
+  long long m_games;
+  long long m_aborts;
+  long long m_desyncs;
+  long long m_drops;
+  long long m_rejoins;
+  double    m_rejoinMs;
+  double    m_snapshotBytes;
+  double    m_snapshotMs;
+  double    m_air;
+  double    m_rxRate;
+  double    m_idle;
+} Result;
+
+static Result Simulate(const Profile* pProfile, int maxBaud, long long duration, unsigned long long seed)
+{
+  Result result;
+  long long playNs = 0;
+  long long waitNs = 0;
+  int (*idlePercent)(int);
+  int i;
+
+  memset(&result, 0, sizeof(result));
+  s_profile = pProfile;
+  s_rng = seed;
+  s_airFree = 0;
+  s_eventSeq = 0;
+
+  for(i = 0; i < s_numBoards; ++i)
+  {
+    BoardLoad(&s_boards[i], i, maxBaud);
+  }
+
+  Run(duration);
+
+  for(i = 0; i < s_numBoards; ++i)
+  {
+    Board* pBoard = &s_boards[i];
+
+    result.m_bootMs  += (pBoard->m_bootNs < 0 ? duration : pBoard->m_bootNs) / (double)MS / s_numBoards;
+    result.m_frames  += pBoard->m_frames;
+    result.m_games   += pBoard->m_isHostRole ? pBoard->m_games : 0;
+    result.m_aborts  += pBoard->m_aborts;
+    result.m_desyncs += pBoard->m_desyncs;
+    result.m_drops   += pBoard->m_drops;
+    result.m_rejoins += pBoard->m_rejoins;
+    result.m_rejoinMs      += pBoard->m_rejoinNs / (double)MS;
+    result.m_snapshotBytes += pBoard->m_snapshotBytes;
+    result.m_snapshotMs    += pBoard->m_snapshotMs;
+    result.m_air     += 100.0 * pBoard->m_airNs / duration / s_numBoards;
+    result.m_rxRate  += pBoard->m_rxBytes / (duration / (double)SEC) / s_numBoards;
+    if(pBoard->m_waitMax / (double)MS > result.m_waitMaxMs)
+    {
+      result.m_waitMaxMs = pBoard->m_waitMax / (double)MS;
+    }
+    playNs += pBoard->m_playNs;
+    waitNs += pBoard->m_waitNs;
+    idlePercent = (int (*)(int))dlsym(pBoard->m_lib, "TimerIdlePercent");
+    result.m_idle += idlePercent(STATE_PLAYING) / (double)s_numBoards;
+
+    if(s_verbose)
+    {
+      printf("    board %d: baud %6d  frames %6lld  play %7.1f s  wait %7.1f s  "
+             "tx %6lld B  rx %6lld B  air %6.1f ms  aborts %lld\n"
+             "             idle: lobby %d%%  play %d%%\n",
+             i, pBoard->m_baud, pBoard->m_frames, pBoard->m_playNs / (double)SEC,
+             pBoard->m_waitNs / (double)SEC, pBoard->m_txBytes, pBoard->m_rxBytes,
+             pBoard->m_airNs / (double)MS, pBoard->m_aborts,
+             idlePercent(STATE_WAITING_FOR_HOST), idlePercent(STATE_PLAYING));
+      // Close the game still in progress so its byte counts are taken
+      ((void (*)(void))dlsym(pBoard->m_lib, "NetStatsEnd"))();
+      PrintNetStats(pBoard->m_netStats);
+      PrintProfile(pBoard->m_profile);
+    }
+
+    BoardUnload(pBoard);
+  }
+
+  if(playNs > 0)
+  {
+    result.m_ticks = result.m_frames / (playNs / (double)SEC);
+    result.m_stall = 100.0 * waitNs / playNs;
+  }
+  if(result.m_frames > 0)
+  {
+    result.m_waitMs = waitNs / (double)MS / result.m_frames;
+  }
+  if(result.m_rejoins > 0)
+  {
+    result.m_rejoinMs      /= result.m_rejoins;
+    result.m_snapshotBytes /= result.m_rejoins;
+    result.m_snapshotMs    /= result.m_rejoins;
+  }
+
+  return result;
+}
+
+static void Usage(void)
+{
+  fprintf(stderr,
+          "usage: netsim [-p profile|all] [-b baud|all] [-t seconds] [-s seed]\n"
+          "              [-g pairs] [-r seconds] [-f] [-x] [-v] [-l libsnakefw.so]\n"
+          "profiles: ideal office lossy hostile\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  const char* profileName = "all";
+  int baud = 0;
+  double seconds = 120.0;
+  unsigned long long seed = 1;
+  int failOnDesync = 0;
+  long long totalDesyncs = 0;
+  int opt;
+  int p;
+  int b;
+
+  // Default library location is next to the executable
+  {
+    char exe[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    exe[n > 0 ? n : 0] = 0;
+    snprintf(s_libPath, sizeof(s_libPath), "%s/libsnakefw.so", dirname(exe));
+  }
+
+  while((opt = getopt(argc, argv, "p:b:t:s:g:r:l:fxv")) != -1)
+  {
+    switch(opt)
+    {
+      case 'p': profileName = optarg;                               break;
+      case 'b': baud = strcmp(optarg, "all") ? atoi(optarg) : 0;    break;
+      case 't': seconds = atof(optarg);                             break;
+      case 's': seed = strtoull(optarg, NULL, 0);                   break;
+      case 'g': s_numBoards = 2 * atoi(optarg);                     break;
+      case 'r': s_dropNs = (long long)(atof(optarg) * SEC);         break;
+      case 'l': snprintf(s_libPath, sizeof(s_libPath), "%s", optarg); break;
+      case 'f': s_factory = 1;                                      break;
+      case 'x': failOnDesync = 1;                                   break;
+      case 'v': s_verbose = 1;                                      break;
+      default:  Usage();
+    }
+  }
+
+  if(s_numBoards < 2 || s_numBoards > MAX_BOARDS)
+  {
+    Usage();
+  }
+
+  snprintf(s_tmpDir, sizeof(s_tmpDir), "/tmp/netsimXXXXXX");
+  if(mkdtemp(s_tmpDir) == NULL)
+  {
+    perror("netsim");
+    return 2;
+  }
+
+  printf("%-8s %7s %8s %8s %8s %8s %7s %7s %6s %6s %6s %6s %7s %6s\n",
+         "profile", "baud", "boot_ms", "ticks/s", "wait_ms", "max_ms", "stall%",
+         "frames", "games", "abort", "desync", "air%", "rxB/s", "idle%");
+
+  for(p = 0; p < NUM_PROFILES; ++p)
+  {
+    if(strcmp(profileName, "all") && strcmp(profileName, s_profiles[p].m_name))
+    {
+      continue;
+    }
+
+    for(b = 0; b < NUM_BAUDS; ++b)
+    {
+      Result r;
+
+      if(baud && baud != s_bauds[b])
+      {
+        continue;
+      }
+
+      r = Simulate(&s_profiles[p], s_bauds[b], (long long)(seconds * SEC), seed);
+      totalDesyncs += r.m_desyncs;
+
+      printf("%-8s %7d %8.0f %8.2f %8.2f %8.1f %7.1f %7lld %6lld %6lld %6lld %6.2f %7.1f %6.1f\n",
+             s_profiles[p].m_name, s_bauds[b], r.m_bootMs, r.m_ticks, r.m_waitMs,
+             r.m_waitMaxMs, r.m_stall, r.m_frames, r.m_games, r.m_aborts, r.m_desyncs,
+             r.m_air, r.m_rxRate, r.m_idle);
+      if(s_dropNs > 0)
+      {
+        printf("         rejoin: drops %lld  rejoined %lld  mean %.0f ms  snapshot %.0f B  "
+               "join to load %.0f ms\n", r.m_drops, r.m_rejoins, r.m_rejoinMs,
+               r.m_snapshotBytes, r.m_snapshotMs);
+      }
+      fflush(stdout);
+    }
+  }
+
+  rmdir(s_tmpDir);
+
+  return (failOnDesync && totalDesyncs > 0) ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * SimHost.h
+ *
+ * Interface between the network simulator (NetSim.c) and one copy of the
+ * firmware built for Linux (SimPlatform.c and the game sources).
+ *
+ * Every board runs its own copy of the firmware shared library so that each
+ * has its own s_GameInstance, receive buffer and LCD VRAM.  The simulator
+ * drives the copies as coroutines on a single virtual clock (nanoseconds):
+ * a board runs until it blocks in Sleep() or has spent enough CPU time,
+ * then the board with the earliest clock runs next.
+ */
+
+#ifndef SIMHOST_H
+#define SIMHOST_H
+
+typedef struct SimHost_
+{
+   void*      m_context;
+
+   void       (*m_spend)(void* context, long long ns);     // CPU busy time
+   void       (*m_sleep)(void* context, long long ns);     // Block, other boards run
+   long long  (*m_now)(void* context);                     // Virtual time - ns
+
+   long long  (*m_transmit)(void* context, int ch);        // UART Tx, returns ns blocked
+   void       (*m_setBaud)(void* context, int baud);       // USART line speed
+
+   int        (*m_key)(void* context);                     // Keypad, -1 if none
+
+   void       (*m_frame)(void* context);                   // After each UpdateGame()
+   void       (*m_netWait)(void* context, long long ns);   // Time in UpdateNetwork()
+} SimHost;
+
+// ------ Exported by each firmware copy (looked up with dlsym)
+typedef void  (*SimAttachFn)(const SimHost* pHost);
+typedef void  (*SimMainFn)(void);
+typedef void  (*SimReceiveFn)(const char* pData, int size);
+typedef void* (*SimGameFn)(void);
+typedef char  (*SimCollisionFn)(const void* pGame, const unsigned char* testPos);
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * SimPlatform.c
+ *
+ * The board interface (hal.h) on the simulator's virtual clock, with
+ * replacements for Delay.c and keypad.c, so that the game sources -
+ * main.c, GameCore.c, timer.c, uart.c, XBee.c, pg12864.c, Sound.c - run
+ * unmodified inside the network simulator.
+ *
+ * Time is virtual.  Busy waits and GPIO writes charge the board CPU time,
+ * idle waits block the board so the others can run, and UART transmission
+ * blocks for as long as the USART holding register stays full.  Received
+ * bytes are fed through UartRxrdy() exactly as the RXRDY interrupt would.
+ *
+ * TimerBeat() is called for every heartbeat the virtual clock has passed
+ * each time the board's time advances, so the millisecond clock and the
+ * software timers in timer.c run as they would from the TC0 interrupt.
+ *
+ * Two entry points are wrapped at link time (-Wl,--wrap) to report frames
+ * and the time spent in UpdateNetwork() back to the simulator.  Idle mode
+ * blocks the board until its next timer interrupt, so the others run.
+ */
+
+#include "config.h"
+#include "timer.h"
+#include "uart.h"
+#include "Delay.h"
+#include "AT91PIO.h"
+#include "keypad.h"
+#include "GameHeader.h"
+#include "SimHost.h"
+
+/* CPU cost of one GPIO write through OutputHigh()/OutputLow() - ns */
+#define SIM_GPIO_NS   150
+
+static SimHost   s_host;
+static int       s_rxByte;
+static long long s_nextBeat = 1000000000LL / TIMER_HZ;
+static void      (*s_soundIrq)();
+static long long s_soundPeriod;      /* 0 while the sound timer is stopped */
+static long long s_nextSound;
+static int       s_inIrq;
+
+void SimFirmwareMain(void);
+void __real_UpdateGame(void);
+void __real_UpdateNetwork(void);
+
+//----------------------------------------------------------------
+// Virtual time - heartbeats are delivered as the clock passes them
+
+static void SimCatchUp(void)
+{
+  if(s_inIrq)
+  {
+    return;
+  }
+  s_inIrq = 1;
+
+  for(;;)
+  {
+    long long now = s_host.m_now(s_host.m_context);
+
+    if(s_soundPeriod > 0 && s_nextSound <= now && s_nextSound < s_nextBeat)
+    {
+      s_nextSound += s_soundPeriod;
+      (*s_soundIrq)();
+    }
+    else if(s_nextBeat <= now)
+    {
+      s_nextBeat += 1000000000LL / TIMER_HZ;
+      TimerBeat();
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  s_inIrq = 0;
+}
+
+// Interrupt handlers are charged too, but do not nest
+static void SimSpend(long long ns)
+{
+  s_host.m_spend(s_host.m_context, ns);
+  SimCatchUp();
+}
+
+//----------------------------------------------------------------
+// Simulator entry points
+
+void SimAttach(const SimHost* pHost)
+{
+  s_host = *pHost;
+}
+
+void SimMain(void)
+{
+  SimFirmwareMain();
+}
+
+void SimReceive(const char* pData, int size)
+{
+  int i;
+  for(i = 0; i < size; ++i)
+  {
+    s_rxByte = (unsigned char)pData[i];
+    UartRxrdy();
+  }
+}
+
+void* SimGame(void)
+{
+  return &s_GameInstance;
+}
+
+//----------------------------------------------------------------
+// Link-time wrappers around the main loop phases
+
+void __wrap_UpdateGame(void)
+{
+  __real_UpdateGame();
+  s_host.m_frame(s_host.m_context);
+}
+
+void __wrap_UpdateNetwork(void)
+{
+  long long start = s_host.m_now(s_host.m_context);
+  __real_UpdateNetwork();
+  s_host.m_netWait(s_host.m_context, s_host.m_now(s_host.m_context) - start);
+}
+
+//----------------------------------------------------------------
+// hal.h - interrupt masking is meaningless here: heartbeats and received
+// bytes are only delivered while the board spends time or is blocked
+
+void HalDisableInterrupts(void) {}
+void HalEnableInterrupts(void) {}
+int HalSaveInterrupts(void) { return 0; }
+void HalRestoreInterrupts(int masked) {}
+
+//----------------------------------------------------------------
+// Delay.c
+
+void Delay_us(int period)
+{
+  SimSpend(period * 1000LL);
+}
+
+void Delay_ms(int period)
+{
+  SimSpend(period * 1000000LL);
+}
+
+// Virtual delays are exact
+int Delay_error(int period)
+{
+  return 0;
+}
+
+//----------------------------------------------------------------
+// at91.c
+
+void AT91InitInterrupt(void(*timer_func)(), void(*rxrdy_func)()) {}
+
+// Idle mode - block the board until its next timer interrupt.  Received
+// bytes are delivered when it next runs, so they wake it at the
+// heartbeat rather than at once.
+void AT91Idle()
+{
+  long long now = s_host.m_now(s_host.m_context);
+  long long wake = s_nextBeat;
+
+  if(s_soundPeriod > 0 && s_nextSound < wake)
+  {
+    wake = s_nextSound;
+  }
+  if(wake > now)
+  {
+    s_host.m_sleep(s_host.m_context, wake - now);
+  }
+  SimCatchUp();
+}
+void AT91InitTimer() {}
+void AT91StartTimer() {}
+
+// The counter within the current heartbeat, from the virtual clock.  Every
+// beat passed has been delivered, so none is ever pending.
+unsigned int AT91TimerCount()
+{
+  long long beat = 1000000000LL / TIMER_HZ;
+  long long now = s_host.m_now(s_host.m_context);
+
+  return (unsigned int)((now % beat) * AT91_TIMER_RC / beat);
+}
+
+int AT91TimerPending()
+{
+  return 0;
+}
+
+void AT91InitSoundTimer(void(*sound_func)())
+{
+  s_soundIrq = sound_func;
+}
+
+void AT91SoundTimerPeriod(unsigned int us)
+{
+  s_soundPeriod = us * 1000LL;
+}
+
+void AT91SoundTimerStart(unsigned int us)
+{
+  AT91SoundTimerPeriod(us);
+  s_nextSound = s_host.m_now(s_host.m_context) + s_soundPeriod;
+}
+
+void AT91SoundTimerStop()
+{
+  s_soundPeriod = 0;
+}
+
+// Waveform mode - one interrupt when the tone or the silence ends
+void AT91SoundWaveTone(unsigned int halfUs, unsigned int periods)
+{
+  AT91SoundTimerStart(2 * halfUs * periods);
+}
+
+void AT91SoundWaveRest(unsigned int ms)
+{
+  AT91SoundTimerStart(ms * 1000);
+}
+void AT91UartInit() {}
+
+void AT91UartSetBaud(int baud)
+{
+  s_host.m_setBaud(s_host.m_context, baud);
+}
+
+int AT91UartGetchar()
+{
+  return s_rxByte;
+}
+
+void AT91UartPutchar(int ch)
+{
+  SimSpend(s_host.m_transmit(s_host.m_context, ch));
+}
+
+//----------------------------------------------------------------
+// AT91PIO.c
+
+void OutputLow(unsigned long bit)
+{
+  SimSpend(SIM_GPIO_NS);
+}
+
+void OutputHigh(unsigned long bit)
+{
+  SimSpend(SIM_GPIO_NS);
+}
+
+void AT91InitialisePIO() {}
+
+unsigned long AT91ReadPins() { return ~0UL; }
+
+//----------------------------------------------------------------
+// keypad.c
+
+void keyInit(void) {}
+void keyScan(void) {}
+
+// The harness decides presses as they are asked for - no debounce, and
+// nothing is queued
+int keyPoll(void)
+{
+  return s_host.m_key(s_host.m_context);
+}
+
+int keyEvent(KeyEvent* pEvent)
+{
+  int key = keyPoll();
+
+  if(key == -1)
+  {
+    return 0;
+  }
+  pEvent->time = TimerNow();
+  pEvent->key = (char)key;
+  pEvent->pressed = 1;
+  return 1;
+}
+
+// main() first looks for a key held through reset (the delay self-test).
+// None is, and the host only starts answering from the lobby, where it
+// times the boot.  After that a key the host presses counts as held.
+int keyHeld(void)
+{
+  static int s_booted = 0;
+
+  if(!s_booted)
+  {
+    s_booted = 1;
+    return -1;
+  }
+
+  return keyPoll();
+}
+
+int keyIsDown(int key)
+{
+  return keyHeld() == key;
+}
+
+unsigned long keyDropped(void)
+{
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include "config.h"
+#include "timer.h"
+#include "uart.h"
+#include "keypad.h"
+#include "Sound.h"
+#include "Test.h"
+
+static int s_checks;
+static int s_failures;
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// One Check - failures are reported as they happen
+void TestCheck(int ok, const char* pText, const char* pFile, int line)
+{
+  s_checks++;
+  if(!ok)
+  {
+    s_failures++;
+    printf("%s:%d: FAILED: %s\n", pFile, line, pText);
+  }
+}
+
+//----------------------------------------------------------------
+// Bring up the Board as main() does - without the LCD and the XBee
+void TestBoot()
+{
+  AT91InitialisePIO();
+  keyInit();
+  UartInit(AT91UartGetchar, AT91UartPutchar, AT91UartSetBaud);
+
+  HalDisableInterrupts();
+  AT91InitInterrupt(TimerBeat, UartRxrdy);
+  AT91InitTimer();
+  AT91UartInit();
+  HalEnableInterrupts();
+
+  AT91StartTimer();
+  soundInit();
+}
+
+//----------------------------------------------------------------
+// Summary and Exit Status
+int TestResult()
+{
+  printf("%d checks, %d failed\n", s_checks, s_failures);
+  return s_failures > 0;
+}
@@ -0,0 +1,12 @@
+//
+// Test.h
+//
+// Checks for the native test programs - firmware sources on hal_linux.c
+//
+
+#define CHECK(cond) TestCheck((cond) != 0, #cond, __FILE__, __LINE__)
+
+// ------ Functions
+void TestCheck(int ok, const char* pText, const char* pFile, int line);
+void TestBoot();
+int TestResult();
@@ -0,0 +1,540 @@
+//
+// TestGame.c
+//
+// Game logic off the board - collision sweeps, screen changes, the
+// camera, the CPU player, random numbers, snapshots, the message stream
+// and the sound queue
+//
+
+#include "GameHeader.h"
+#include <string.h>
+#include "config.h"
+#include "timer.h"
+#include "uart.h"
+#include "Sound.h"
+#include "NetStats.h"
+#include "CpuPlayer.h"
+#include "pg12864.h"
+#include "Camera.h"
+#include "Snapshot.h"
+#include "Test.h"
+
+//----------------------------------------------------------------
+// Borders, heads and tails are hits; free cells are not
+static void TestCollision()
+{
+  unsigned char free[2]   = { 60, 30 };
+  unsigned char left[2]   = { PLAY_OFFSETX - 1, 30 };
+  unsigned char bottom[2] = { 60, PLAY_OFFSETY + WORLD_HEIGHT + 1 };
+  unsigned char head[2]   = { 20, 20 };
+  unsigned char tail[2]   = { 21, 20 };
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  SnakeStart(&s_GameInstance, 0, 21, 20, WEST, 1);
+  SnakeStart(&s_GameInstance, 1, 100, 40, WEST, 0);
+  MoveSnake(&s_GameInstance, 0);
+
+  CHECK(CollisionSweep(&s_GameInstance, free) == FALSE);
+  CHECK(CollisionSweep(&s_GameInstance, left) == TRUE);
+  CHECK(CollisionSweep(&s_GameInstance, bottom) == TRUE);
+  CHECK(CollisionSweep(&s_GameInstance, head) == TRUE);
+  CHECK(CollisionSweep(&s_GameInstance, tail) == TRUE);
+}
+
+//----------------------------------------------------------------
+// A body walked round the ring many times still leads from the head to
+// the tail, and only its squares are in the occupancy map
+static void TestBody()
+{
+  const SnakeData* pSnake = &s_GameInstance.m_snakes[0];
+  unsigned char    pos[2];
+  int              occupied = 0;
+  int              i;
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  SnakeStart(&s_GameInstance, 0, 30, 20, EAST, 30);
+
+  // Round a 40 square loop
+  for(i = 0; i < 3 * BODY_RING; ++i)
+  {
+    s_GameInstance.m_snakes[0].m_dir = (unsigned char)(i / 10 % 4 + 1);
+    MoveSnake(&s_GameInstance, 0);
+  }
+  CHECK(pSnake->m_grow == 0 && SNAKE_LAID(pSnake) == 30);
+
+  pos[X] = pSnake->m_head[X];
+  pos[Y] = pSnake->m_head[Y];
+  for(i = 0; i < SNAKE_LAID(pSnake); ++i)
+  {
+    UpdatePos(pos, BodyDir(pSnake, i));
+  }
+  CHECK(ComparePositions(pos, pSnake->m_tail) == TRUE);
+
+  for(i = 0; i < (int)sizeof(s_GameInstance.m_occupied) * 8; ++i)
+  {
+    occupied += (s_GameInstance.m_occupied[i >> 3] >> (i & 7)) & 1;
+  }
+  CHECK(occupied == 1 + SNAKE_LAID(pSnake));
+  CHECK(CollisionSweep(&s_GameInstance, pSnake->m_tail) == TRUE);
+  CHECK(CollisionSweep(&s_GameInstance, pSnake->m_freed) == FALSE);
+}
+
+//----------------------------------------------------------------
+// A tick leaves its heads, the eaten pickup and the score as changes;
+// drawing them sends a few bytes, not the screen, and empties the list
+static void TestChanges()
+{
+  unsigned char oldPickup[2];
+  unsigned char oldValue;
+  unsigned long before;
+  unsigned long after;
+  unsigned long commands;
+  int           counts[CHANGE_SCORE + 1] = { 0 };
+  int           winner;
+  int           i;
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  s_GameInstance.m_randSeed = 7;
+  GameSetup(&s_GameInstance);
+  CHECK(s_GameInstance.m_numChanges == 0);
+  RedrawFullGame();
+  UpdateScreen();
+
+  // Snake 0 eats a pickup in front of it
+  s_GameInstance.m_pickupPos[X] = (unsigned char)(s_GameInstance.m_snakes[0].m_head[X] + 1);
+  s_GameInstance.m_pickupPos[Y] = s_GameInstance.m_snakes[0].m_head[Y];
+  oldPickup[X] = s_GameInstance.m_pickupPos[X];
+  oldPickup[Y] = s_GameInstance.m_pickupPos[Y];
+  oldValue     = s_GameInstance.m_pickupValue;
+
+  CHECK((GameStep(&s_GameInstance, &winner) & EVENT_EATEN) != 0);
+  CHECK(s_GameInstance.m_numChanges <= GAME_CHANGES);
+  for(i = 0; i < s_GameInstance.m_numChanges; ++i)
+  {
+    const GameChange* pChange = &s_GameInstance.m_changes[i];
+
+    counts[pChange->m_type]++;
+    if(pChange->m_type == CHANGE_PICKUP)
+    {
+      CHECK(ComparePositions(pChange->m_pos, oldPickup) == TRUE && pChange->m_value == oldValue);
+    }
+  }
+  CHECK(counts[CHANGE_HEAD] == 2 && counts[CHANGE_FREED] == 0);
+  CHECK(counts[CHANGE_PICKUP] == 1 && counts[CHANGE_SCORE] == 1);
+
+  LCD_GetCounters(&before, &commands);
+  UpdateScreen();
+  LCD_GetCounters(&after, &commands);
+  CHECK(s_GameInstance.m_numChanges == 0);
+  CHECK(after - before < 64);
+
+  // More than the list holds - counted past it for a full redraw
+  for(i = 0; i < GAME_CHANGES; ++i)
+  {
+    MoveSnake(&s_GameInstance, 1);
+  }
+  CHECK(s_GameInstance.m_numChanges == GAME_CHANGES + 1);
+  UpdateScreen();
+  CHECK(s_GameInstance.m_numChanges == 0);
+}
+
+//----------------------------------------------------------------
+// The camera shows the squares round the local head, and a scroll steps
+// over to it, holding at each step until the step is sent - no tick
+// sending more than CAMERA_BYTES
+static void TestCamera()
+{
+  const unsigned char* pHead  = s_GameInstance.m_snakes[1].m_head;
+  unsigned char        corner[2] = { PLAY_OFFSETX, PLAY_OFFSETY };
+  unsigned char        right[2];
+  unsigned char        screen[2];
+  unsigned char        was;
+  unsigned long        before;
+  unsigned long        after;
+  unsigned long        commands;
+  unsigned long        sent;
+  int                  ticks = 0;
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  s_GameInstance.m_randSeed = 7;
+  GameSetup(&s_GameInstance);
+  CameraCentre(pHead);
+  RedrawFullGame();
+
+  CHECK(CameraToScreen(pHead, screen) == TRUE);
+  CHECK(CameraToScreen(corner, screen) == (WORLD_WIDTH == PLAY_WIDTH && WORLD_HEIGHT == PLAY_HEIGHT));
+  CHECK(CameraFollow(pHead) == FALSE && CameraScrolling() == FALSE);
+
+  // Near the right edge of the play area
+  right[X] = (unsigned char)(pHead[X] + PLAY_WIDTH / 2 - 4);
+  right[Y] = pHead[Y];
+  CHECK(CameraToScreen(right, screen) == TRUE);
+  was = screen[X];
+
+  while(CameraScrolling() || ticks == 0)
+  {
+    LCD_GetCounters(&before, &commands);
+    sent = before + commands;
+    if(CameraFollow(right))
+    {
+      // A step only once the one before is all sent
+      CHECK(CameraToScreen(right, screen) == TRUE && was - screen[X] <= CAMERA_STEP);
+      was = screen[X];
+    }
+    CameraSend(CAMERA_BYTES);
+    LCD_GetCounters(&after, &commands);
+    CHECK(after + commands - sent <= CAMERA_BYTES);
+    if(++ticks > PLAY_WIDTH * (LCD_X_MAX + 1))
+    {
+      break;
+    }
+  }
+  CHECK(CameraScrolling() == FALSE);
+
+  // The steps are all on the screen - drawing again sends nothing
+  LCD_GetCounters(&before, &commands);
+  CameraDraw();
+  LCD_GetCounters(&after, &commands);
+  CHECK(after == before);
+  CHECK((ticks > 1) == (WORLD_WIDTH > PLAY_WIDTH));
+  CHECK(CameraToScreen(right, screen) == TRUE && screen[X] < PLAY_OFFSETX + PLAY_WIDTH - 4);
+}
+
+//----------------------------------------------------------------
+// Ticks drawn as changes leave the dashed snake's gaps where a redraw of
+// the play area puts them, however the update count runs
+static void TestDashes()
+{
+  const SnakeData* pDashed;
+  unsigned long    before;
+  unsigned long    after;
+  unsigned long    commands;
+  int              winner;
+  int              i;
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  s_GameInstance.m_randSeed = 7;
+  GameSetup(&s_GameInstance);
+  pDashed = &s_GameInstance.m_snakes[s_GameInstance.m_isHost ? 1 : 0];
+  CameraCentre(s_GameInstance.m_snakes[!s_GameInstance.m_isHost].m_head);
+  RedrawFullGame();
+
+  for(i = 0; i < 40; ++i)
+  {
+    s_GameInstance.m_updateCount += 1 + i % 2;
+    CHECK((GameStep(&s_GameInstance, &winner) & EVENT_OVER) == 0);
+    UpdateScreen();
+  }
+  CHECK(SNAKE_LAID(pDashed) > 3);
+
+  LCD_GetCounters(&before, &commands);
+  CameraDraw();
+  LCD_GetCounters(&after, &commands);
+  CHECK(after == before);
+}
+
+//----------------------------------------------------------------
+// Text goes into VRAM, so pixels cleared over it reach the display
+static void TestText()
+{
+  unsigned long before;
+  unsigned long after;
+  unsigned long commands;
+  int           x;
+  int           y;
+
+  LCD_ClearDisplay();
+  LCD_PositionCursor(0, 0);
+  LCD_PutChar('#');
+
+  LCD_GetCounters(&before, &commands);
+  for(x = 0; x < 8; ++x)
+  {
+    for(y = 0; y < 8; ++y)
+    {
+      LCD_ClearPixel((unsigned char)x, (unsigned char)y);
+    }
+  }
+  LCD_GetCounters(&after, &commands);
+  CHECK(after > before);
+}
+
+//----------------------------------------------------------------
+// The CPU player against itself eats, and keeps within its tick's work
+static CpuPlayer s_cpuPlayers[2];
+
+static void TestCpu()
+{
+  SnakeGame game;
+  int       eaten  = 0;
+  int       events = 0;
+  int       winner = -1;
+  int       ticks;
+  int       i;
+
+  memset(&game, 0, sizeof(SnakeGame));
+  game.m_randSeed = 7;
+  GameSetup(&game);
+  CpuReset(&s_cpuPlayers[0]);
+  CpuReset(&s_cpuPlayers[1]);
+
+  for(ticks = 0; ticks < 2000 && !(events & EVENT_OVER); ++ticks)
+  {
+    for(i = 0; i < 2; ++i)
+    {
+      unsigned char dir = CpuDecide(&s_cpuPlayers[i], &game, i);
+
+      if(dir != NO_MOVE)
+      {
+        QueueTurn(&game.m_snakes[i], dir);
+      }
+      TakeTurn(&game.m_snakes[i]);
+    }
+    events = GameStep(&game, &winner);
+    if(events & EVENT_EATEN)
+    {
+      eaten++;
+    }
+  }
+
+  CHECK(eaten > 0);
+  for(i = 0; i < 2; ++i)
+  {
+    CHECK(s_cpuPlayers[i].m_searches > 0);
+    CHECK(s_cpuPlayers[i].m_maxNodes <= CPU_BUDGET_NODES);
+  }
+}
+
+//----------------------------------------------------------------
+// Random numbers are the seed's, frame's and draw's alone - a frame's
+// draws can be had without playing up to it, and start again each step
+static void TestRandom()
+{
+  SnakeGame game;
+  long      total = 0;
+  int       seen  = 0;
+  int       winner;
+  int       i;
+
+  memset(&game, 0, sizeof(SnakeGame));
+  game.m_randSeed = 7;
+  GameSetup(&game);
+  CHECK(game.m_randFrame == 0 && game.m_randDraw >= 2);
+
+  GameStep(&game, &winner);
+  CHECK(game.m_randFrame == 1);
+  for(i = 0; i < 4; ++i)
+  {
+    CHECK(RandomNumber(&game) == RandomAt(7, 1, game.m_randDraw - 1));
+  }
+  CHECK(RandomAt(7, 1, 0) != RandomAt(8, 1, 0) || RandomAt(7, 1, 1) != RandomAt(8, 1, 1));
+
+  // Spread - the first draw of a thousand frames, then a thousand draws
+  // of one
+  for(i = 0; i < 1000; ++i)
+  {
+    int a = RandomAt(7, i, 0);
+    int b = RandomAt(7, 5, i);
+
+    total += a + b;
+    seen  |= (1 << (a >> 12)) | (1 << (b >> 12));
+  }
+  CHECK(seen == 0xFF);
+  CHECK(total / 2000 > 0x3C00 && total / 2000 < 0x4400);
+}
+
+//----------------------------------------------------------------
+// A game under way comes back the same from its snapshot, and plays on
+// the same; a damaged one loads nothing
+static SnakeGame     s_games[2];
+static unsigned char s_message[SNAPSHOT_MAX];
+
+static void TestSnapshot()
+{
+  SnakeGame* pSent   = &s_games[0];
+  SnakeGame* pLoaded = &s_games[1];
+  int        winner;
+  int        size;
+  int        i;
+
+  memset(pSent, 0, sizeof(SnakeGame));
+  pSent->m_randSeed = 11;
+  GameSetup(pSent);
+  size = SnapshotEncode(pSent, s_message);
+  CHECK(size == SNAPSHOT_MIN);
+
+  // Under way - the CPU on both snakes
+  CpuReset(&s_cpuPlayers[0]);
+  CpuReset(&s_cpuPlayers[1]);
+  for(pSent->m_updateCount = 1; pSent->m_updateCount < 400; ++pSent->m_updateCount)
+  {
+    for(i = 0; i < 2; ++i)
+    {
+      unsigned char dir = CpuDecide(&s_cpuPlayers[i], pSent, i);
+
+      if(dir != NO_MOVE)
+      {
+        QueueTurn(&pSent->m_snakes[i], dir);
+      }
+      TakeTurn(&pSent->m_snakes[i]);
+    }
+    if(GameStep(pSent, &winner) & EVENT_OVER)
+    {
+      break;
+    }
+  }
+  pSent->m_session = 0x4321;
+
+  size = SnapshotEncode(pSent, s_message);
+  CHECK(size > SNAPSHOT_MIN && size <= SNAPSHOT_MAX);
+
+  memset(pLoaded, 0, sizeof(SnakeGame));
+  CHECK(SnapshotDecode(pLoaded, s_message, size) == TRUE);
+  CHECK(pLoaded->m_updateCount == pSent->m_updateCount && pLoaded->m_session == 0x4321);
+  CHECK(pLoaded->m_randFrame == pSent->m_randFrame && pLoaded->m_pickupTime == pSent->m_pickupTime);
+  CHECK(memcmp(pLoaded->m_occupied, pSent->m_occupied, sizeof(pSent->m_occupied)) == 0);
+  CHECK(pLoaded->m_numChanges > GAME_CHANGES);
+  for(i = 0; i < 2; ++i)
+  {
+    CHECK(ComparePositions(pLoaded->m_snakes[i].m_tail, pSent->m_snakes[i].m_tail));
+    CHECK(pLoaded->m_snakes[i].m_score == pSent->m_snakes[i].m_score);
+  }
+
+  for(i = 0; i < 20; ++i)
+  {
+    GameStep(pSent, &winner);
+    GameStep(pLoaded, &winner);
+  }
+  CHECK(memcmp(pLoaded->m_occupied, pSent->m_occupied, sizeof(pSent->m_occupied)) == 0);
+  CHECK(pLoaded->m_randFrame == pSent->m_randFrame);
+
+  // One byte wrong, or cut short
+  size = SnapshotEncode(pSent, s_message);
+  pLoaded->m_updateCount = 0;
+  s_message[size / 2] ^= 0x10;
+  CHECK(SnapshotDecode(pLoaded, s_message, size) == FALSE);
+  s_message[size / 2] ^= 0x10;
+  CHECK(SnapshotDecode(pLoaded, s_message, size - 1) == FALSE);
+  CHECK(pLoaded->m_updateCount == 0);
+}
+
+//----------------------------------------------------------------
+// A client just joined waits for the whole snapshot, then plays on
+// from its frame
+static void TestRejoin()
+{
+  SnakeMove received;
+  int       size;
+
+  s_games[0].m_session = 0x4321;
+  size = SnapshotEncode(&s_games[0], s_message);
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  memset(&s_NetStats, 0, sizeof(NetStats));
+  UartFlush();
+  s_GameInstance.m_session     = 0x4321;
+  s_GameInstance.m_updateCount = 1;
+
+  HalLinuxReceive((const char*)s_message, size - 1);
+  CHECK(RecvMove(&received) == FALSE && s_GameInstance.m_updateCount == 1);
+  HalLinuxReceive((const char*)s_message + size - 1, 1);
+  CHECK(RecvMove(&received) == FALSE);
+  CHECK(s_GameInstance.m_updateCount == s_games[0].m_updateCount);
+  CHECK(s_NetStats.m_snapshotBytes == size && s_NetStats.m_rejects[REJECT_SYNC] == 0);
+
+  // Sent again - read and dropped
+  HalLinuxReceive((const char*)s_message, size);
+  s_GameInstance.m_updateCount++;
+  CHECK(RecvMove(&received) == FALSE && s_GameInstance.m_updateCount == s_games[0].m_updateCount + 1);
+  CHECK(RecvPeek((char*)s_message, 1) == 0);
+}
+
+//----------------------------------------------------------------
+// Stray bytes ahead of a message are dropped and counted, and the
+// message comes through whole
+static void TestResync()
+{
+  static const char noise[3] = { 0x00, 0x55, (char)0xFF };
+  SnakeMove sent;
+  SnakeMove received;
+
+  memset(&s_GameInstance, 0, sizeof(SnakeGame));
+  memset(&s_NetStats, 0, sizeof(NetStats));
+  UartFlush();
+
+  memset(&sent, 0, sizeof(sent));
+  sent.m_type = MSG_HOST;
+  sent.m_session = 0x1234;
+  sent.m_updateCount = 7;
+  sent.m_randHold = 0x5A5A;
+
+  HalLinuxReceive(noise, sizeof(noise));
+  CHECK(RecvMove(&received) == FALSE);
+  CHECK(s_NetStats.m_rejects[REJECT_SYNC] == sizeof(noise));
+
+  HalLinuxReceive((const char*)&sent, sizeof(sent) - 1);
+  CHECK(RecvMove(&received) == FALSE);
+  HalLinuxReceive((const char*)&sent + sizeof(sent) - 1, 1);
+  CHECK(RecvMove(&received) == TRUE);
+  CHECK(memcmp(&sent, &received, sizeof(sent)) == 0);
+}
+
+//----------------------------------------------------------------
+// Bytes sent reach the USART in order
+static void TestTransmit()
+{
+  char line[16];
+  int n;
+
+  while(HalLinuxTransmitted(line, sizeof(line)) > 0)
+  {
+  }
+
+  SendData("snake", 5);
+  n = HalLinuxTransmitted(line, sizeof(line));
+  CHECK(n == 5 && memcmp(line, "snake", 5) == 0);
+}
+
+//----------------------------------------------------------------
+// A tune plays from the sound interrupt while the caller carries on
+static void TestTune()
+{
+  static const Tone tune[] =
+  {
+    {a4, 40}, {REST, 20}, {c5, 40}, {0, 0}
+  };
+  unsigned long at = TimerNow();
+
+  playTune(tune);
+  CHECK(soundBusy() != 0);
+  CHECK(TimerNow() - at < 5);
+
+  while(soundBusy() && TimerNow() - at < 500)
+  {
+    TimerIdle();
+  }
+  at = TimerNow() - at;
+  CHECK(soundBusy() == 0);
+  CHECK(at >= 95 && at < 300);
+}
+
+int main()
+{
+  TestBoot();
+
+  TestCollision();
+  TestBody();
+  TestChanges();
+  TestCamera();
+  TestDashes();
+  TestText();
+  TestCpu();
+  TestRandom();
+  TestSnapshot();
+  TestRejoin();
+  TestResync();
+  TestTransmit();
+  TestTune();
+
+  return TestResult();
+}
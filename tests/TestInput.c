@@ -0,0 +1,140 @@
+//
+// TestInput.c
+//
+// Keypad scanning and debounce through the emulated matrix, and the turn
+// queue fed from it
+//
+
+#include "GameHeader.h"
+#include <string.h>
+#include "config.h"
+#include "timer.h"
+#include "keypad.h"
+#include "Test.h"
+
+//----------------------------------------------------------------
+// A held key is debounced into one press, and one release
+static void TestPressRelease()
+{
+  KeyEvent event;
+  unsigned long at = TimerNow();
+
+  HalLinuxKey(5);
+  Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+  CHECK(keyHeld() == 5);
+  CHECK(keyEvent(&event) == 1);
+  CHECK(event.key == 5 && event.pressed == 1);
+  CHECK((long)(event.time - at) >= 0 && event.time - at <= 2 * KEY_SCAN_MS);
+  CHECK(keyEvent(&event) == 0);
+
+  HalLinuxKey(-1);
+  Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+  CHECK(keyHeld() == -1);
+  CHECK(keyEvent(&event) == 1);
+  CHECK(event.key == 5 && event.pressed == 0);
+  CHECK(keyPoll() == -1);
+}
+
+//----------------------------------------------------------------
+// A contact shorter than the debounce time is not a press
+static void TestGlitch()
+{
+  HalLinuxKey(0x0C);
+  Sleep(KEY_DEBOUNCE_MS / 2);
+  HalLinuxKey(-1);
+  Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+
+  CHECK(keyPoll() == -1);
+  CHECK(keyHeld() == -1);
+}
+
+//----------------------------------------------------------------
+// A key held with a lower one still reads as down - cancel with a
+// direction held
+static void TestTwoKeys()
+{
+  KeyEvent event;
+
+  HalLinuxKeys((1u << 2) | (1u << 0x0C));
+  Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+  CHECK(keyHeld() == 2);
+  CHECK(keyIsDown(0x0C) == 1 && keyIsDown(2) == 1 && keyIsDown(5) == 0);
+
+  HalLinuxKeys(0);
+  Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+  CHECK(keyIsDown(0x0C) == 0);
+
+  // Their presses and releases are not wanted
+  while(keyEvent(&event) == 1)
+  {
+    continue;
+  }
+}
+
+//----------------------------------------------------------------
+// Every key of the matrix reads as itself
+static void TestMatrix()
+{
+  int key;
+  int wrong = 0;
+
+  for(key = 0; key < 16; ++key)
+  {
+    HalLinuxKey(key);
+    Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+    if(keyPoll() != key)
+    {
+      wrong++;
+    }
+    HalLinuxKey(-1);
+    Sleep(KEY_DEBOUNCE_MS + 2 * 4 * KEY_SCAN_MS);
+  }
+  CHECK(wrong == 0);
+  CHECK(keyDropped() == 0);
+}
+
+//----------------------------------------------------------------
+// Reversals, repeats and turns past a full queue are dropped
+static void TestTurnQueue()
+{
+  SnakeData snake;
+
+  memset(&snake, 0, sizeof(snake));
+  snake.m_dir = NORTH;
+
+  QueueTurn(&snake, SOUTH);
+  CHECK(snake.m_numTurns == 0);
+  QueueTurn(&snake, NORTH);
+  CHECK(snake.m_numTurns == 0);
+
+  QueueTurn(&snake, EAST);
+  QueueTurn(&snake, EAST);
+  QueueTurn(&snake, WEST);
+  QueueTurn(&snake, SOUTH);
+  QueueTurn(&snake, WEST);
+  QueueTurn(&snake, NORTH);
+  CHECK(snake.m_numTurns == TURN_QUEUE);
+
+  TakeTurn(&snake);
+  CHECK(snake.m_dir == EAST);
+  TakeTurn(&snake);
+  CHECK(snake.m_dir == SOUTH);
+  TakeTurn(&snake);
+  CHECK(snake.m_dir == WEST);
+  TakeTurn(&snake);
+  CHECK(snake.m_dir == WEST);
+  CHECK(snake.m_numTurns == 0);
+}
+
+int main()
+{
+  TestBoot();
+
+  TestPressRelease();
+  TestGlitch();
+  TestTwoKeys();
+  TestMatrix();
+  TestTurnQueue();
+
+  return TestResult();
+}
@@ -0,0 +1,143 @@
+//
+// TestTimer.c
+//
+// Heartbeat clock, software timers and Delay_us on the host clock
+//
+
+#include "config.h"
+#include "timer.h"
+#include "Delay.h"
+#include "Test.h"
+
+static void CountFiring(void* context)
+{
+  (*(int*)context)++;
+}
+
+//----------------------------------------------------------------
+// Counter reads never go back, masked or not
+static void TestMonotonic()
+{
+  unsigned long last = TimerCycles();
+  unsigned long start = TimerNow();
+  int backwards = 0;
+
+  while(TimerNow() - start < 20)
+  {
+    unsigned long now = TimerCycles();
+
+    if((long)(now - last) < 0)
+    {
+      backwards++;
+    }
+    last = now;
+  }
+  CHECK(backwards == 0);
+
+  // A beat held off by masking is counted from the pending flag.  Held
+  // off past half the next millisecond the clock stops, so masking for
+  // 400 us is as long as ends wherever in the beat it starts.
+  HalDisableInterrupts();
+  start = TimerMicros();
+  while(TimerMicros() - start < 400)
+  {
+    unsigned long now = TimerCycles();
+
+    if((long)(now - last) < 0)
+    {
+      backwards++;
+    }
+    last = now;
+  }
+  HalEnableInterrupts();
+  CHECK(backwards == 0);
+}
+
+//----------------------------------------------------------------
+// Sleep, TimerMicros and TimerCycles agree - upper limits allow for a
+// loaded host
+static void TestSleep()
+{
+  unsigned long ms = TimerNow();
+  unsigned long us = TimerMicros();
+  unsigned long cycles = TimerCycles();
+
+  Sleep(50);
+
+  ms = TimerNow() - ms;
+  us = TimerMicros() - us;
+  cycles = TimerCycles() - cycles;
+
+  CHECK(ms >= 50 && ms < 150);
+  CHECK(us >= 49000 && us < 151000);
+  CHECK(cycles / TIMER_CYCLES_PER_US >= us - 2000 && cycles / TIMER_CYCLES_PER_US <= us + 2000);
+  CHECK(TimerIdlePercent(0) > 0 && TimerIdlePercent(0) <= 100);
+}
+
+//----------------------------------------------------------------
+// One-shot and periodic timers fire on their millisecond
+static void TestSoftTimers()
+{
+  static SoftTimer once;
+  static SoftTimer every;
+  static SoftTimer stopped;
+  int onceCount = 0;
+  int everyCount = 0;
+  int stoppedCount = 0;
+  unsigned long start = TimerNow();
+  unsigned long elapsed;
+
+  TimerStart(&once, 5, 0, CountFiring, &onceCount);
+  TimerStart(&every, 10, 10, CountFiring, &everyCount);
+  TimerStart(&stopped, 5, 0, CountFiring, &stoppedCount);
+  TimerStop(&stopped);
+
+  // A loaded host may oversleep - only the clock says what was due
+  Sleep(4);
+  CHECK(onceCount == 0 || TimerNow() - start >= 5);
+  Sleep(101);
+  elapsed = TimerNow() - start;
+  TimerStop(&every);
+
+  CHECK(onceCount == 1);
+  CHECK(everyCount >= 10 && everyCount <= (int)(elapsed / 10));
+  CHECK(stoppedCount == 0);
+  CHECK(once.m_active == 0);
+
+  // The wheel's lock leaves interrupts as it found them
+  HalDisableInterrupts();
+  TimerStart(&stopped, 5, 0, CountFiring, &stoppedCount);
+  TimerStop(&stopped);
+  CHECK(HalSaveInterrupts() != 0);
+  HalEnableInterrupts();
+  CHECK(HalSaveInterrupts() == 0);
+  HalEnableInterrupts();
+}
+
+//----------------------------------------------------------------
+// Busy waits last at least as long as asked - the host may run late
+static void TestDelay()
+{
+  unsigned long us = TimerMicros();
+
+  Delay_us(500);
+  us = TimerMicros() - us;
+  CHECK(us >= 500 && us < 20000);
+
+  us = TimerMicros();
+  Delay_ms(5);
+  us = TimerMicros() - us;
+  CHECK(us >= 5000 && us < 50000);
+}
+
+int main()
+{
+  TestBoot();
+
+  TestMonotonic();
+  TestSleep();
+  TestSoftTimers();
+  TestDelay();
+
+  return TestResult();
+}
@@ -1,44 +1,288 @@
-
 /*
  * $Revision: 1.3 $
  */
 
 #include "config.h"
 #include "timer.h"
+#include "keypad.h"
+
+static volatile unsigned long beats = 0; // Free running, never reset.
+static volatile unsigned long now_ms = 0; // Free running, never reset.
+static int sub_ms = 0;
 
-static volatile int ms_ctr = 0;
-static volatile int tick = 0;
+// Timer wheel - a timer waits in slot (expiry % TIMER_WHEEL_SLOTS) and is
+// examined once per revolution until its expiry comes round.
+static SoftTimer* wheel[TIMER_WHEEL_SLOTS];
+static int in_beat = 0;
 
-extern int test_number;
+// Idle accounting - per state set by TimerIdleState().  Idle time is
+// counted in ms, so a state runs for ~49 days before it wraps; the part
+// of a millisecond left over waits in idle_us.
+static unsigned long idle_ms[IDLE_STATES];
+static unsigned long idle_us = 0;
+static unsigned long state_ms[IDLE_STATES];
+static unsigned long state_since = 0;
+static int idle_state = 0;
 
 static void ProcessInput(void);
+static void RunWheel(void);
 
 
-void TimerBeat(void)
+RAMFUNC void TimerBeat(void)
 {
-  // Called at 1000 Hz rate.
-  ms_ctr++; // Sleep counter.
-  tick++; // Button debounce counter.
-  ProcessInput(); // Check buttons.
+  // Called at TIMER_HZ rate - 1000 Hz.
+  beats++; // Timestamp counter.
+
+  if (++sub_ms >= TIMER_HZ / 1000)
+  {
+    sub_ms = 0;
+    now_ms++; // Millisecond clock.
+    RunWheel(); // Software timers due this millisecond.
+  }
+
+  ProcessInput(); // Scan the keypad.
 //  SND_Callback(); // Sound callback for good use.
  
 }
 
 
+// Idle wait - the core sleeps between heartbeats.  The clock is never
+// reset, so waits may nest - an interrupt or a caller timing its own
+// deadline is not disturbed.
 void Sleep(int milliseconds)
 {
-  ms_ctr = 0;
-  while (ms_ctr < milliseconds) ;
+  unsigned long start = now_ms;
+  while ((long)(now_ms - start) < milliseconds)
+    TimerIdle();
 }
 
 
-static void ProcessInput(void)
+// Stop the core until the next interrupt - the heartbeat, a UART byte or
+// the sound timer - and count the time towards the idle figure.  Call it
+// in a loop that checks what it waits for; an event landing between the
+// check and the call is seen at the next heartbeat, at most 1 ms late.
+void TimerIdle(void)
+{
+  unsigned long start = TimerMicros();
+
+  AT91Idle();
+  idle_us += TimerMicros() - start;
+  idle_ms[idle_state] += idle_us / 1000;
+  idle_us %= 1000;
+}
+
+
+// Account idle time to a state from now on - the game state, say.
+void TimerIdleState(int state)
 {
-  /* Scan buttons with 50 ms interval     */
-  if (tick >= 50)       
+  unsigned long now = now_ms;
+
+  if (state == idle_state || state < 0 || state >= IDLE_STATES)
+    return;
+
+  state_ms[idle_state] += now - state_since;
+  state_since = now;
+  idle_state = state;
+}
+
+
+// Percentage of the time spent in a state that the core was idle.
+int TimerIdlePercent(int state)
+{
+  unsigned long ms = state_ms[state];
+
+  if (state == idle_state)
+    ms += now_ms - state_since;
+  if (ms == 0)
+    return 0;
+
+  // Scaled so idle_ms * 100 cannot overflow - past 1000 s the state's
+  // time is divided down instead.
+  if (ms >= 1000000)
+    return (int)(idle_ms[state] / (ms / 100));
+  return (int)(idle_ms[state] * 100 / ms);
+}
+
+
+// Read the millisecond clock and the timer/counter together.  Retries if
+// the heartbeat runs in between; an RC compare whose interrupt is still
+// pending (masked, or a higher priority handler running) has wrapped the
+// counter, so its millisecond is counted here.  The heartbeat must not be
+// held off for a whole millisecond or the time goes back.
+static unsigned int ReadClock(unsigned long* pMs)
+{
+  unsigned long ms;
+  unsigned int count;
+  int pending;
+
+  do
   {
-//     ButtonScan();
-     tick = 0;
+    ms = now_ms;
+    count = AT91TimerCount();
+    pending = AT91TimerPending();
+  } while (ms != now_ms);
+
+  if (pending && count < AT91_TIMER_RC / 2)
+    ms++;
+
+  *pMs = ms;
+  return count;
+}
+
+
+// Timer/counter cycles since start - TIMER_CYCLES_PER_US per us.  Wraps
+// after ~130 s, so compare by difference.
+unsigned long TimerCycles(void)
+{
+  unsigned long ms;
+  unsigned int count = ReadClock(&ms);
+
+  return ms * AT91_TIMER_RC + count;
+}
+
+
+// Microseconds since start - wraps after ~71 minutes, so compare by
+// difference.
+unsigned long TimerMicros(void)
+{
+  unsigned long ms;
+  unsigned int count = ReadClock(&ms);
+
+  return ms * 1000 + count / TIMER_CYCLES_PER_US;
+}
+
+
+// Heartbeats since start - TIMER_HZ per second, wraps after ~49 days.
+unsigned long TimerTicks(void)
+{
+  return beats;
+}
+
+
+// Milliseconds since start - wraps after ~49 days, so compare times by
+// difference: (long)(TimerNow() - deadline) >= 0 once a deadline passes.
+RAMFUNC unsigned long TimerNow(void)
+{
+  return now_ms;
+}
+
+
+// Wheel lists are shared with TimerBeat() - lock them unless called from
+// a timer callback, which already runs inside the interrupt.  Unlocking
+// puts the interrupt mask back as the lock found it, so a caller that had
+// masked interrupts itself keeps them masked.
+static int WheelLock(void)
+{
+  if (in_beat)
+    return 1;
+  return HalSaveInterrupts();
+}
+
+static void WheelUnlock(int masked)
+{
+  HalRestoreInterrupts(masked);
+}
+
+static void WheelInsert(SoftTimer* pTimer)
+{
+  SoftTimer** pSlot = &wheel[pTimer->m_expires % TIMER_WHEEL_SLOTS];
+
+  pTimer->m_next = *pSlot;
+  *pSlot = pTimer;
+}
+
+static void WheelRemove(SoftTimer* pTimer)
+{
+  SoftTimer** pLink = &wheel[pTimer->m_expires % TIMER_WHEEL_SLOTS];
+
+  while (*pLink != 0)
+  {
+    if (*pLink == pTimer)
+    {
+      *pLink = pTimer->m_next;
+      break;
+    }
+    pLink = &(*pLink)->m_next;
+  }
+}
+
+
+// Start, or restart, a software timer.  The callback runs from TimerBeat()
+// - in interrupt context, so it must be short - delay ms from now and then
+// every period ms, or once if period is 0.  The SoftTimer is owned by the
+// caller, zeroed before first use (static storage is), and must stay in
+// place until it has fired or been stopped.
+void TimerStart(SoftTimer* pTimer, unsigned long delay, unsigned long period,
+                TimerCallback callback, void* context)
+{
+  int masked = WheelLock();
+
+  if (pTimer->m_active)
+    WheelRemove(pTimer);
+
+  pTimer->m_expires = now_ms + (delay ? delay : 1);
+  pTimer->m_period = period;
+  pTimer->m_callback = callback;
+  pTimer->m_context = context;
+  pTimer->m_active = 1;
+  WheelInsert(pTimer);
+
+  WheelUnlock(masked);
+}
+
+
+// Stop a software timer.  Safe to call on a timer that has already fired
+// or was never started.
+void TimerStop(SoftTimer* pTimer)
+{
+  int masked = WheelLock();
+
+  if (pTimer->m_active)
+    WheelRemove(pTimer);
+  pTimer->m_active = 0;
+
+  WheelUnlock(masked);
+}
+
+
+// Fire the timers due now.  The slot is searched again from its head after
+// each callback, so callbacks may start or stop any timer, this one
+// included.  A restarted timer is due at least 1 ms later and so is not
+// found again in this pass.
+static void RunWheel(void)
+{
+  SoftTimer* pTimer;
+
+  in_beat = 1;
+
+  for (;;)
+  {
+    pTimer = wheel[now_ms % TIMER_WHEEL_SLOTS];
+    while (pTimer != 0 && pTimer->m_expires != now_ms)
+      pTimer = pTimer->m_next; // Due on a later revolution.
+    if (pTimer == 0)
+      break;
+
+    WheelRemove(pTimer);
+    if (pTimer->m_period)
+    {
+      pTimer->m_expires += pTimer->m_period;
+      WheelInsert(pTimer);
+    }
+    else
+    {
+      pTimer->m_active = 0;
+    }
+
+    (*pTimer->m_callback)(pTimer->m_context);
   }
+
+  in_beat = 0;
 }
 
+
+static void ProcessInput(void)
+{
+  /* One keypad row per heartbeat - the matrix every 4 ms */
+  keyScan();
+}
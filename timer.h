@@ -3,5 +3,41 @@
  * $Revision: 1.3 $
  */
 
+// Heartbeat rate set by RC in AT91InitTimer() - one per millisecond, the
+// period TimerCycles() reads the counter against.
+#define TIMER_HZ 1000
+
+// Timer/counter 0 clock - MCK/2 - in cycles per microsecond.
+#define TIMER_CYCLES_PER_US (AT91_TIMER_RC / 1000)
+
+// Software timer wheel - slots, one per ms.  Power of two.
+#define TIMER_WHEEL_SLOTS 32
+
+// States the idle time is split between - see TimerIdleState().
+#define IDLE_STATES 4
+
+typedef void (*TimerCallback)(void* context);
+
+typedef struct SoftTimer_
+{
+  struct SoftTimer_* m_next;
+  unsigned long      m_expires;   // TimerNow() at which it fires
+  unsigned long      m_period;    // ms between firings, 0 for one-shot
+  TimerCallback      m_callback;
+  void*              m_context;
+  char               m_active;    // Waiting in the wheel
+} SoftTimer;
+
 void TimerBeat(void);
 void Sleep(int milliseconds);
+void TimerIdle(void);
+void TimerIdleState(int state);
+int TimerIdlePercent(int state);
+unsigned long TimerTicks(void);
+unsigned long TimerNow(void);
+unsigned long TimerCycles(void);
+unsigned long TimerMicros(void);
+
+void TimerStart(SoftTimer* pTimer, unsigned long delay, unsigned long period,
+                TimerCallback callback, void* context);
+void TimerStop(SoftTimer* pTimer);
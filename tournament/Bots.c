@@ -0,0 +1,168 @@
+#include "GameHeader.h"
+#include "Bots.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Chance in 100 that the random bot turns when it need not
+#define RANDOM_TURN 	10
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Bot's Random Number - 0..0x7fff
+static int BotRandom(unsigned long* pRng)
+{
+  *pRng = *pRng * 1103515245UL + 12345UL;
+  return (int)((*pRng >> 16) & 0x7fff);
+}
+
+//----------------------------------------------------------------
+// Turn Left or Right of a Direction
+static unsigned char TurnLeft(unsigned char dir)
+{
+  return (unsigned char)((dir + 2) % 4 + 1);
+}
+
+static unsigned char TurnRight(unsigned char dir)
+{
+  return (unsigned char)(dir % 4 + 1);
+}
+
+//----------------------------------------------------------------
+// Would a Move live through the next Tick
+static char Safe(const SnakeGame* pGame, int iPlay, unsigned char dir)
+{
+  unsigned char pos[2] =
+  {
+    pGame->m_snakes[iPlay].m_head[X],
+    pGame->m_snakes[iPlay].m_head[Y]
+  };
+
+  UpdatePos(pos, dir);
+  return CollisionSweep(pGame, pos) == FALSE;
+}
+
+//----------------------------------------------------------------
+// Safe Moves - ahead, left, right.  Returns the count.
+static int SafeMoves(const SnakeGame* pGame, int iPlay, unsigned char* pMoves)
+{
+  unsigned char dir = pGame->m_snakes[iPlay].m_dir;
+  unsigned char options[3] = { dir, TurnLeft(dir), TurnRight(dir) };
+  int count = 0;
+  int i;
+
+  for(i = 0; i < 3; ++i)
+  {
+    if(Safe(pGame, iPlay, options[i]))
+    {
+      pMoves[count++] = options[i];
+    }
+  }
+  return count;
+}
+
+//----------------------------------------------------------------
+// Random - wanders, turning now and then, never into a crash it can see
+static unsigned char BotWander(const SnakeGame* pGame, int iPlay, BotState* pState)
+{
+  unsigned char moves[3];
+  int count = SafeMoves(pGame, iPlay, moves);
+
+  if(count == 0)
+  {
+    return NO_MOVE;
+  }
+  if(moves[0] == pGame->m_snakes[iPlay].m_dir && BotRandom(&pState->m_rng) % 100 >= RANDOM_TURN)
+  {
+    return moves[0];
+  }
+  return moves[BotRandom(&pState->m_rng) % count];
+}
+
+//----------------------------------------------------------------
+// Greedy - the safe move that closes most on the pickup, ahead on a tie
+static unsigned char BotGreedy(const SnakeGame* pGame, int iPlay, BotState* pState)
+{
+  unsigned char moves[3];
+  int count = SafeMoves(pGame, iPlay, moves);
+  int best = -1;
+  int bestDistance = 0;
+  int i;
+
+  (void)pState;                      // Greedy keeps no state
+
+  for(i = 0; i < count; ++i)
+  {
+    unsigned char pos[2] =
+    {
+      pGame->m_snakes[iPlay].m_head[X],
+      pGame->m_snakes[iPlay].m_head[Y]
+    };
+    int distance;
+
+    UpdatePos(pos, moves[i]);
+    distance = abs(pos[X] - pGame->m_pickupPos[X]) + abs(pos[Y] - pGame->m_pickupPos[Y]);
+    if(best < 0 || distance < bestDistance)
+    {
+      best = i;
+      bestDistance = distance;
+    }
+  }
+
+  return best < 0 ? NO_MOVE : moves[best];
+}
+
+//----------------------------------------------------------------
+// Straight - carries on until blocked, then turns whichever way is safe
+static unsigned char BotStraight(const SnakeGame* pGame, int iPlay, BotState* pState)
+{
+  unsigned char moves[3];
+  int count = SafeMoves(pGame, iPlay, moves);
+
+  if(count == 0 || moves[0] == pGame->m_snakes[iPlay].m_dir)
+  {
+    return NO_MOVE;
+  }
+  return moves[BotRandom(&pState->m_rng) % count];
+}
+
+//----------------------------------------------------------------
+// CPU - the board's single-player opponent (CpuPlayer.c)
+static unsigned char BotCpu(const SnakeGame* pGame, int iPlay, BotState* pState)
+{
+  return CpuDecide(&pState->m_cpu, pGame, iPlay);
+}
+
+static const Bot s_bots[] =
+{
+  { "random",   "wanders, turning 1 tick in 10, avoiding crashes",   BotWander },
+  { "greedy",   "heads for the pickup, avoiding crashes",            BotGreedy },
+  { "straight", "turns only when about to crash",                    BotStraight },
+  { "cpu",      "the board's CPU opponent - searches to the pickup", BotCpu },
+};
+
+//----------------------------------------------------------------
+// Look up a Bot by Name - NULL if none
+const Bot* BotFind(const char* name)
+{
+  int i;
+
+  for(i = 0; i < BotCount(); ++i)
+  {
+    if(strcmp(s_bots[i].m_name, name) == 0)
+    {
+      return &s_bots[i];
+    }
+  }
+  return NULL;
+}
+
+const Bot* BotAt(int i)
+{
+  return &s_bots[i];
+}
+
+int BotCount(void)
+{
+  return (int)(sizeof(s_bots) / sizeof(s_bots[0]));
+}
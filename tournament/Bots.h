@@ -0,0 +1,32 @@
+//
+// Bots.h
+//
+// Bot policies for headless games - include GameHeader.h first
+//
+// A policy is asked once per tick for its snake's direction and sees the
+// whole game.  The direction goes through QueueTurn() and TakeTurn() as a
+// key press would, so a reverse is dropped.  Each snake's policy has its
+// own state, reset and seeded per game.
+//
+
+#include "CpuPlayer.h"
+
+typedef struct BotState_
+{
+  unsigned long   m_rng;
+  CpuPlayer       m_cpu;              // The cpu bot's search
+} BotState;
+
+typedef unsigned char (*BotPolicy)(const SnakeGame* pGame, int iPlay, BotState* pState);
+
+typedef struct Bot_
+{
+  const char*     m_name;
+  const char*     m_about;            // One line for the usage message
+  BotPolicy       m_policy;
+} Bot;
+
+// ------ Functions
+const Bot* BotFind(const char* name);
+const Bot* BotAt(int i);
+int BotCount(void);
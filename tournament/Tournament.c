@@ -0,0 +1,418 @@
+//
+// Tournament.c
+//
+// Headless self-play - the game's rules (GameRules.c) played by bots on
+// every core, for balancing pickups and stress-testing the rules
+//
+//    tournament [-a bot] [-b bot] [-n games] [-j threads] [-s seed]
+//               [-m ticks] [-l]
+//
+//    -a, -b  the two bots, default greedy and random
+//    -n      games to play, default 100000
+//    -j      worker threads, default one per online core
+//    -s      base seed, default 1
+//    -m      ticks before a game is called a timeout, default 20000
+//    -l      list the bots
+//
+// Each game has its own SnakeGame, seeded from the base seed and the
+// game's number, so the results do not depend on the thread count.  The
+// bots swap sides every other game - snake 0 always moves first.
+//
+// Games are handed out by a work-stealing pool: each worker starts with
+// an equal share of the game numbers and takes GAME_CHUNK at a time from
+// the front of its own range.  A worker that runs dry steals the back
+// half of the largest range left.
+//
+// Reported: wins, draws and timeouts for each bot, mean final length and
+// score, game length in ticks, ns per tick (bots included) and games per
+// second.  Tick costs and each thread's rate are thread CPU time, so they
+// hold with more threads than cores; the overall rate is wall time.
+//
+// Exits with status 1 if any game was lost or counted twice.
+//
+
+#define _GNU_SOURCE
+#include "GameHeader.h"
+#include "Bots.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Games taken from a worker's range at a time
+#define GAME_CHUNK 	64
+
+#define MAX_WORKERS 	256
+
+typedef struct BotStats_
+{
+  long long       m_wins;
+  long long       m_length;           // Final lengths, summed
+  long long       m_score;            // Final scores, summed
+} BotStats;
+
+typedef struct Stats_
+{
+  long long       m_games;
+  long long       m_draws;
+  long long       m_timeouts;
+  long long       m_ticks;
+  long long       m_minTicks;
+  long long       m_maxTicks;
+  long long       m_ns;               // Thread CPU time playing
+  long long       m_maxTickNs;        // Worst game's mean ns per tick
+  long long       m_steals;
+  BotStats        m_bots[2];          // -a then -b, whichever side they played
+} Stats;
+
+typedef struct Worker_
+{
+  pthread_t       m_thread;
+  pthread_mutex_t m_lock;             // Guards m_next and m_end
+  long long       m_next;             // First game not yet taken
+  long long       m_end;
+  Stats           m_stats;
+} Worker;
+
+static const Bot*     s_bots[2];
+static long long      s_games = 100000;
+static unsigned long  s_seed = 1;
+static long long      s_maxTicks = 20000;
+static int            s_numWorkers;
+static Worker         s_workers[MAX_WORKERS];
+
+// ------ Functions
+
+//----------------------------------------------------------------
+// Host clock - ns
+static long long Now(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------
+// Spread a Game Number into a Seed
+static unsigned long GameSeed(long long game, unsigned long salt)
+{
+  unsigned long long x = (unsigned long long)game * 0x9E3779B97F4A7C15ULL + s_seed + salt;
+
+  x ^= x >> 31;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 29;
+  return (unsigned long)x;
+}
+
+//----------------------------------------------------------------
+// Play one Game
+static void PlayGame(long long number, Stats* pStats)
+{
+  SnakeGame      game;
+  BotState       state[2];           // About 8 KB each - the cpu bot's search
+  int            side = (int)(number & 1);   // Snake the -a bot plays
+  int            winner = -1;
+  int            events = 0;
+  long long      ticks = 0;
+  long long      start = Now(CLOCK_THREAD_CPUTIME_ID);
+  long long      ns;
+  int            i;
+
+  memset(&game, 0, sizeof(SnakeGame));
+  game.m_randSeed = (int)(GameSeed(number, 0) & 0x7fffffff);
+  for(i = 0; i < 2; ++i)
+  {
+    CpuReset(&state[i].m_cpu);
+    state[i].m_rng = GameSeed(number, 1 + i);
+  }
+  GameSetup(&game);
+
+  while(!(events & EVENT_OVER) && ticks < s_maxTicks)
+  {
+    for(i = 0; i < 2; ++i)
+    {
+      const Bot*    pBot = s_bots[i == side ? 0 : 1];
+      unsigned char dir = (*pBot->m_policy)(&game, i, &state[i]);
+
+      if(dir != NO_MOVE)
+      {
+        QueueTurn(&game.m_snakes[i], dir);
+      }
+      TakeTurn(&game.m_snakes[i]);
+    }
+
+    events = GameStep(&game, &winner);
+    ticks++;
+  }
+
+  ns = Now(CLOCK_THREAD_CPUTIME_ID) - start;
+
+  pStats->m_games++;
+  pStats->m_ticks += ticks;
+  pStats->m_ns    += ns;
+  if(pStats->m_minTicks == 0 || ticks < pStats->m_minTicks)
+  {
+    pStats->m_minTicks = ticks;
+  }
+  if(ticks > pStats->m_maxTicks)
+  {
+    pStats->m_maxTicks = ticks;
+  }
+  if(ticks > 0 && ns / ticks > pStats->m_maxTickNs)
+  {
+    pStats->m_maxTickNs = ns / ticks;
+  }
+
+  if(!(events & EVENT_OVER))
+  {
+    pStats->m_timeouts++;
+  }
+  else if(winner < 0)
+  {
+    pStats->m_draws++;
+  }
+  else
+  {
+    pStats->m_bots[winner == side ? 0 : 1].m_wins++;
+  }
+
+  for(i = 0; i < 2; ++i)
+  {
+    BotStats* pBot = &pStats->m_bots[i == side ? 0 : 1];
+
+    pBot->m_length += game.m_snakes[i].m_length;
+    pBot->m_score  += game.m_snakes[i].m_score;
+  }
+}
+
+//----------------------------------------------------------------
+// Take Games from the Front of a Worker's own Range
+static int TakeChunk(Worker* pWorker, long long* pFirst, long long* pEnd)
+{
+  int taken = FALSE;
+
+  pthread_mutex_lock(&pWorker->m_lock);
+  if(pWorker->m_next < pWorker->m_end)
+  {
+    *pFirst = pWorker->m_next;
+    *pEnd   = pWorker->m_next + GAME_CHUNK < pWorker->m_end ? pWorker->m_next + GAME_CHUNK : pWorker->m_end;
+    pWorker->m_next = *pEnd;
+    taken = TRUE;
+  }
+  pthread_mutex_unlock(&pWorker->m_lock);
+  return taken;
+}
+
+//----------------------------------------------------------------
+// Steal the Back Half of the Largest Range left
+// The sizes are read unlocked to choose; the victim is locked to split.
+static int Steal(Worker* pThief)
+{
+  for(;;)
+  {
+    Worker*   pVictim = NULL;
+    long long most = 0;
+    long long first = 0;
+    long long end = 0;
+    int       stolen = FALSE;
+    int       i;
+
+    for(i = 0; i < s_numWorkers; ++i)
+    {
+      long long left = s_workers[i].m_end - s_workers[i].m_next;
+
+      if(&s_workers[i] != pThief && left > most)
+      {
+        pVictim = &s_workers[i];
+        most = left;
+      }
+    }
+
+    if(pVictim == NULL)
+    {
+      return FALSE;
+    }
+
+    pthread_mutex_lock(&pVictim->m_lock);
+    if(pVictim->m_next < pVictim->m_end)
+    {
+      first = pVictim->m_next + (pVictim->m_end - pVictim->m_next) / 2;
+      end   = pVictim->m_end;
+      pVictim->m_end = first;
+      stolen = TRUE;
+    }
+    pthread_mutex_unlock(&pVictim->m_lock);
+
+    // Only one lock held at a time - an empty range is never a victim
+    if(stolen)
+    {
+      pthread_mutex_lock(&pThief->m_lock);
+      pThief->m_next = first;
+      pThief->m_end  = end;
+      pthread_mutex_unlock(&pThief->m_lock);
+
+      pThief->m_stats.m_steals++;
+      return TRUE;
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Worker Thread
+static void* WorkerMain(void* pArg)
+{
+  Worker*   pWorker = (Worker*)pArg;
+  long long first;
+  long long end;
+
+  for(;;)
+  {
+    if(!TakeChunk(pWorker, &first, &end) && !(Steal(pWorker) && TakeChunk(pWorker, &first, &end)))
+    {
+      return NULL;
+    }
+    while(first < end)
+    {
+      PlayGame(first++, &pWorker->m_stats);
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// Fold a Worker's Stats into the Total
+static void AddStats(Stats* pTotal, const Stats* pStats)
+{
+  int i;
+
+  pTotal->m_games    += pStats->m_games;
+  pTotal->m_draws    += pStats->m_draws;
+  pTotal->m_timeouts += pStats->m_timeouts;
+  pTotal->m_ticks    += pStats->m_ticks;
+  pTotal->m_ns       += pStats->m_ns;
+  pTotal->m_steals   += pStats->m_steals;
+  if(pStats->m_games > 0 && (pTotal->m_minTicks == 0 || pStats->m_minTicks < pTotal->m_minTicks))
+  {
+    pTotal->m_minTicks = pStats->m_minTicks;
+  }
+  if(pStats->m_maxTicks > pTotal->m_maxTicks)
+  {
+    pTotal->m_maxTicks = pStats->m_maxTicks;
+  }
+  if(pStats->m_maxTickNs > pTotal->m_maxTickNs)
+  {
+    pTotal->m_maxTickNs = pStats->m_maxTickNs;
+  }
+  for(i = 0; i < 2; ++i)
+  {
+    pTotal->m_bots[i].m_wins   += pStats->m_bots[i].m_wins;
+    pTotal->m_bots[i].m_length += pStats->m_bots[i].m_length;
+    pTotal->m_bots[i].m_score  += pStats->m_bots[i].m_score;
+  }
+}
+
+static void Usage(void)
+{
+  int i;
+
+  fprintf(stderr, "usage: tournament [-a bot] [-b bot] [-n games] [-j threads] [-s seed] [-m ticks] [-l]\n");
+  fprintf(stderr, "bots:\n");
+  for(i = 0; i < BotCount(); ++i)
+  {
+    fprintf(stderr, "    %-9s %s\n", BotAt(i)->m_name, BotAt(i)->m_about);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Stats     total;
+  long long wall;
+  double    games;
+  int       option;
+  int       i;
+
+  s_bots[0] = BotFind("greedy");
+  s_bots[1] = BotFind("random");
+  s_numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+  while((option = getopt(argc, argv, "a:b:n:j:s:m:l")) != -1)
+  {
+    switch(option)
+    {
+      case 'a': s_bots[0] = BotFind(optarg);           break;
+      case 'b': s_bots[1] = BotFind(optarg);           break;
+      case 'n': s_games = atoll(optarg);               break;
+      case 'j': s_numWorkers = atoi(optarg);           break;
+      case 's': s_seed = strtoul(optarg, NULL, 0);     break;
+      case 'm': s_maxTicks = atoll(optarg);            break;
+      case 'l': Usage();                               return 0;
+      default:  Usage();                               return 2;
+    }
+  }
+
+  if(s_bots[0] == NULL || s_bots[1] == NULL || s_games < 1 || s_maxTicks < 1)
+  {
+    Usage();
+    return 2;
+  }
+  if(s_numWorkers < 1)
+  {
+    s_numWorkers = 1;
+  }
+  if(s_numWorkers > MAX_WORKERS)
+  {
+    s_numWorkers = MAX_WORKERS;
+  }
+
+  // Equal shares to start - stealing evens out the rest
+  for(i = 0; i < s_numWorkers; ++i)
+  {
+    memset(&s_workers[i].m_stats, 0, sizeof(Stats));
+    pthread_mutex_init(&s_workers[i].m_lock, NULL);
+    s_workers[i].m_next = s_games * i / s_numWorkers;
+    s_workers[i].m_end  = s_games * (i + 1) / s_numWorkers;
+  }
+
+  wall = Now(CLOCK_MONOTONIC);
+  for(i = 0; i < s_numWorkers; ++i)
+  {
+    pthread_create(&s_workers[i].m_thread, NULL, WorkerMain, &s_workers[i]);
+  }
+
+  memset(&total, 0, sizeof(Stats));
+  for(i = 0; i < s_numWorkers; ++i)
+  {
+    pthread_join(s_workers[i].m_thread, NULL);
+    AddStats(&total, &s_workers[i].m_stats);
+  }
+  wall = Now(CLOCK_MONOTONIC) - wall;
+
+  games = (double)total.m_games;
+  printf("%s vs %s: %lld games, seed %lu, %d threads\n",
+         s_bots[0]->m_name, s_bots[1]->m_name, total.m_games, s_seed, s_numWorkers);
+  for(i = 0; i < 2; ++i)
+  {
+    printf("    %-9s wins %6.2f%%  length %6.1f  score %7.1f\n", s_bots[i]->m_name,
+           100.0 * total.m_bots[i].m_wins / games,
+           total.m_bots[i].m_length / games, total.m_bots[i].m_score / games);
+  }
+  printf("    draws %6.2f%%  timeouts %6.2f%%\n",
+         100.0 * total.m_draws / games, 100.0 * total.m_timeouts / games);
+  printf("    ticks      mean %8.1f  min %lld  max %lld\n",
+         total.m_ticks / games, total.m_minTicks, total.m_maxTicks);
+  printf("    tick cost  mean %8.1f ns  worst game %lld ns\n",
+         total.m_ticks > 0 ? (double)total.m_ns / total.m_ticks : 0.0, total.m_maxTickNs);
+  printf("    games/s    %.0f  (%.0f per core)  in %.2f s, %lld steals\n",
+         games * 1e9 / wall, total.m_ns > 0 ? games * 1e9 / total.m_ns : 0.0, wall / 1e9, total.m_steals);
+  for(i = 0; i < s_numWorkers && s_numWorkers <= 16; ++i)
+  {
+    const Stats* pStats = &s_workers[i].m_stats;
+
+    printf("      thread %2d  games %8lld  %.0f games/s  steals %lld\n", i, pStats->m_games,
+           pStats->m_ns > 0 ? pStats->m_games * 1e9 / pStats->m_ns : 0.0, pStats->m_steals);
+  }
+
+  return total.m_games == s_games ? 0 : 1;
+}
@@ -5,12 +5,16 @@
  *    Character reception is interrupt supported:
  *       ReceiveLine(char* line, int timeout)
  *       RecvData( char* pData, int Size )
+ *       RecvPeek( char* pData, int Size )
  *
  *    Character transmission via:
  *       SendLine(char* line)
  *
+ *    Line speed changes via:
+ *       UartSetBaud(int baud)
+ *
  * Call the following to initialise the UART
- *    UartInit(AT91UartGetchar, AT91UartPutchar);
+ *    UartInit(AT91UartGetchar, AT91UartPutchar, AT91UartSetBaud);
  *    AT91InitInterrupt(TimerBeat, UartRxrdy);
  *    AT91UartInit();
  */
@@ -19,7 +23,6 @@
 #include "config.h"
 #include "uart.h"
 #include "timer.h"
-#include <intrinsic.h>
 
 
 /* Timeout for reading new data - ms */
@@ -31,18 +34,26 @@ static char rbuf[RXBUF_SIZE];
 /* Pointer to next available vacant byte in the buffer */
 static volatile int rptr = 0;
 
+/* Free running byte counts and bytes lost to a full buffer */
+static volatile unsigned long rx_count = 0;
+static volatile unsigned long tx_count = 0;
+static volatile unsigned long rx_overruns = 0;
+
 /* The serviced routines for reception and transmission via the UART */
 static int(*getchar_function)();
 static void(*putchar_function)(int);
+static void(*setbaud_function)(int);
 
 
 
 /*
  * Connect UART receive and transmit functions
  */
-void UartInit(int(*getchar_func)(), void(*putchar_func)(int)) {
+void UartInit(int(*getchar_func)(), void(*putchar_func)(int),
+              void(*setbaud_func)(int)) {
   getchar_function = getchar_func;
   putchar_function = putchar_func;
+  setbaud_function = setbaud_func;
 }
 
 
@@ -57,13 +68,16 @@ void UartInit(int(*getchar_func)(), void(*putchar_func)(int)) {
  * space in the buffer, rbuff[]
  *
  */
-void UartRxrdy() {
+RAMFUNC void UartRxrdy() {
   unsigned char value;
 
   value = (*getchar_function)();      /* Read character from UART */
+  rx_count++;
 
-  if (rptr >= RXBUF_SIZE)             /* Is there enough space? */
+  if (rptr >= RXBUF_SIZE) {           /* Is there enough space? */
+    rx_overruns++;
     return;
+  }
     
   rbuf[rptr++] = value;               /* Store character and update pointer */
 }
@@ -156,14 +170,39 @@ int RecvData( char* pData, int Size ) {
    }
 	
 /* NOTE: Disable interrupts here to protect the buffer */
-   __disable_interrupt();
+   HalDisableInterrupts();
         
    rptr = rptr - Size;                /* Adjust buffer index to remove size chars */
    memcpy( pData, &rbuf[0], Size );   /* Copy receive buffer to parameter buffer */
    memcpy( rbuf, &rbuf[Size], rptr ); /* Shift remaining chars to front of buffer */
 		
 /* NOTE: Reenable interrupts here */
-   __enable_interrupt();
+   HalEnableInterrupts();
+
+   return Size;
+}
+
+
+
+
+/*
+ * RecvPeek()
+ *
+ * As RecvData() but the bytes are left in the serial buffer, so that a
+ * caller can inspect a header before deciding how much to consume
+ *
+ * Parameters:
+ *    size: number of bytes to be copied
+ *    pData: pointer to the start of the character buffer
+ *
+ */
+int RecvPeek( char* pData, int Size ) {
+
+   if ( rptr < Size ) {               /* Test number of chars available */
+      return 0;                       /* Too few chars available */
+   }
+
+   memcpy( pData, &rbuf[0], Size );   /* Bytes before rptr are stable */
 
    return Size;
 }
@@ -171,6 +210,37 @@ int RecvData( char* pData, int Size ) {
 
 
 
+/*
+ * UartFlush()
+ *
+ * Discard everything in the serial receive buffer
+ *
+ */
+void UartFlush() {
+   HalDisableInterrupts();
+   rptr = 0;
+   HalEnableInterrupts();
+}
+
+
+
+
+/*
+ * UartSetBaud()
+ *
+ * Change the line speed once any pending transmission has drained
+ *
+ * Parameter:
+ *    baud: new baud rate
+ *
+ */
+void UartSetBaud(int baud) {
+  (*setbaud_function)(baud);
+}
+
+
+
+
 /*
  * SendLine()
  *
@@ -184,6 +254,7 @@ void SendLine(char* line) {
   for ( ; *line; line++)
   {
     (*putchar_function)(*line);
+    tx_count++;
   }
 }
 
@@ -206,4 +277,21 @@ void SendData( char* pData, int Size ) {
   {
     (*putchar_function)(pData[i]);
   }
+  tx_count += Size;
+}
+
+
+
+
+/*
+ * UartGetCounters()
+ *
+ * Copy the free running byte counters - bytes received, bytes sent and
+ * bytes received while the buffer was full and so discarded
+ *
+ */
+void UartGetCounters(UartCounters* pCounters) {
+  pCounters->m_rxBytes  = rx_count;
+  pCounters->m_txBytes  = tx_count;
+  pCounters->m_overruns = rx_overruns;
 }
@@ -3,11 +3,23 @@
  * $Revision: 1.2 $
  */
 
-void UartInit(int(*getchar_func)(), void(*putchar_func)(int));
+typedef struct UartCounters_
+{
+  unsigned long m_rxBytes;
+  unsigned long m_txBytes;
+  unsigned long m_overruns;
+} UartCounters;
+
+void UartInit(int(*getchar_func)(), void(*putchar_func)(int),
+              void(*setbaud_func)(int));
 void UartRxrdy();
 
 int ReceiveLine(char* line, int timeout);
 void SendLine(char* line);
 
 int RecvData( char* pData, int Size );
+int RecvPeek( char* pData, int Size );
+void UartFlush();
+void UartSetBaud(int baud);
 void SendData( char* pData, int Size );
+void UartGetCounters(UartCounters* pCounters);